@@ -0,0 +1,87 @@
+// Full sweep benchmark for the argmax engine on ssn.
+// Compares the untiled sweep (every sample streams all duals) with the
+// cache-blocked tiles, at increasing thread counts. Pruning is off, so every
+// call sweeps all dual x sample pairs.
+// usage: argmax_bench [num_duals] [num_samples] [repeats] [max_threads]
+// max_threads defaults to the number of processors; rows beyond it run
+// oversubscribed and are marked, they show overhead, not scaling.
+// run from the repository root, the problem is read from tests/ssn
+#include "smps.h"
+#include "prob.h"
+#include "argmax.h"
+#include <omp.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+double time_compute(ArgmaxEngine &engine, const std::vector<double> &x, int repeats)
+{
+    double best = 1e300;
+    for (int r = 0; r < repeats; ++r)
+    {
+        auto start = std::chrono::steady_clock::now();
+        engine.compute(x, r + 1);
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    size_t num_duals = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    size_t num_samples = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    int repeats = argc > 3 ? std::atoi(argv[3]) : 3;
+    int max_threads = argc > 4 ? std::atoi(argv[4]) : omp_get_num_procs();
+
+    smps::SMPSCore cor("tests/ssn/ssn.cor");
+    smps::SMPSImplicitTime tim("tests/ssn/ssn.tim");
+    smps::SMPSStoch sto("tests/ssn/ssn.sto");
+    StageProblem prob(cor, tim, sto, 1);
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    VectorContainer duals(num_duals, prob.get_dual_dimension());
+    for (size_t i = 0; i < num_duals; ++i)
+    {
+        std::vector<double> pi(prob.get_dual_dimension());
+        for (auto &v : pi)
+            v = dist(rng);
+        duals.insert(pi);
+    }
+
+    ArgmaxEngine engine(prob, duals);
+    engine.set_pruning(false);
+    for (size_t j = 0; j < num_samples; ++j)
+        engine.add_sample(sto.generate_scenario(rng));
+
+    std::vector<double> x(prob.nvars_last);
+    for (auto &v : x)
+        v = dist(rng);
+
+    const ArgmaxEngine::TileSizes tiled = engine.get_tile_sizes(), untiled{num_duals, 1};
+    const double pairs = static_cast<double>(num_duals) * num_samples;
+    std::printf("duals=%zu samples=%zu random_elements=%zu tiles=%zu duals x %zu samples\n",
+                num_duals, num_samples, prob.stage_stoc_pattern.rv_count, tiled.duals, tiled.samples);
+    std::printf("%8s %14s %14s %10s %10s\n", "threads", "untiled Gp/s", "tiled Gp/s", "speedup", "scaling");
+
+    double tiled_one_thread = 0.0;
+    for (int nthreads = 1; nthreads <= max_threads; nthreads *= 2)
+    {
+        omp_set_num_threads(nthreads);
+        engine.set_tile_sizes(untiled);
+        double t_untiled = time_compute(engine, x, repeats);
+        engine.set_tile_sizes(tiled);
+        double t_tiled = time_compute(engine, x, repeats);
+        if (nthreads == 1)
+            tiled_one_thread = t_tiled;
+
+        std::printf("%8d %14.3f %14.3f %10.2f %10.2f%s\n", nthreads,
+                    pairs / t_untiled / 1e9, pairs / t_tiled / 1e9, t_untiled / t_tiled, tiled_one_thread / t_tiled,
+                    nthreads > omp_get_num_procs() ? "  oversubscribed" : "");
+    }
+    return 0;
+}
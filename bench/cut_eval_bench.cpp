@@ -0,0 +1,87 @@
+// Batch cut evaluation benchmark: max over a cut pool at many points.
+// The per-cut loop evaluates every cut at one point at a time, as
+// CutPool::max_value does; the batch kernel streams the cuts once per block
+// of points, in double and in float. Below CutPool::BATCH_MIN_DIM or on
+// fewer points than a kernel block the double path is the per-cut loop.
+// usage: cut_eval_bench [num_cuts] [dim] [num_points] [repeats]
+#include "cut_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+template <typename Fn>
+double best_time(int repeats, Fn fn)
+{
+    double best = 1e300;
+    for (int r = 0; r < repeats; ++r)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    size_t num_cuts = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    size_t dim = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100;
+    size_t num_points = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 256;
+    int repeats = argc > 4 ? std::atoi(argv[4]) : 5;
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    CutPool pool(dim);
+    for (size_t t = 1; t <= num_cuts; ++t)
+    {
+        Cut cut{dist(rng), std::vector<double>(dim)};
+        for (double &b : cut.beta)
+            b = dist(rng);
+        pool.add(cut, t);
+    }
+    std::vector<double> points(num_points * dim);
+    for (double &v : points)
+        v = dist(rng);
+
+    const uint64_t k = num_cuts;
+    std::vector<double> values(num_points);
+    std::vector<size_t> indices(num_points);
+
+    double t_loop = best_time(repeats, [&]() {
+        std::vector<double> x(dim);
+        for (size_t p = 0; p < num_points; ++p)
+        {
+            std::copy_n(&points[p * dim], dim, x.begin());
+            values[p] = pool.max_value(x, k, indices[p]);
+        }
+    });
+    std::vector<double> reference = values;
+
+    double t_double = best_time(repeats, [&]() {
+        pool.max_values(points, k, values, indices, CutPool::Precision::DOUBLE);
+    });
+    double max_error_double = 0.0;
+    for (size_t p = 0; p < num_points; ++p)
+        max_error_double = std::max(max_error_double, std::abs(values[p] - reference[p]));
+
+    double t_float = best_time(repeats, [&]() {
+        pool.max_values(points, k, values, indices, CutPool::Precision::FLOAT);
+    });
+    double max_error_float = 0.0;
+    for (size_t p = 0; p < num_points; ++p)
+        max_error_float = std::max(max_error_float, std::abs(values[p] - reference[p]));
+
+    const double flops = 2.0 * num_cuts * dim * num_points;
+    std::printf("cuts=%zu dim=%zu points=%zu\n", num_cuts, dim, num_points);
+    std::printf("%16s %12s %10s %10s %12s\n", "method", "time ms", "GFlop/s", "speedup", "max error");
+    std::printf("%16s %12.3f %10.2f %10.2f %12.2e\n", "per-cut loop", t_loop * 1e3, flops / t_loop / 1e9, 1.0, 0.0);
+    std::printf("%16s %12.3f %10.2f %10.2f %12.2e\n", "batch double", t_double * 1e3, flops / t_double / 1e9, t_loop / t_double, max_error_double);
+    std::printf("%16s %12.3f %10.2f %10.2f %12.2e\n", "batch float", t_float * 1e3, flops / t_float / 1e9, t_loop / t_float, max_error_float);
+    return 0;
+}
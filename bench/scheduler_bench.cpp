@@ -0,0 +1,128 @@
+// Subproblem sweep benchmark: a static OpenMP loop against parallel_sweep,
+// the dynamic OpenMP loop the solvers use, on the ssn scenario LPs.
+// Reports the makespan and the tail, the time between the first and the
+// last thread running out of work, which is idle time of the early threads.
+// With "synthetic" the LPs are replaced by busy waits of lognormal length
+// (median 0.2 ms, about 10x between the 5% and 95% quantiles), which needs
+// no solver.
+// usage: scheduler_bench [num_samples] [nthreads] [repeats] [synthetic]
+// run from the repository root, the problem is read from tests/ssn
+#include "smps.h"
+#include "prob.h"
+#include "scheduler.h"
+#include <omp.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct SweepTime
+{
+    double makespan = 1e300;
+    double tail = 1e300;
+};
+
+// best makespan and tail of repeats sweeps; sweep(finish) records the time
+// each thread ran out of work
+SweepTime time_sweep(int nthreads, int repeats, const std::function<void(std::vector<double> &)> &sweep)
+{
+    SweepTime best;
+    for (int r = 0; r < repeats; ++r)
+    {
+        std::vector<double> finish(nthreads, 0.0);
+        auto start = Clock::now();
+        sweep(finish);
+        double makespan = std::chrono::duration<double>(Clock::now() - start).count();
+        auto [first, last] = std::minmax_element(finish.begin(), finish.end());
+        best.makespan = std::min(best.makespan, makespan);
+        best.tail = std::min(best.tail, *last - *first);
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    size_t num_samples = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    int nthreads = argc > 2 ? std::atoi(argv[2]) : omp_get_num_procs();
+    int repeats = argc > 3 ? std::atoi(argv[3]) : 3;
+    bool synthetic = argc > 4 && std::strcmp(argv[4], "synthetic") == 0;
+
+    smps::SMPSCore cor("tests/ssn/ssn.cor");
+    smps::SMPSImplicitTime tim("tests/ssn/ssn.tim");
+    smps::SMPSStoch sto("tests/ssn/ssn.sto");
+
+    std::mt19937 rng(1);
+    std::vector<std::vector<double>> samples(num_samples);
+    std::vector<double> durations(num_samples);
+    std::lognormal_distribution<double> duration_dist(std::log(2e-4), 0.7);
+    for (size_t i = 0; i < num_samples; ++i)
+    {
+        samples[i] = sto.generate_scenario(rng);
+        durations[i] = duration_dist(rng);
+    }
+
+    // one problem per thread, the solvers attached only for the real LPs
+    StageProblem prob_tmp(cor, tim, sto, 1);
+    std::vector<std::unique_ptr<StageProblem>> probs;
+    for (int t = 0; t < nthreads; ++t)
+    {
+        probs.push_back(std::make_unique<StageProblem>(prob_tmp));
+        if (!synthetic)
+        {
+            probs[t]->attach_solver();
+            GRBsetintparam(GRBgetenv(probs[t]->get_model()), GRB_INT_PAR_THREADS, 1);
+        }
+    }
+    std::vector<double> x(prob_tmp.nvars_last, 0.0);
+
+    auto task = [&](int t, size_t i)
+    {
+        if (synthetic)
+        {
+            auto start = Clock::now();
+            while (std::chrono::duration<double>(Clock::now() - start).count() < durations[i])
+                ;
+            return;
+        }
+        std::vector<double> omega_i;
+        stage_omega(probs[t]->stage_stoc_pattern, samples[i], omega_i);
+        probs[t]->update_solver_with_scenario(x, omega_i);
+        probs[t]->solve_problem(true);
+    };
+
+    SweepTime static_time = time_sweep(nthreads, repeats, [&](std::vector<double> &finish)
+    {
+        auto start = Clock::now();
+        #pragma omp parallel num_threads(nthreads)
+        {
+            #pragma omp for schedule(static) nowait
+            for (size_t i = 0; i < num_samples; ++i)
+                task(omp_get_thread_num(), i);
+            finish[omp_get_thread_num()] = std::chrono::duration<double>(Clock::now() - start).count();
+        }
+    });
+
+    SweepTime dynamic_time = time_sweep(nthreads, repeats, [&](std::vector<double> &finish)
+    {
+        auto start = Clock::now();
+        parallel_sweep(nthreads, num_samples, [&](int t, size_t i)
+        {
+            task(t, i);
+            finish[t] = std::chrono::duration<double>(Clock::now() - start).count();
+        });
+    });
+
+    std::printf("samples=%zu threads=%d tasks=%s\n", num_samples, nthreads, synthetic ? "synthetic" : "ssn LPs");
+    std::printf("%16s %14s %14s\n", "schedule", "makespan (s)", "tail (ms)");
+    std::printf("%16s %14.4f %14.3f\n", "omp static", static_time.makespan, static_time.tail * 1e3);
+    std::printf("%16s %14.4f %14.3f\n", "parallel_sweep", dynamic_time.makespan, dynamic_time.tail * 1e3);
+    return 0;
+}
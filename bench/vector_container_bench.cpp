@@ -0,0 +1,63 @@
+// Contention benchmark for the dual vertex stores.
+// Each thread inserts its share of vectors; the mutex-guarded VectorContainer
+// is the baseline for ConcurrentVectorContainer.
+// usage: vector_container_bench [total_inserts] [vector_dim] [capacity]
+#include "vector_container.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+template <typename InsertFn>
+double run_threads(int nthreads, size_t total_inserts, size_t dim, InsertFn insert)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; ++t)
+    {
+        threads.emplace_back([=, &insert]() {
+            std::vector<double> vec(dim, static_cast<double>(t));
+            for (size_t i = t; i < total_inserts; i += nthreads)
+            {
+                vec[0] = static_cast<double>(i);
+                insert(vec);
+            }
+        });
+    }
+    for (auto &th : threads)
+        th.join();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    size_t total_inserts = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1 << 20;
+    size_t dim = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100;
+    size_t capacity = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 4096;
+
+    std::printf("inserts=%zu dim=%zu capacity=%zu hardware_threads=%u\n",
+                total_inserts, dim, capacity, std::thread::hardware_concurrency());
+    std::printf("%8s %16s %16s %10s\n", "threads", "mutex Mins/s", "atomic Mins/s", "speedup");
+
+    for (int nthreads : {1, 2, 4, 8, 16, 32, 64})
+    {
+        VectorContainer locked(capacity, dim);
+        std::mutex lock;
+        double t_mutex = run_threads(nthreads, total_inserts, dim, [&](const std::vector<double> &vec) {
+            std::lock_guard<std::mutex> guard(lock);
+            locked.insert(vec);
+        });
+
+        ConcurrentVectorContainer concurrent(capacity, dim);
+        double t_atomic = run_threads(nthreads, total_inserts, dim, [&](const std::vector<double> &vec) {
+            concurrent.insert(vec);
+        });
+
+        std::printf("%8d %16.2f %16.2f %10.2f\n", nthreads,
+                    total_inserts / t_mutex / 1e6, total_inserts / t_atomic / 1e6, t_mutex / t_atomic);
+    }
+    return 0;
+}
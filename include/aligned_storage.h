@@ -0,0 +1,45 @@
+#ifndef ALIGNED_STORAGE_H
+#define ALIGNED_STORAGE_H
+
+#include <cstddef>
+
+// Allocation of large float buffers, such as the dual vertex storage.
+//
+// Buffers are aligned to STORAGE_ALIGNMENT bytes, so with the padding to
+// VectorContainer::GROUP_SIZE floats every stored vector starts on an aligned
+// SIMD boundary.
+
+// alignment of every buffer, one cache line
+constexpr size_t STORAGE_ALIGNMENT = 64;
+
+// transparent huge pages are 2 MB on x86-64
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+struct StorageOptions
+{
+    // buffers of at least HUGE_PAGE_SIZE are aligned to it and
+    // advised to use transparent huge pages (Linux only)
+    bool huge_pages = true;
+
+    // zero the buffer from an OpenMP parallel loop with a static schedule
+    // over blocks of block_size floats. With the kernel's first-touch
+    // placement, each block lands on the NUMA node of the thread that
+    // touched it, so loops that use the same static schedule over the
+    // same blocks read node-local memory.
+    bool numa_first_touch = true;
+
+    // also keep every vector in double precision next to the float storage
+    // (VectorContainer and UniqueVectorContainer only), for consumers that
+    // need the exact values of a few vectors after a float sweep
+    bool double_copy = false;
+};
+
+// allocate count zeroed floats
+// block_size is the unit of the first-touch partition, e.g. the padded vector length
+// throws std::bad_alloc on failure
+float *allocate_float_storage(size_t count, size_t block_size, const StorageOptions &options = StorageOptions());
+
+// free a buffer from allocate_float_storage, nullptr is ignored
+void free_float_storage(float *ptr);
+
+#endif // ALIGNED_STORAGE_H
@@ -0,0 +1,70 @@
+#ifndef APPROXIMATION_H
+#define APPROXIMATION_H
+
+#include "prob.h"
+#include "cut_helper.h"
+#include "vector_container.h"
+#include "argmax.h"
+#include "cut_pool.h"
+#include "window.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// One SD approximation of the recourse function: the samples it is built on,
+// the dual vertices found on them, and the argmax engine that turns them into
+// cuts at any x.
+//
+// The scenario LPs are solved on the given second stage problems, one per
+// sweep thread, so a group of threads can own an approximation while other
+// groups work on theirs. The problems must have their solvers attached and
+// are used by this object only.
+class SDApproximation
+{
+public:
+    // workers: second stage problems, the LPs run on up to workers.size() threads
+    // max_duals: dual vertices kept, replaced under policy once full
+    SDApproximation(const std::vector<StageProblem *> &workers, size_t max_duals,
+                    VectorContainer::EvictionPolicy policy = VectorContainer::EvictionPolicy::LEAST_HITS);
+
+    // add new samples, given as the random elements of the second stage:
+    // their LPs are solved at every point in parallel and the dual vertices stored
+    void add_samples(const std::vector<std::vector<double>> &samples,
+                     const std::vector<const std::vector<double> *> &points);
+
+    // the SD cut at x, averaged over all samples so far
+    // the winning duals are recorded as hits at timestamp
+    Cut cut_at(const std::vector<double> &x, uint64_t timestamp);
+
+    size_t num_samples() const;
+    size_t num_duals() const;
+
+    // A step of an approximation that keeps its own cuts, as a worker of the
+    // independent approximations does: add the samples at the candidate and
+    // the incumbent, add the SD cuts at both points to the own cut pool at the
+    // next own iteration, keep the cuts attaining the max at either point
+    // active, and drop the cuts inactive for more than max_inactive steps.
+    // A step adds at most two cuts and marks at most two, so at most
+    // max_cuts(max_inactive) cuts are kept.
+    void step(const std::vector<std::vector<double>> &samples, const std::vector<double> &candidate,
+              const std::vector<double> &incumbent, uint64_t max_inactive);
+
+    static size_t max_cuts(uint64_t max_inactive);
+
+    // number of steps taken
+    uint64_t get_iteration() const;
+
+    // the own cuts as seen at the own iteration, with the sample count
+    ApproximationSnapshot snapshot(uint64_t timestamp) const;
+
+private:
+    std::vector<StageProblem *> workers;
+    UniqueVectorContainer duals;
+    std::unique_ptr<ArgmaxEngine> argmax;
+
+    // own cuts and iteration, used by step
+    CutPool pool;
+    uint64_t iteration;
+};
+
+#endif // APPROXIMATION_H
@@ -0,0 +1,201 @@
+#ifndef ARGMAX_H
+#define ARGMAX_H
+
+#include "prob.h"
+#include "cut_helper.h"
+#include "vector_container.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Finds, for every stored sample omega_j, the dual vertex pi_i in a container
+// that maximizes the second stage dual objective at x:
+//     pi_i (r(omega_j) - T(omega_j) x)
+// which is the SD approximation of the recourse function on the sample.
+//
+// Each dual is split into a static part (alpha_bar_i, beta_bar_i) from the
+// deterministic template, and its entries at the rows of the random elements.
+// The value on a sample is then
+//     alpha_bar_i - beta_bar_i x + sum_k pi_i[row_k] w_jk(x)
+// with w_jk(x) = delta_jk for a random rhs and -delta_jk x[col_k] for a
+// random transfer element, where delta_jk = omega_jk - reference_k.
+// The static part is computed once per call, so the sweep over all pairs
+// only touches the random rows.
+//
+// The engine owns the sync range of the container: it refreshes the duals
+// inserted or replaced since the last call and resets the range.
+//
+// Pruning: x moves little between calls, so the winner of a sample rarely
+// changes. After a full sweep the engine memoizes, per sample, the best
+// MEMO_CANDIDATES duals and the value of the best of the rest (the cutoff).
+// The value of a dual changes by at most ||beta_ij|| ||dx||, so with B a bound
+// on ||beta_ij|| over all pairs and D the path length of x since that sweep,
+// no old dual outside the memo can exceed cutoff + B D. A later call only
+// evaluates the memo and the duals refreshed since the sweep, and falls back
+// to a full sweep when the best of these is below that bound.
+//
+// Full sweeps are tiled: the samples that need one are cut into blocks whose
+// random parts fit in L1, the duals into blocks whose random parts fit in L2,
+// and every sample block visits the dual blocks in turn, keeping its running
+// top candidates in a small local buffer. Sample blocks run in parallel.
+//
+// Exact recheck: the sweep runs in float, which can rank two close duals the
+// wrong way round. If the container keeps a double copy of the duals
+// (StorageOptions::double_copy), the sweep also keeps every dual whose float
+// value is within the rounding error bound of the float maximum, and the
+// winner is chosen among those by recomputing their values in double.
+// Values and cuts then come from the double duals.
+class ArgmaxEngine
+{
+public:
+    // prob: second stage problem, the duals are in the layout of its dual solution
+    // duals: dual vertices, read on every call; the winners are recorded as hits
+    // nthreads: size of the OpenMP team of a call, 0 for omp_get_max_threads() at the call;
+    // a worker group passes its own size so groups do not oversubscribe
+    ArgmaxEngine(const StageProblem &prob, VectorContainer &duals, int nthreads = 0);
+
+    // number of duals memoized per sample
+    static constexpr size_t MEMO_CANDIDATES = 4;
+
+    // enable or disable the memo and pruning (enabled by default)
+    // disabling drops the memo, so every call sweeps all duals
+    void set_pruning(bool enabled);
+
+    // enable or disable the exact recheck (enabled by default if the
+    // container keeps double copies); throws if the container has none
+    void set_exact_recheck(bool enabled);
+
+    // number of duals and samples in a tile of the full sweep
+    struct TileSizes
+    {
+        size_t duals;
+        size_t samples;
+    };
+
+    // the defaults are chosen from the data cache sizes at construction
+    void set_tile_sizes(const TileSizes &tiles);
+    TileSizes get_tile_sizes() const;
+
+    // add a sample; omega holds the random elements of the stage,
+    // in the order of prob.stage_stoc_pattern
+    void add_sample(const std::vector<double> &omega);
+
+    size_t num_samples() const;
+
+    // refresh the coefficients of new and replaced duals
+    void sync();
+
+    struct Result
+    {
+        // container index of the best dual for each sample
+        std::vector<size_t> winner;
+        // its objective value at x for each sample
+        std::vector<double> value;
+        // number of samples that needed a sweep over all duals
+        size_t full_sweeps = 0;
+        // number of duals recomputed in double by the full sweeps
+        size_t exact_evaluations = 0;
+    };
+
+    // argmax over the duals for every sample at x, syncing first
+    // every winner is recorded as a hit in the container at timestamp
+    // throws if the container is empty
+    Result compute(const std::vector<double> &x, uint64_t timestamp);
+
+    // the cut from dual dual_index on sample j, in the convention of CutHelper
+    Cut get_cut(size_t dual_index, size_t sample) const;
+
+    // the SD cut: average of the winner cuts over all samples
+    Cut build_cut(const Result &result) const;
+
+private:
+    const StageProblem &prob;
+    VectorContainer &duals;
+    int nthreads;
+
+    // the team of a parallel region: nthreads, or omp_get_max_threads() for 0
+    int team_size() const;
+
+    // first stage dimension, and number of random elements
+    size_t nx, nrv;
+    // nrv padded to a multiple of GROUP_SIZE
+    size_t padded_nrv;
+
+    // per container slot: static part of the cut,
+    // and the dual at the random rows (padded with zeros)
+    std::vector<double> alpha_bar, beta_bar;
+    std::vector<float> pi_random;
+
+    // exact recheck: the dual at the random rows in double, the 1-norm of its
+    // float copy, and the relative error bound of the float dot product
+    bool exact_recheck;
+    std::vector<double> pi_random_exact, pi_random_norm1;
+    double float_error;
+
+    // per sample: omega - reference
+    std::vector<double> delta;
+    size_t nsamples;
+
+    TileSizes tiles;
+
+    // pruning state
+    bool pruning;
+    // per slot: ||beta_bar_i||, and the norm of pi_i at the random transfer rows
+    // ||beta_ij|| <= beta_norm_i + pi_transfer_norm_i * max_transfer_delta
+    std::vector<double> beta_norm, pi_transfer_norm;
+    // max over the samples of the norm of the random transfer entries of delta
+    double max_transfer_delta;
+    // path length of x over all calls, and the last x
+    double path_length;
+    std::vector<double> last_x;
+
+    // refreshed slots as (epoch, slot) in increasing epoch order,
+    // trimmed to the entries newer than the oldest sample memo
+    uint64_t epoch;
+    std::vector<std::pair<uint64_t, size_t>> refresh_log;
+
+    struct Memo
+    {
+        bool valid = false;
+        // epoch and path length at the last full sweep
+        uint64_t epoch = 0;
+        double path_length = 0.0;
+        // best duals at that sweep, and the best value among the rest
+        size_t count = 0;
+        size_t candidates[MEMO_CANDIDATES];
+        double cutoff = 0.0;
+    };
+    std::vector<Memo> memo;
+
+    // recompute the coefficients of one slot from the container
+    void refresh(size_t slot);
+
+    // value of slot i on a sample with random part wj, given its static part
+    double sample_value(double base, size_t i, const float *wj) const;
+
+    // value of slot i on sample j at last_x in double
+    double exact_value(double base, size_t i, size_t j) const;
+
+    // the dual in slot i, from the double copy if the container has one
+    std::vector<double> dual(size_t slot) const;
+
+    // running best MEMO_CANDIDATES + 1 duals of a sample, in decreasing order
+    struct TopCandidates
+    {
+        size_t count = 0;
+        size_t index[MEMO_CANDIDATES + 1] = {};
+        double value[MEMO_CANDIDATES + 1] = {};
+        void insert(size_t i, double v);
+    };
+
+    // tiled full sweep over the given samples; fills their memos and results
+    // w_max: max |w_jk| of each sample, for the float error bound
+    void sweep(const std::vector<double> &base, const std::vector<float> &w, const std::vector<double> &w_max,
+               size_t ndual, const std::vector<size_t> &samples, Result &result);
+
+    // memo lookup for one sample, false if the winner cannot be certified
+    bool lookup(const std::vector<double> &base, const float *wj, size_t j, const Memo &m,
+                double max_slope, size_t ndual, size_t &winner, double &value) const;
+};
+
+#endif // ARGMAX_H
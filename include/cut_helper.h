@@ -25,5 +25,26 @@ class CutHelper
     // beta += transpose(current_block) * pi
     static void add_dynamic_part(const StageProblem& prob, const std::vector<double>& pi, const std::vector<double>& scenario, Cut& cut);
 
+    // sparse versions of get_static_part and add_dynamic_part
+    // pi is the dual solution in sparse form, only its non-zero entries are visited
+    static Cut get_static_part(const StageProblem& prob, const SparseVector<double>& pi);
+    static void add_dynamic_part(const StageProblem& prob, const SparseVector<double>& pi, const std::vector<double>& scenario, Cut& cut);
+
+    // versions that take the solution directly, and use the sparse dual if the solution has one
+    static Cut get_static_part(const StageProblem& prob, const StageProblem::Solution& sol);
+    static void add_dynamic_part(const StageProblem& prob, const StageProblem::Solution& sol, const std::vector<double>& scenario, Cut& cut);
+
+    // sum += the cut of the solution at the scenario, without building the cut;
+    // for sums over many samples. sum.beta must have prob.nvars_last entries
+    static void add_cut(const StageProblem& prob, const StageProblem::Solution& sol, const std::vector<double>& scenario, Cut& sum);
+
+    // evaluate the cut at x: alpha - beta * x
+    static double evaluate(const Cut& cut, const std::vector<double>& x);
+
+    private:
+    // alpha = rhs_bar * pi (bounds included), for a dense and a sparse pi
+    static double static_alpha(const StageProblem& prob, const std::vector<double>& pi);
+    static double static_alpha(const StageProblem& prob, const SparseVector<double>& pi);
+
 };
 #endif // CUT_HELPER_H
\ No newline at end of file
@@ -0,0 +1,116 @@
+#ifndef CUT_POOL_H
+#define CUT_POOL_H
+
+#include "cut_helper.h"
+#include <cstdint>
+#include <vector>
+
+// Pool of SD cuts with lazy aging.
+//
+// In stochastic decomposition a cut created at iteration t averages t samples,
+// and at iteration k >= t it is only valid after scaling by t / k:
+//     theta >= (t / k) (alpha - beta x)
+// Instead of rescaling every cut each iteration, the pool stores each cut
+// premultiplied by its creation iteration, (t alpha, t beta), which never
+// changes. The scale 1 / k is applied when cuts are evaluated, or folded into
+// the master problem through the substitution eta = k theta:
+//     eta >= t alpha - t beta x,    objective coefficient of eta = 1 / k
+// so only one objective coefficient changes per iteration.
+//
+// Storage is structure of arrays: the scaled intercepts, the creation
+// iterations, and the scaled slopes row-major with a padded row stride.
+//
+// Each cut also records the epigraph variable it bounds (for multi-cut
+// masters) and the last iteration it was active in the master, so cuts
+// that stay slack can be removed. Removal keeps the order of the rest,
+// the same way the solver renumbers its constraints on deletion.
+class CutPool
+{
+public:
+    // rows of the slope matrix are padded to a multiple of this many doubles
+    static constexpr size_t GROUP_SIZE = 8;
+
+    // dim: length of beta (first stage dimension)
+    explicit CutPool(size_t dim);
+
+    // add a cut created at iteration (its number of samples), which must be positive,
+    // bounding epigraph variable epigraph
+    // returns the index of the cut
+    size_t add(const Cut &cut, uint64_t iteration, size_t epigraph = 0);
+
+    // remove the cuts at the given indices (increasing, no duplicates)
+    // the remaining cuts keep their order and move down
+    void remove(const std::vector<size_t> &indices);
+
+    size_t size() const;
+    size_t get_dim() const;
+    size_t get_stride() const;
+
+    // creation iteration of cut i
+    uint64_t get_iteration(size_t i) const;
+
+    // epigraph variable bounded by cut i
+    size_t get_epigraph(size_t i) const;
+
+    // activity: the last iteration cut i was tight or had a non-zero dual
+    // in the master, initially its creation iteration
+    void mark_active(size_t i, uint64_t k);
+    uint64_t get_last_active(size_t i) const;
+
+    // indices of the cuts not active for more than max_inactive iterations at iteration k
+    std::vector<size_t> inactive_cuts(uint64_t k, uint64_t max_inactive) const;
+
+    // the stored cut t alpha - t beta x, as used in the eta formulation
+    double get_scaled_alpha(size_t i) const;
+    const double *get_scaled_beta(size_t i) const;
+    Cut get_scaled_cut(size_t i) const;
+
+    // cut i as seen at iteration k, scaled by t / k
+    Cut get_cut(size_t i, uint64_t k) const;
+
+    // objective coefficient of eta = k theta in the master at iteration k
+    static double epigraph_coefficient(uint64_t k);
+
+    // values[i] = (t_i / k) (alpha_i - beta_i x) for every cut
+    void evaluate(const std::vector<double> &x, uint64_t k, std::vector<double> &values) const;
+
+    // precision of the batch evaluation: FLOAT sums in float from a float
+    // copy of the cuts, DOUBLE is exact up to double rounding
+    enum class Precision { FLOAT, DOUBLE };
+
+    // the double batch kernel loses to the per-cut loop below this dimension
+    // and on fewer points than one kernel block (cut_eval_bench, 500 cuts:
+    // 0.8x at dim 20 on 4 points, 0.65x at dim 50 on 2 points, 1.2-1.5x from
+    // dim 50 on 4 or more), so max_values evaluates those one point at a time
+    static constexpr size_t BATCH_MIN_DIM = 32;
+
+    // batch version of max_value: points holds npoints = points.size() / dim
+    // points of length dim back to back. values and indices are resized to npoints
+    // with -infinity and size() for every point if the pool is empty
+    void max_values(const std::vector<double> &points, uint64_t k, std::vector<double> &values,
+                    std::vector<size_t> &indices, Precision precision = Precision::DOUBLE) const;
+
+    // value of the SD approximation at x at iteration k, the max over the cuts,
+    // and the index of the cut attaining it; -infinity and size() if the pool is empty
+    double max_value(const std::vector<double> &x, uint64_t k, size_t &index) const;
+
+    void clear();
+
+private:
+    // max_value at the point x of length dim, before the scale 1 / k
+    double max_scaled_value(const double *x, size_t &index) const;
+
+    size_t dim;
+    size_t stride;
+
+    std::vector<double> scaled_alpha;
+    std::vector<double> scaled_beta;
+    // float copies for the fast batch path, kept in step with the above
+    std::vector<float> scaled_alpha_float;
+    std::vector<float> scaled_beta_float;
+    std::vector<uint64_t> iterations;
+    std::vector<size_t> epigraphs;
+    std::vector<uint64_t> last_active;
+};
+
+#endif // CUT_POOL_H
@@ -0,0 +1,49 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+
+// Small dense vector kernels used on first-stage sized vectors
+// (directions, gradients, cut coefficients).
+//
+// For n <= MAX_FIXED_DIM the call is dispatched to a kernel specialized on
+// the dimension at compile time, which is fully unrolled. Larger n use the
+// generic loop. Both paths sum in the same order.
+namespace kernels
+{
+    constexpr size_t MAX_FIXED_DIM = 32;
+
+    // a^T b
+    double dot(const double *a, const double *b, size_t n);
+
+    // computes g^T d and g^T g in one pass
+    void dot_and_norm(const double *g, const double *d, size_t n, double &gd, double &gg);
+
+    // value of the cut alpha - beta^T x
+    double evaluate_cut(double alpha, const double *beta, const double *x, size_t n);
+
+    // d = lambda * d + (1 - lambda) * g, returns the new d^T d
+    double update_direction(double *d, const double *g, double lambda, size_t n);
+
+    // acc += scale * beta
+    void accumulate(double *acc, const double *beta, double scale, size_t n);
+
+    // Batch evaluation of a set of cuts at many points.
+    //
+    // beta holds ncuts rows and points holds npoints rows, both row-major with
+    // the same stride, a multiple of BATCH_LANES, zero padded. For each point p
+    //     value[p] = max_i alpha_i - beta_i x_p,   index[p] = the first i attaining it
+    // The cuts are streamed once per block of BATCH_POINTS points, every slope
+    // row is reused for the whole block, and each product is reduced into the
+    // running max as soon as it is formed (a GEMM with a fused max epilogue).
+    // Sums are formed in T: float is the fast path, double the exact one.
+    // ncuts must be positive. Large batches are split across OpenMP threads.
+    constexpr size_t BATCH_LANES = 8;
+    constexpr size_t BATCH_POINTS = 4;
+
+    template <typename T>
+    void max_cuts(const T *alpha, const T *beta, size_t ncuts, size_t stride,
+                  const T *points, size_t npoints, double *value, size_t *index);
+}
+
+#endif // KERNELS_H
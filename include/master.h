@@ -0,0 +1,129 @@
+#ifndef MASTER_H
+#define MASTER_H
+
+#include "prob.h"
+#include "cut_pool.h"
+#include <cstdint>
+#include <vector>
+
+// First stage master problem of a cutting plane method:
+//     min c x + sum_g w_g theta_g
+//     s.t. first stage constraints
+//          theta_g >= (t / k) (alpha - beta x) + (1 - t / k) L
+//                     for every cut (alpha, beta) of epigraph g from iteration t
+//          theta_g >= L
+// with L = epigraph_lower_bound: an aged cut falls back towards the lower
+// bound of the recourse (Higle and Sen). The cuts live in a CutPool as cuts
+// of phi_g = theta_g - L, (alpha - L, beta), in the lazily aged form, and the
+// model holds eta_g = k phi_g:
+//     min c x + sum_g (w_g / k) eta_g + sum_g w_g L
+//     s.t. eta_g + t beta x >= t (alpha - L),   eta_g >= 0
+// so aging changes only the objective coefficients of eta (see CutPool).
+// With L = -infinity nothing is shifted, eta is free and the cuts cannot age.
+//
+// The Gurobi model is built once by attach_solver and then kept in sync
+// incrementally: new cuts are added in one batched GRBaddconstrs call and
+// removed cuts in one GRBdelconstrs call. The cut rows follow the first stage
+// rows in the same order as the pool.
+//
+// The epigraph variables follow the first stage variables. When x_base is
+// set, the cut right hand sides are shifted like the first stage rows.
+class StageMasterProblem : public StageProblem
+{
+public:
+    // n_epigraph: number of epigraph variables, 1 for a single cut method
+    // epigraph_lower_bound: lower bound L of each theta_g, e.g. 0 for a nonnegative
+    // recourse; -infinity for none, which only allows iteration 1
+    StageMasterProblem(const smps::SMPSCore &cor, const smps::SMPSTime &tim,
+                       const smps::SMPSStoch &sto, size_t n_epigraph = 1,
+                       double epigraph_lower_bound = 0.0);
+
+    // a cut row counts as active if its slack or its dual is beyond this
+    static constexpr double ACTIVITY_TOLERANCE = 1e-8;
+
+    // builds the model with the epigraph variables and every cut in the pool
+    void attach_solver() override;
+
+    size_t get_num_epigraph() const;
+    double get_epigraph_lower_bound() const;
+
+    // the pool holds the cuts of theta_g - L (unshifted if L is -infinity)
+    const CutPool &get_cut_pool() const;
+
+    // add a cut created at iteration for epigraph variable epigraph
+    // it reaches the model on the next update_solver_cuts
+    size_t add_cut(const Cut &cut, uint64_t iteration, size_t epigraph = 0);
+
+    // set the iteration k: the objective coefficient of eta_g becomes w_g / k
+    // and the activity of the cuts is counted at k. k > 1 needs a finite L
+    void set_iteration(uint64_t k);
+    uint64_t get_iteration() const;
+
+    // count the activity of the cuts at k without aging them: for methods
+    // whose cuts never age (L-shaped) the master stays at iteration 1, so
+    // theta_g = eta_g, and only this advances. new cuts start active at k
+    void set_activity_iteration(uint64_t k);
+
+    // weights w_g of the epigraph variables, all 1 by default
+    void set_epigraph_weights(const std::vector<double> &weights);
+
+    // push pending cuts and the current x_base shift of the cut rows to the model
+    void update_solver_cuts();
+
+    // remove the cuts not active for more than max_inactive iterations,
+    // from the pool and the model; returns the number removed
+    size_t remove_inactive_cuts(uint64_t max_inactive);
+
+    // remove every cut of epigraph variable epigraph, e.g. to replace them
+    // with a newer set; returns the number removed
+    size_t remove_epigraph_cuts(size_t epigraph);
+
+    // box trust region |x_j - x_base_j| <= radius, intersected with the first
+    // stage bounds, on every later solve; needs x_base. infinity removes it
+    void set_trust_region(double radius);
+
+    // update the first stage rows and the cuts, solve, and mark the active cuts
+    // at the current iteration. the solution holds x (in d-space if x_base is set)
+    Solution solve_master();
+
+    // eta of the last solve in the unshifted form, k theta_g
+    std::vector<double> get_epigraph_values() const;
+
+private:
+    size_t n_epigraph;
+    double epigraph_lower_bound;
+    std::vector<double> epigraph_weights;
+    uint64_t iteration;
+    uint64_t activity_iteration;
+    double trust_radius;
+    bool trust_region_in_model;
+
+    CutPool pool;
+
+    // number of pool cuts in the model, always a prefix of the pool
+    size_t cuts_in_model;
+
+    // x_base the cut rows in the model are shifted by, empty if none
+    std::vector<double> cut_shift;
+
+    // right hand side of cut i shifted by the current x_base
+    double cut_rhs(size_t i) const;
+
+    // remove the cuts at the sorted pool indices from the pool and the model
+    size_t remove_cuts(const std::vector<size_t> &indices);
+
+    // set the objective coefficients of the epigraph variables
+    void update_solver_epigraph_objective();
+
+    // L if it is finite, else 0: the shift of the cuts and of theta
+    double epigraph_shift() const;
+
+    // set the bounds of x (d-space if x_base is set) to the first stage bounds
+    // intersected with the trust region
+    void update_solver_trust_region();
+
+    // read slacks and duals of the cut rows and mark the active cuts
+    void mark_active_cuts();
+};
+
+#endif // MASTER_H
@@ -0,0 +1,95 @@
+// MPI version of the independent approximations (README Design One)
+// built only with USE_MPI, see the twosd_mpi target of the Makefile
+
+#ifndef MPI_SD_H
+#define MPI_SD_H
+
+#ifdef USE_MPI
+
+#include <mpi.h>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "two_stage.h"
+
+// Rank 0 is the master, every other rank a worker owning one approximation,
+// whose scenario LPs run on nworkers OpenMP threads of that rank. Rank 0
+// attaches solvers to the master and projection problems only, the workers
+// to their scenario problems only.
+//
+// Every rank exposes one window of doubles, laid out as
+//     [stop, timestamp, candidate, incumbent | version, packed ApproximationSnapshot]
+// The master writes the first part of each worker window with MPI_Put under
+// an exclusive lock, and reads the second part with MPI_Get under a shared
+// lock, skipping the snapshot if its version has not changed. A worker locks
+// its own window to read the master state and to write a new snapshot.
+//
+// Construction, solve and destruction are collective over the communicator.
+class TwoStageMPISD : public TwoStageIndependentSP
+{
+public:
+    // napprox is ignored: there is one approximation per worker rank
+    using Options = IndependentSDOptions;
+
+    // what a worker did during solve
+    struct WorkerStats
+    {
+        // seconds in approximation steps, and waiting for the master
+        double busy = 0.0;
+        double wait = 0.0;
+        uint64_t steps = 0;
+        uint64_t samples = 0;
+
+        // fraction of the time spent working
+        double efficiency() const;
+    };
+
+    // needs at least two ranks
+    TwoStageMPISD(const std::string &base_path, const std::string &prob_name, int nworkers_,
+                  const Options &options_ = Options(), MPI_Comm comm_ = MPI_COMM_WORLD);
+    ~TwoStageMPISD();
+
+    TwoStageMPISD(const TwoStageMPISD &) = delete;
+    TwoStageMPISD &operator=(const TwoStageMPISD &) = delete;
+
+    // the incumbent and its estimate are broadcast to every rank at the end
+    void solve() override;
+
+    bool is_master() const;
+
+    // by worker rank 1 .. size - 1 (index 0 is empty), on the master after solve
+    const std::vector<WorkerStats> &get_worker_stats() const;
+
+private:
+    MPI_Comm comm;
+    int rank, nranks;
+
+    // window layout: the master state from STATE_OFFSET, the snapshot from snapshot_offset
+    static constexpr size_t STATE_OFFSET = 1;
+    size_t snapshot_offset, snapshot_capacity;
+    std::vector<double> window_buffer;
+    MPI_Win win;
+
+    // workers only
+    std::unique_ptr<SDApproximation> approximation;
+    std::mt19937 rng;
+
+    std::vector<uint64_t> snapshot_versions;
+    std::vector<WorkerStats> worker_stats;
+
+    void run_master();
+    void run_worker(WorkerStats &stats);
+
+    // master: put the state (and the stop flag) into every worker window
+    void publish_master_state(uint64_t timestamp, bool stop);
+
+    // master: read the snapshot of worker rank w if it changed
+    void read_snapshot(int w, std::vector<double> &packed);
+};
+
+#endif // USE_MPI
+
+#endif // MPI_SD_H
@@ -19,6 +19,11 @@ public:
     size_t rv_count;
 };
 
+// the random variables of the pattern's stage, taken from a full scenario
+// vector; omega is resized to pattern.rv_count
+void stage_omega(const StageStochasticPattern &pattern, const std::vector<double> &scenario,
+                 std::vector<double> &omega);
+
 // denotes where the randomness is in the current stage problem.
 // currently it does not support cost row randomness
 class StochasticPattern {
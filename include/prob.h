@@ -5,6 +5,7 @@
 #include "pattern.h"    // for StageStochasticPattern
 #include "utils.h"  // for approx_equal
 #include "gurobi_c.h"
+#include <memory>
 
 class CutHelper;   // forward declaration
 
@@ -48,7 +49,14 @@ public:
     // LP coefficients
     // transfer_block: (nrows, nvars_last) matrix
     // current_block: (nrows, nvars_current) matrix
-    SparseMatrix<double> transfer_block, current_block;
+    // immutable once read, and shared between copies of the problem
+    std::shared_ptr<const SparseMatrix<double>> transfer_block, current_block;
+
+    // row-major (CSR) copies of transfer_block and current_block, built once by read_smps
+    // the matrix-vector products go through these, and run in parallel for large blocks.
+    // they are shared in the same way, so every worker hands the same arrays to
+    // the solver in attach_solver without copying them
+    std::shared_ptr<const SparseMatrixCSR<double>> transfer_block_csr, current_block_csr;
 
     // lb, ub: lower/upper bound of the current stage variables
     // (nvars_current, )
@@ -93,10 +101,34 @@ public:
         // the dual solution
         // arranged as [pi, pi_fx, pi_lb, pi_ub]
         std::vector<double> dual_solution;        
+        // the dual solution in sparse form, same arrangement as dual_solution
+        // only filled if a sparse dual is requested and it is sparse enough,
+        // in which case dual_solution is left empty
+        SparseVector<double> sparse_dual_solution;
+        bool dual_is_sparse = false;
     };
 
+    // a requested sparse dual solution is returned in dense form
+    // if more than this fraction of its entries are non-zero
+    static constexpr double SPARSE_DUAL_MAX_DENSITY = 0.25;
+
+    // dual entries with absolute value at most this are dropped in the sparse form
+    static constexpr double SPARSE_DUAL_TOLERANCE = 1e-12;
+
     // solve the problem
-    Solution solve_problem(bool require_dual_solution = false);
+    // if sparse_dual is true, the dual solution is returned in sparse_dual_solution
+    // unless its density exceeds SPARSE_DUAL_MAX_DENSITY
+    Solution solve_problem(bool require_dual_solution = false, bool sparse_dual = false);
+
+    // the same into solution, reusing the storage of its vectors, so a loop
+    // over many scenarios does not allocate a Solution per solve
+    void solve_problem(Solution &solution, bool require_dual_solution = false, bool sparse_dual = false);
+
+    // rhs ranging of the optimal basis of the last solve: the rhs of each row
+    // can move alone within [low, up] and the basis stays optimal
+    // (Gurobi SARHSLow / SARHSUp); rhs is the current rhs of the rows.
+    // all three are resized to nrows
+    void get_rhs_ranging(std::vector<double> &rhs, std::vector<double> &low, std::vector<double> &up) const;
 
     // set x_base to the specified value and update cost_shift and rhs_shift
     void set_x_base(const std::vector<double> &x_base_);
@@ -165,10 +197,10 @@ public:
     void update_solver_bounds();
 
     // get primal solution from the solver
-    std::vector<double> get_primal_solution() const;
+    void get_primal_solution(std::vector<double> &solution) const;
 
     // get dual solution from the solver
-    std::vector<double> get_dual_solution() const;
+    void get_dual_solution(std::vector<double> &dual) const;
 
     // get the objective value from the solver
     double get_obj_value() const;
@@ -181,6 +213,9 @@ public:
 
     bool is_solver_attached() const;
 
+    // the current x_base, or nullptr if it is not set
+    const std::vector<double> *get_x_base() const;
+
     // the pointer to the solver environment
     GRBenv *env;
     GRBmodel *model;
@@ -0,0 +1,15 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <cstddef>
+#include <functional>
+
+// Sweep of independent tasks of uneven cost, such as the scenario LPs of a
+// batch of samples: run body(thread_id, task) for every task in [0, ntasks)
+// on an OpenMP team of nthreads with schedule(dynamic). Thread t always runs
+// body(t, task), so body can use per-thread state (e.g. the StageProblem of
+// worker t) without locks. The first exception stops the sweep and is
+// rethrown.
+void parallel_sweep(int nthreads, size_t ntasks, const std::function<void(int, size_t)> &body);
+
+#endif // SCHEDULER_H
@@ -102,6 +102,18 @@ namespace smps
         // returns (row_name, col_name) tuples describing the position of the random elements
         const std::vector<std::tuple<std::string, std::string>>& get_positions() const;
 
+        // a scenario of a finite distribution and its probability
+        struct Scenario
+        {
+            std::vector<double> omega;
+            double probability;
+        };
+
+        // every scenario of the distribution with its probability, the last element
+        // varying fastest; empty if an element is not discrete or there are more
+        // than max_scenarios of them
+        std::vector<Scenario> enumerate_scenarios(size_t max_scenarios) const;
+
     private:
         // Nested abstract class for stochastic elements
         class SMPSIndepElement
@@ -113,6 +125,9 @@ namespace smps
 
             // returns a string summary of the element
             virtual std::string element_summary() const = 0;
+
+            // the values and probabilities of a discrete element; false otherwise
+            virtual bool support(std::vector<double> &, std::vector<double> &) const { return false; }
         };
 
         // Concrete class for discrete stochastic elements
@@ -123,6 +138,7 @@ namespace smps
                               const std::vector<double> &_probs) : dist(_probs.begin(), _probs.end()), values(_values) {}
             double generate(std::mt19937 &rng) override;
             std::string element_summary() const override;
+            bool support(std::vector<double> &_values, std::vector<double> &_probs) const override;
 
         private:
             std::discrete_distribution<int> dist;
@@ -2,41 +2,61 @@
 #define SPARSE_H
 
 #include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
 #include <vector>
 #include <tuple>
 
-template <typename T>
+// T is the value type (float or double) and I is the index type.
+// int32_t is the compact default; use int64_t for matrices whose
+// dimensions or number of non-zeros exceed 2^31 - 1.
+template <typename T, typename I = int32_t>
 class SparseMatrix {
 public:
+    using value_type = T;
+    using index_type = I;
+
     // Constructors
     SparseMatrix();
-    SparseMatrix(const std::vector<int> &_row_indices, const std::vector<int> &_col_indices, 
+    SparseMatrix(const std::vector<I> &_row_indices, const std::vector<I> &_col_indices,
                  const std::vector<T> &_values, size_t _num_rows, size_t _num_cols);
 
+    // convert from a matrix with a different value type and/or index type
+    // throws std::overflow_error if the dimensions do not fit in I
+    template <typename U, typename J>
+    explicit SparseMatrix(const SparseMatrix<U, J> &other);
+
     // resize the matrix
     // this does not change the elements of the matrix
+    // throws std::overflow_error if the dimensions do not fit in I
     void resize(size_t _num_rows, size_t _num_cols);
 
     // add an element to the matrix
     // note that duplicate elements are not checked and will cause undefined behavior
-    void add_element(int row, int col, T value);
+    void add_element(I row, I col, T value);
 
     // number of non-zeros
     size_t nnz() const;
 
     // get the element at (row, col) or 0 if it is not in the matrix
-    T get_element(int row, int col) const;
+    T get_element(I row, I col) const;
 
     // multiply the matrix with a vector (as a column vector) and store the result in result
-    void multiply_with_vector(const std::vector<T> &vec, std::vector<T> &result) const;
+    // the vector may have a different value type than the matrix, the products are
+    // accumulated in the value type of the vector (V)
+    template <typename V>
+    void multiply_with_vector(const std::vector<V> &vec, std::vector<V> &result) const;
 
     // multiply the transpose of the matrix with a vector (as a column vector) and store the result in result
-    void multiply_transpose_with_vector(const std::vector<T> &vec, std::vector<T> &result) const;
+    template <typename V>
+    void multiply_transpose_with_vector(const std::vector<V> &vec, std::vector<V> &result) const;
 
     // result -= this * vec
     // subtracts the result of this * vec from result
     // assuming that result is already initialized to the correct size
-    void subtract_multiply_with_vector(const std::vector<T> &vec, std::vector<T> &result) const;
+    template <typename V>
+    void subtract_multiply_with_vector(const std::vector<V> &vec, std::vector<V> &result) const;
 
     // Iterator class
     // This class is used to iterate through the non-zero elements of the matrix
@@ -46,13 +66,13 @@ public:
 
         bool operator!=(const Iterator &other) const;
         const Iterator &operator++();
-        std::pair<int, int> position() const;
+        std::pair<I, I> position() const;
         T value() const;
 
         struct Element {
-            int row, col;
+            I row, col;
             T val;
-            Element(int _row, int _col, T _val);
+            Element(I _row, I _col, T _val);
         };
 
         Element operator*() const;
@@ -71,29 +91,195 @@ public:
 
     // Clear the matrix
     void clear();
-    
+
 private:
     size_t num_rows, num_cols;
-    std::vector<int> row_indices;
-    std::vector<int> col_indices;
+    std::vector<I> row_indices;
+    std::vector<I> col_indices;
     std::vector<T> values;
 };
 
+// Sparse vector stored as (index, value) pairs with increasing indices
+template <typename T, typename I = int32_t>
+struct SparseVector {
+    // length of the dense vector
+    size_t dim = 0;
+    std::vector<I> index;
+    std::vector<T> value;
+
+    // number of stored elements
+    size_t nnz() const;
+
+    // fraction of stored elements, nnz / dim
+    double density() const;
+
+    // keep the entries of dense with absolute value greater than tolerance
+    static SparseVector from_dense(const std::vector<T> &dense, T tolerance = T(0));
+
+    // the same in place, reusing the storage of index and value
+    void assign_dense(const std::vector<T> &dense, T tolerance = T(0));
+
+    // expand to a dense vector of length dim
+    std::vector<T> to_dense() const;
+};
+
 // CSR representation
+// T is the value type and I is the type of both the row offsets and the
+// column indices. Conversion throws std::overflow_error if the number of
+// non-zeros or the dimensions do not fit in I.
+template <typename T = double, typename I = int32_t>
 class SparseMatrixCSR {
 public:
-    explicit SparseMatrixCSR(const SparseMatrix<double>& matrix);
+    using value_type = T;
+    using index_type = I;
+
+    // products on matrices with at least this many non-zeros are split
+    // across OpenMP threads; smaller ones are always computed serially
+    static constexpr size_t PARALLEL_NNZ_THRESHOLD = 1 << 16;
+
+    // empty (0 x 0) matrix
+    SparseMatrixCSR();
+
+    template <typename U, typename J>
+    explicit SparseMatrixCSR(const SparseMatrix<U, J>& matrix);
+
+    // the arrays are filled once on construction and never reallocated afterwards,
+    // so their data() pointers stay valid for the lifetime of the object
+    const std::vector<I>& getRowBegin() const;
+    const std::vector<I>& getColumnIndex() const;
+    const std::vector<T>& getValues() const;
+
+    size_t get_num_rows() const;
+    size_t get_num_cols() const;
+    size_t nnz() const;
+
+    // result = this * vec
+    // rows are partitioned across threads by non-zero count when use_parallel() is true
+    template <typename V>
+    void multiply_with_vector(const std::vector<V> &vec, std::vector<V> &result) const;
+
+    // result = transpose(this) * vec
+    // in parallel mode each thread accumulates its row range into a private buffer,
+    // and the buffers are summed column-wise at the end
+    template <typename V>
+    void multiply_transpose_with_vector(const std::vector<V> &vec, std::vector<V> &result) const;
 
-    const std::vector<int>& getRowBegin() const;
-    const std::vector<int>& getColumnIndex() const;
-    const std::vector<double>& getValues() const;
+    // result = transpose(this) * vec for a sparse vec
+    // only the rows of the non-zero entries of vec are visited; entries past
+    // the last row are ignored. always serial.
+    template <typename V>
+    void multiply_transpose_with_vector(const SparseVector<V, I> &vec, std::vector<V> &result) const;
+
+    // result += transpose(this) * vec, always serial; for sums over many
+    // vectors kept by one thread. result must have get_num_cols() entries
+    template <typename V>
+    void add_multiply_transpose_with_vector(const std::vector<V> &vec, std::vector<V> &result) const;
+    template <typename V>
+    void add_multiply_transpose_with_vector(const SparseVector<V, I> &vec, std::vector<V> &result) const;
+
+    // result -= this * vec
+    // assuming that result is already initialized to the correct size
+    template <typename V>
+    void subtract_multiply_with_vector(const std::vector<V> &vec, std::vector<V> &result) const;
+
+    // true if the products will run in parallel: the matrix is large enough,
+    // more than one thread is available, and we are not already inside a
+    // parallel region (so worker threads never oversubscribe the machine)
+    bool use_parallel() const;
 
 private:
-    std::vector<int> cbeg;
-    std::vector<int> cind;
-    std::vector<double> cval;
+    size_t num_rows, num_cols;
+    std::vector<I> cbeg;
+    std::vector<I> cind;
+    std::vector<T> cval;
 
-    void convertToCSR(const SparseMatrix<double>& matrix);
+    // rows [first, second) assigned to part out of nparts, balanced by non-zeros
+    std::pair<size_t, size_t> row_range(int part, int nparts) const;
+
+    // result[r] += sign * (row r of this) * vec for rows in [row_begin, row_end)
+    template <typename V>
+    void multiply_rows(const std::vector<V> &vec, std::vector<V> &result, V sign,
+                       size_t row_begin, size_t row_end) const;
+
+    // result += sign * this * vec, serial or row-partitioned parallel
+    template <typename V>
+    void accumulate_multiply(const std::vector<V> &vec, std::vector<V> &result, V sign) const;
+
+    template <typename U, typename J>
+    void convertToCSR(const SparseMatrix<U, J>& matrix);
 };
 
+// deduce the CSR value and index type from the source matrix
+template <typename U, typename J>
+SparseMatrixCSR(const SparseMatrix<U, J>&) -> SparseMatrixCSR<U, J>;
+
+// returns true if value can be represented by the index type I
+template <typename I>
+constexpr bool fits_in_index(size_t value)
+{
+    return static_cast<unsigned long long>(value) <= static_cast<unsigned long long>(std::numeric_limits<I>::max());
+}
+
+template <typename T, typename I>
+template <typename U, typename J>
+SparseMatrix<T, I>::SparseMatrix(const SparseMatrix<U, J> &other) : SparseMatrix()
+{
+    resize(other.get_num_rows(), other.get_num_cols());
+    row_indices.reserve(other.nnz());
+    col_indices.reserve(other.nnz());
+    values.reserve(other.nnz());
+    for (auto it = other.begin(); it != other.end(); ++it)
+    {
+        auto element = *it;
+        add_element(static_cast<I>(element.row), static_cast<I>(element.col), static_cast<T>(element.val));
+    }
+}
+
+template <typename T, typename I>
+template <typename U, typename J>
+SparseMatrixCSR<T, I>::SparseMatrixCSR(const SparseMatrix<U, J>& matrix) {
+    convertToCSR(matrix);
+}
+
+template <typename T, typename I>
+template <typename U, typename J>
+void SparseMatrixCSR<T, I>::convertToCSR(const SparseMatrix<U, J>& matrix) {
+    num_rows = matrix.get_num_rows();
+    num_cols = matrix.get_num_cols();
+
+    if (!fits_in_index<I>(matrix.nnz()) || !fits_in_index<I>(num_rows) || !fits_in_index<I>(num_cols))
+        throw std::overflow_error("SparseMatrixCSR::convertToCSR: matrix too large for the index type, use a 64-bit index type");
+
+    // Initialize row begin array with zeroes
+    cbeg.assign(num_rows + 1, 0);
+
+    // First pass to count the number of elements in each row
+    for (auto it = matrix.begin(); it != matrix.end(); ++it) {
+        size_t row = static_cast<size_t>(it.position().first);
+        cbeg[row + 1]++;
+    }
+
+    // Cumulative sum to get actual starting positions
+    for (size_t i = 1; i < cbeg.size(); i++) {
+        cbeg[i] += cbeg[i - 1];
+    }
+
+    // Resize cind and cval to accommodate all non-zero elements
+    cind.resize(matrix.nnz());
+    cval.resize(matrix.nnz());
+
+    // Second pass to fill cind and cval
+    std::vector<I> next_pos(num_rows, 0);
+    for (auto it = matrix.begin(); it != matrix.end(); ++it) {
+        size_t row = static_cast<size_t>(it.position().first);
+        I col = static_cast<I>(it.position().second);
+        T value = static_cast<T>(it.value());
+
+        size_t pos = static_cast<size_t>(cbeg[row] + next_pos[row]);
+        cind[pos] = col;
+        cval[pos] = value;
+        next_pos[row]++;
+    }
+}
+
 #endif // SPARSE_H
@@ -1,57 +1,657 @@
-// // Single machine version of TwoSD using OpenMP
+// Single machine version of TwoSD using OpenMP
 
-// #ifndef TWO_STAGE_H
-// #define TWO_STAGE_H
+#ifndef TWO_STAGE_H
+#define TWO_STAGE_H
 
-// #include <cstddef>
-// #include <omp.h>
-// #include <memory> // unique_ptr
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <omp.h>
+#include <exception>
+#include <memory> // unique_ptr
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
 
-// #include "smps.h"
-// #include "prob.h"
-// #include "cut_helper.h"
-// #include "projection.h"
+#include "smps.h"
+#include "prob.h"
+#include "cut_helper.h"
+#include "projection.h"
+#include "master.h"
+#include "argmax.h"
+#include "vector_container.h"
+#include "approximation.h"
+#include "window.h"
+#include "validator.h"
+#include "scs.h"
 
-// class TwoStageSP
-// {
-// public:
-//     TwoStageSP(const std::string base_path, const std::string prob_name, int nworkers_);
+class TwoStageSP
+{
+public:
+    // the solvers a process attaches: a process that only runs the master
+    // keeps a single second stage problem without a solver for its data, and
+    // one that only runs workers keeps the master problems without solvers
+    enum class Solvers
+    {
+        ALL,
+        MASTER,
+        WORKERS
+    };
 
-// protected:
-//     // number of workers
-//     int nworkers;
+    TwoStageSP(const std::string &base_path, const std::string &prob_name, int nworkers_,
+               Solvers solvers = Solvers::ALL);
+    virtual ~TwoStageSP() = default;
 
-//     // Stage Problem
-//     // root stage problem
-//     std::unique_ptr<StageProblem> prob0;
+    // solve the problem
+    virtual void solve() = 0;
 
-//     // second stage problem: one for each worker
-//     std::vector<std::unique_ptr<StageProblem>> prob1;
+protected:
+    // number of workers
+    int nworkers;
 
-//     // solve the problem
-//     virtual void solve() = 0;
+    // smps data
+    smps::SMPSCore cor;
+    smps::SMPSImplicitTime tim;
+    smps::SMPSStoch sto;
 
-//     // smps data
-//     smps::SMPSCore cor;
-//     smps::SMPSImplicitTime tim;
-//     smps::SMPSStoch sto;
+    // second stage problem: one for each worker, each solver single threaded
+    std::vector<std::unique_ptr<StageProblem>> prob1;
 
-// };
+    // the second stage part of a full scenario vector
+    std::vector<double> second_stage_omega(const std::vector<double> &scenario) const;
+};
 
-// class TwoStageSCS : public TwoStageSP
-// {
-// public:
-//     TwoStageSCS(const std::string base_path, const std::string prob_name, int nworkers_);
-//     void solve() override;
+// options of TwoStageSD
+struct SDOptions
+{
+    uint64_t max_iterations = 1000;
+    // the stopping test is not checked before this
+    uint64_t min_iterations = 50;
+    // stop when the predicted decrease is at most tolerance * (1 + |f_k(incumbent)|)
+    double tolerance = 1e-4;
 
-// private:
-//     // problem used for projection
-//     std::unique_ptr<StageProjectionProblem> proj_prob0;
+    // new scenarios per iteration, 0 for one per worker
+    size_t samples_per_iteration = 0;
+    unsigned int seed = 0;
 
-//     // solve all subproblems, returning a list of solutions
-//     std::pair <
-//         std::vector<StageProblem::Solution>,
-//         std::vector<Cut> > solve_subproblems(const std::vector<double> &x, const std::vector<std::vector<double>> &samples);
-// };
+    // dual vertices kept, and how a slot is chosen once full
+    size_t max_duals = 1 << 16;
+    VectorContainer::EvictionPolicy eviction_policy = VectorContainer::EvictionPolicy::LEAST_HITS;
 
-// #endif // TWO_STAGE_H
\ No newline at end of file
+    // regularization: sigma is halved on an accepted candidate and doubled
+    // on a rejected one, within [min_sigma, max_sigma]
+    double sigma = 1.0;
+    double min_sigma = 1e-3;
+    double max_sigma = 1e3;
+
+    // the incumbent test ratio r in (0, 1)
+    double incumbent_ratio = 0.2;
+
+    // cuts inactive for more than this many iterations are dropped
+    uint64_t max_inactive = 50;
+
+    // online validation (README Design Three): with validation_gap > 0 a
+    // Validator estimates f(incumbent) out of sample on validation_threads
+    // problems of its own, and solve also stops once the pessimistic gap to
+    // min f_k, the master solved without the proximal term, is at most
+    // validation_gap. f_k(candidate) is no bound: the regularized master does
+    // not minimize f_k
+    double validation_gap = 0.0;
+    int validation_threads = 1;
+    ValidatorOptions validation;
+
+    // print one line per iteration
+    bool verbose = false;
+};
+
+// Common part of the regularized SD methods: the master problem
+//     min c x + sum_g w_g theta_g + sigma / 2 ||x - incumbent||^2
+// solved in the d-space around the incumbent, the incumbent and candidate,
+// and the adaptation of sigma.
+class TwoStageRegularizedSP : public TwoStageSP
+{
+public:
+    TwoStageRegularizedSP(const std::string &base_path, const std::string &prob_name, int nworkers_,
+                          const SDOptions &options_, size_t n_epigraph, Solvers solvers = Solvers::ALL);
+
+    // the first stage solution
+    const std::vector<double> &get_incumbent() const;
+
+    // f(incumbent): first stage cost plus the approximation of the recourse
+    double get_incumbent_estimate() const;
+
+    // number of master iterations
+    uint64_t get_iterations() const;
+
+    // the out of sample estimate of f(incumbent), empty without validation
+    Validator::Estimate get_validation() const;
+
+    // the last pessimistic gap, infinity without validation
+    double get_validation_gap() const;
+
+protected:
+    SDOptions options;
+
+    std::unique_ptr<StageMasterProblem> master;
+    std::unique_ptr<StageProjectionProblem> proj_prob0;
+
+    // iteration counter, and the current sigma
+    uint64_t iteration;
+    double sigma;
+
+    std::vector<double> candidate, incumbent;
+    double incumbent_estimate;
+
+    // set the candidate and the incumbent to the projection of the origin
+    // onto the first stage feasible set, and the initial regularization
+    void start();
+
+    // halve sigma on an accepted candidate and double it on a rejected one
+    void update_sigma(bool accepted);
+
+    // solve the master around the incumbent with the current sigma, returns the candidate
+    std::vector<double> solve_master();
+
+    // the worker problems [first, first + count) as raw pointers
+    std::vector<StageProblem *> worker_group(size_t first, size_t count) const;
+
+    // start validating the incumbent if options.validation_gap > 0, after start()
+    void start_validation();
+
+    // min f_k over the first stage: the master without the proximal term,
+    // which needs a bounded first stage LP. leaves the quadratic term removed
+    double model_lower_bound();
+
+    // move the validator to the incumbent (restarting it if the incumbent
+    // changed), and true if the pessimistic gap to model_lower_bound() is
+    // small enough; the bound is only solved for once the estimate is ready
+    bool validated();
+
+    void stop_validation();
+
+private:
+    // the validator reads its own copy of the problem
+    std::string base_path, prob_name;
+    std::unique_ptr<Validator> validator;
+    double last_gap;
+};
+
+// Regularized stochastic decomposition (Higle and Sen).
+//
+// Iteration k:
+//  1. draw samples_per_iteration new scenarios and solve their second stage
+//     LPs at the candidate and the incumbent, in parallel on the per-worker
+//     problems (SDApproximation)
+//  2. for every sample so far, find the best stored dual at the candidate and
+//     at the incumbent with the ArgmaxEngine; the two SD cuts are added to the
+//     master at iteration k, where the older cuts age by (k - 1) / k
+//  3. incumbent test: the candidate replaces the incumbent if the new
+//     approximation confirms a fraction of the decrease the master predicted
+//  4. solve the regularized master for the next candidate
+//
+// Cut aging assumes a nonnegative recourse function.
+class TwoStageSD : public TwoStageRegularizedSP
+{
+public:
+    using Options = SDOptions;
+
+    // wall time in seconds spent in each phase of solve()
+    struct Timing
+    {
+        double sampling = 0.0;
+        double subproblems = 0.0;
+        double argmax = 0.0;
+        double master = 0.0;
+        double incumbent = 0.0;
+        double total = 0.0;
+    };
+
+    TwoStageSD(const std::string &base_path, const std::string &prob_name, int nworkers_,
+               const Options &options_ = Options());
+
+    void solve() override;
+
+    size_t get_num_samples() const;
+    const Timing &get_timing() const;
+
+private:
+    SDApproximation approximation;
+    std::mt19937 rng;
+    Timing timing;
+
+    // f_k(x) = c x + max(L, max over the cuts at iteration k), with L the
+    // epigraph lower bound of the master
+    double evaluate(const std::vector<double> &x, uint64_t k) const;
+
+    // f_k at the points stored back to back, through one CutPool::max_values
+    void evaluate(const std::vector<double> &points, uint64_t k, std::vector<double> &values) const;
+};
+
+// options of the independent approximations
+struct IndependentSDOptions : SDOptions
+{
+    // number of independent approximations, each owned by a group of
+    // nworkers / napprox threads (threads only; under MPI every worker rank
+    // owns one)
+    size_t napprox = 2;
+
+    // a worker takes at most this many steps between two master updates,
+    // and the master updates on snapshots at most this many timestamps old
+    uint64_t max_sample_count = 4;
+};
+
+// Master side of README Design One: several independent SD approximations
+// Q_j, combined as sum_j alpha_j Q_j with alpha_j proportional to the number
+// of samples behind Q_j.
+//
+// The workers publish ApproximationSnapshots; the derived class moves them
+// here and the master state (timestamp, candidate, incumbent) back. A master
+// update needs a new snapshot, and cuts from every approximation at points at
+// most max_sample_count timestamps old, so it does not wait for the slowest.
+class TwoStageIndependentSP : public TwoStageRegularizedSP
+{
+public:
+    // wall time in seconds of the master
+    struct Timing
+    {
+        // reading the snapshots and updating the cuts
+        double read = 0.0;
+        double master = 0.0;
+        double incumbent = 0.0;
+        // waiting for new snapshots
+        double wait = 0.0;
+        double total = 0.0;
+    };
+
+    TwoStageIndependentSP(const std::string &base_path, const std::string &prob_name, int nworkers_,
+                          const IndependentSDOptions &options_, size_t napprox_, Solvers solvers = Solvers::ALL);
+
+    // samples behind each approximation in the last master update
+    std::vector<uint64_t> get_sample_counts() const;
+    const Timing &get_timing() const;
+
+protected:
+    size_t napprox;
+    uint64_t max_sample_count;
+
+    Timing timing;
+
+    // [timestamp, candidate, incumbent]
+    size_t master_state_size() const;
+    void pack_master_state(uint64_t timestamp, std::vector<double> &state) const;
+
+    // replace the cuts of epigraph j with those of a newer snapshot of Q_j
+    void set_snapshot(size_t j, ApproximationSnapshot snapshot);
+
+    // true if a snapshot arrived since the last update and every
+    // approximation has published cuts at most max_sample_count timestamps
+    // before timestamp
+    bool ready(uint64_t timestamp) const;
+
+    // one master iteration on the current snapshots: weights, incumbent test
+    // and the regularized master; predicted_decrease carries the prediction
+    // from one update to the next. returns true if the stopping test holds
+    bool update(double &predicted_decrease);
+
+private:
+    std::vector<ApproximationSnapshot> snapshots;
+    bool new_snapshot;
+
+    // sum_j alpha_j max(0, Q_j(x)) plus the first stage cost
+    double evaluate(const std::vector<double> &x, const std::vector<double> &weights) const;
+};
+
+// README Design One on threads.
+//
+// Each approximation is owned by a worker thread with its own group of
+// second stage problems. A step of a worker (SDApproximation::step) adds
+// samples_per_iteration samples, builds the SD cuts at the candidate and the
+// incumbent and ages and prunes its own cuts; the worker then publishes the
+// snapshot in its SeqlockWindow.
+//
+// The master (the calling thread) reads the latest snapshots without locks,
+// replaces the cuts of the epigraph variables whose snapshot changed, and
+// updates as soon as ready() holds. The new candidate, incumbent and
+// timestamp go out through another window. A worker that has taken
+// max_sample_count steps since the last timestamp waits for the next. Both
+// sides sleep on a condition variable while they wait.
+class TwoStageIndependentSD : public TwoStageIndependentSP
+{
+public:
+    using Options = IndependentSDOptions;
+
+    TwoStageIndependentSD(const std::string &base_path, const std::string &prob_name, int nworkers_,
+                          const Options &options_ = Options());
+
+    void solve() override;
+
+private:
+    std::vector<std::unique_ptr<SDApproximation>> approximations;
+
+    // workers to master: one ApproximationSnapshot per approximation
+    std::vector<std::unique_ptr<SeqlockWindow>> cut_windows;
+    std::vector<uint64_t> snapshot_versions;
+    // master to workers: the master state
+    SeqlockWindow master_window;
+    std::atomic<bool> stop;
+
+    // wakes the master on a new snapshot and the workers on a new timestamp
+    // or stop; the counters change under progress_mutex
+    std::mutex progress_mutex;
+    std::condition_variable progress;
+    uint64_t snapshots_published, published_timestamp;
+
+    // set stop and wake every waiting thread
+    void halt();
+
+    // first error of each worker, rethrown by solve
+    std::vector<std::exception_ptr> worker_errors;
+
+    // sto is shared by the workers
+    std::mutex sampling_mutex;
+
+    // the loop of the worker owning approximation j
+    void run_worker(size_t j);
+};
+
+// options of TwoStageSCS
+struct SCSOptions
+{
+    // the sample average is taken over num_samples scenarios, drawn once
+    // (see max_samples for a growing pool)
+    size_t num_samples = 1000;
+    unsigned int seed = 0;
+
+    uint64_t max_iterations = 1000;
+    // stop when the squared norm of the SCS direction is at most this
+    double tolerance = 1e-8;
+
+    // the line search bisects [0, max_step] at most max_line_search times
+    double max_step = 10.0;
+    int max_line_search = 30;
+
+    // speculative line search: the midpoints of the next speculation_depth
+    // bisection levels (2^depth - 1 steps) are evaluated together in one
+    // sweep, then the bisection is replayed on them; 1 is plain bisection.
+    // Each round does up to 2^depth - 1 evaluations in the time of about
+    // one when the threads would otherwise idle (few samples per thread)
+    int speculation_depth = 1;
+
+    // adaptive sample size: with max_samples > num_samples the pool starts at
+    // num_samples and grows after a step while the sample variance at the new
+    // point fails a test, by new samples appended to the pool (the ones
+    // already drawn keep their cached solutions). the tests, with g_i the
+    // subgradient of sample i and g their mean:
+    //   NORM           tr Var(g_i) / N <= theta^2 ||g||^2
+    //   INNER_PRODUCT  Var(g_i' v) / N <= theta^2 (g' v)^2, v the gradient
+    //                  before the step as an estimate of the direction of g
+    // and with objective_ratio > 0 also the standard error of f at most
+    // objective_ratio times the decrease of the step. N grows to the size that
+    // passes, at most by max_growth times per step
+    enum class SampleTest { NORM, INNER_PRODUCT };
+    size_t max_samples = 0;
+    SampleTest sample_test = SampleTest::NORM;
+    double theta = 0.5;
+    double objective_ratio = 0.0;
+    double max_growth = 2.0;
+
+    // keep the cut and the rhs ranging of the last solve of every sample, and
+    // skip the LP at a new point while the 100% rule on the ranging shows the
+    // basis is still optimal; the cut is then exact there
+    bool reuse_solutions = true;
+
+    // print one line per iteration
+    bool verbose = false;
+};
+
+// Sample average approximation min c x + 1 / N sum_i h(x, omega_i) over the
+// first stage feasible set, solved by successive conjugate subgradients (SCS)
+// with projected steps and a bisection line search on the L and R conditions.
+//
+// Every evaluation sweeps the N scenario LPs with parallel_sweep.
+// Each thread adds the objective values and the cuts of its scenarios into
+// its own accumulator as it solves them, and the accumulators are summed in
+// a tree. With reuse_solutions, the samples are common random numbers for
+// all trial points, so a sample whose last basis is still optimal at the new
+// point is answered from its cached cut without a solve. With max_samples the
+// pool grows from num_samples as the sample variance asks for it.
+class TwoStageSCS : public TwoStageSP
+{
+public:
+    using Options = SCSOptions;
+
+    TwoStageSCS(const std::string &base_path, const std::string &prob_name, int nworkers_,
+                const Options &options_ = Options());
+
+    void solve() override;
+
+    const std::vector<double> &get_solution() const;
+    // the sample average objective at the solution
+    double get_objective() const;
+    uint64_t get_iterations() const;
+    // the current size of the sample pool
+    size_t get_num_samples() const;
+
+    // scenario LPs solved, and evaluations answered from the last basis
+    struct SweepStats
+    {
+        uint64_t solves = 0;
+        uint64_t reuses = 0;
+    };
+    const SweepStats &get_sweep_stats() const;
+
+private:
+    Options options;
+
+    // problem used for projection, also holds the first stage cost
+    std::unique_ptr<StageProjectionProblem> proj_prob0;
+
+    std::mt19937 rng;
+    std::vector<std::vector<double>> samples;
+
+    // sums over the scenarios of one thread at one point, reused by every
+    // sweep; point p of thread t at p * nworkers + t. the squares are only
+    // summed with adaptive sampling
+    struct alignas(64) Accumulator
+    {
+        double objective = 0.0;
+        Cut cut;
+        double objective_sq = 0.0;
+        std::vector<double> beta_sq;
+        double inner = 0.0, inner_sq = 0.0;
+    };
+    std::vector<Accumulator> accumulators;
+
+    // sample variances at a point: of h(x, omega_i), the trace of that of the
+    // subgradients, and of their inner product with reference
+    struct SampleVariance
+    {
+        double objective = 0.0;
+        double gradient = 0.0;
+        double inner = 0.0;
+    };
+    std::vector<SampleVariance> variances;
+    // v of the inner product test, empty for none
+    std::vector<double> reference;
+
+    // per sample: the point of the last solve, the cut there, and how far the
+    // rhs of each row can go up and down from there with the basis unchanged
+    struct SolutionCache
+    {
+        bool valid = false;
+        std::vector<double> x;
+        Cut cut;
+        std::vector<double> room_up, room_down;
+    };
+    std::vector<SolutionCache> cache;
+
+    // per thread scratch and counters
+    struct alignas(64) Workspace
+    {
+        std::vector<double> dx, drhs, rhs, low, up;
+        // the last scenario solve, its vectors reused across samples
+        StageProblem::Solution solution;
+        Cut cut;
+        SweepStats stats;
+    };
+    std::vector<Workspace> workspaces;
+    SweepStats sweep_stats;
+
+    std::vector<double> x;
+    double objective;
+    uint64_t iteration;
+
+    // true if the cached basis of the sample with random elements omega is
+    // still optimal at point: with d = -T(omega) (point - cache.x), the 100%
+    // rule sum_r |d_r| / room_r <= 1
+    bool basis_holds(const SolutionCache &entry, const std::vector<double> &omega,
+                     const std::vector<double> &point, Workspace &ws) const;
+
+    // f(x) = c x + 1 / N sum_i h(x, omega_i), and its subgradient
+    // c - 1 / N sum_i beta_i in grad
+    double evaluate(const std::vector<double> &x_eval, std::vector<double> &grad);
+
+    // the same at several points in one sweep over the samples, each task
+    // visiting every point; with adaptive sampling also the variances
+    void evaluate(const std::vector<const std::vector<double> *> &points, std::vector<double> &values,
+                  std::vector<std::vector<double>> &grads);
+
+    // one line search from x along -direction; x_forward, f_forward and
+    // grad_forward are set to the accepted (or last) point, and
+    // variance_forward to its sample variances. returns the step
+    double line_search(const UnconstrainedSCS &scs, const std::vector<double> &direction,
+                       std::vector<double> &x_forward, double &f_forward, std::vector<double> &grad_forward,
+                       SampleVariance &variance_forward);
+
+    // the pool size the sample size tests ask for at a point with subgradient
+    // grad, after a step that decreased f by decrease
+    size_t next_sample_size(const SampleVariance &variance, const std::vector<double> &grad, double decrease) const;
+
+    // append count new samples to the pool
+    void add_samples(size_t count);
+
+    // move x onto the first stage feasible set
+    void project(std::vector<double> &x_proj);
+};
+
+// options of TwoStageLShaped
+struct LShapedOptions
+{
+    uint64_t max_iterations = 1000;
+    // stop when f(best) - m(candidate) <= tolerance * (1 + |f(best)|), with m
+    // the master objective; a bound on the gap without a trust region
+    double tolerance = 1e-6;
+
+    // the scenarios are enumerated if the distribution is finite with at most
+    // max_scenarios of them, otherwise num_samples are drawn with equal
+    // probability (sample average approximation)
+    size_t max_scenarios = 1 << 16;
+    size_t num_samples = 1000;
+    unsigned int seed = 0;
+
+    // the scenarios are split into num_clusters contiguous clusters, each with
+    // its own epigraph variable and cut; 0 for one per scenario (multi-cut),
+    // 1 for the single cut method
+    size_t num_clusters = 0;
+
+    // cuts inactive for more than this many iterations are dropped
+    uint64_t max_inactive = 100;
+
+    // a lower bound on h(x, omega) over the first stage set and the scenarios.
+    // the epigraph variable of a cluster with probability P is bounded below
+    // by recourse_lower_bound times P (the largest P if negative, the
+    // smallest if positive), which keeps the first masters bounded. the
+    // default 0 assumes a nonnegative recourse, as SD does; -infinity assumes
+    // nothing but needs the first cuts to bound the master
+    double recourse_lower_bound = 0.0;
+
+    // box trust region around the incumbent with trust_region > 0 as the
+    // initial radius, in [min_trust_region, max_trust_region]. the candidate
+    // becomes the incumbent if f decreases by at least acceptance_ratio of the
+    // decrease the master predicted
+    double trust_region = 0.0;
+    double min_trust_region = 1e-6;
+    double max_trust_region = 1e6;
+    double acceptance_ratio = 1e-4;
+
+    // print one line per iteration
+    bool verbose = false;
+};
+
+// Multi-cut L-shaped method (Birge and Louveaux) on a finite set of
+// scenarios, as an exact baseline for SD.
+//
+// Iteration k:
+//  1. solve the second stage LPs of every scenario at the candidate with
+//     parallel_sweep, which gives f(candidate) exactly and one cut per
+//     scenario
+//  2. sum the cuts of each cluster with the scenario probabilities, and add
+//     those above the epigraph value of their cluster in the master
+//  3. with a trust region, the incumbent test and the new radius
+//  4. drop the cuts inactive for max_inactive iterations and solve the
+//     master for the next candidate
+//
+// The cuts are exact and never age, so the master stays at iteration 1 and
+// theta_g = eta_g. The epigraph variables are bounded below through
+// recourse_lower_bound, by default 0 for a nonnegative recourse.
+class TwoStageLShaped : public TwoStageSP
+{
+public:
+    using Options = LShapedOptions;
+
+    // wall time in seconds spent in each phase of solve()
+    struct Timing
+    {
+        double subproblems = 0.0;
+        double cuts = 0.0;
+        double master = 0.0;
+        double total = 0.0;
+    };
+
+    TwoStageLShaped(const std::string &base_path, const std::string &prob_name, int nworkers_,
+                    const Options &options_ = Options());
+
+    void solve() override;
+
+    // the best first stage solution found, and f there
+    const std::vector<double> &get_solution() const;
+    double get_objective() const;
+
+    // the largest master objective over the iterations, a lower bound on the
+    // optimum; -infinity with a trust region, where the master only sees the box
+    double get_lower_bound() const;
+
+    uint64_t get_iterations() const;
+    size_t get_num_scenarios() const;
+    // true if the scenarios are the whole distribution, not a sample
+    bool is_exact() const;
+    const Timing &get_timing() const;
+
+private:
+    Options options;
+
+    std::unique_ptr<StageMasterProblem> master;
+    std::unique_ptr<StageProjectionProblem> proj_prob0;
+
+    // second stage part of each scenario, its probability and cluster
+    std::vector<std::vector<double>> scenarios;
+    std::vector<double> probabilities;
+    std::vector<size_t> clusters;
+    bool exact;
+
+    // per scenario results of the last sweep
+    std::vector<double> scenario_values;
+    std::vector<Cut> scenario_cuts;
+
+    std::vector<double> solution;
+    double objective, lower_bound;
+    uint64_t iteration;
+    Timing timing;
+
+    // f(x) = c x + sum_s p_s h(x, omega_s), and the cut of every cluster in cluster_cuts
+    double evaluate(const std::vector<double> &x, std::vector<Cut> &cluster_cuts);
+};
+
+#endif // TWO_STAGE_H
@@ -0,0 +1,135 @@
+// Online validation of the incumbent (README Design Three)
+
+#ifndef VALIDATOR_H
+#define VALIDATOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "smps.h"
+#include "prob.h"
+
+// Running mean and variance of a stream of values (Welford).
+class RunningStats
+{
+public:
+    void add(double value);
+    void reset();
+
+    uint64_t count() const;
+    double mean() const;
+    // sample variance, 0 with less than two values
+    double variance() const;
+    // standard error of the mean
+    double std_error() const;
+
+private:
+    uint64_t n = 0;
+    double running_mean = 0.0;
+    // sum of squared deviations from the mean
+    double m2 = 0.0;
+};
+
+// options of the Validator
+struct ValidatorOptions
+{
+    // scenarios drawn per batch, solved in parallel on the validator problems
+    size_t batch_size = 8;
+
+    // no gap is reported before this many scenarios at the current point
+    uint64_t min_samples = 100;
+
+    // the confidence interval is mean +- z * std_error
+    double z = 1.96;
+
+    // the validator stream, independent of the optimizer streams
+    unsigned int seed = 20240101;
+};
+
+// Estimates f(x) = c x + E[h(x, omega)] at a point x out of sample, on a
+// thread of its own, while the optimizer runs.
+//
+// The validator reads its own copy of the SMPS files, so it has its own
+// second stage problems (one per thread, single threaded solvers) and its own
+// random stream. A new point restarts the estimate; a batch in flight for the
+// old point is dropped.
+class Validator
+{
+public:
+    // the estimate at the current point
+    struct Estimate
+    {
+        // number of set_point calls that changed the point
+        uint64_t point_version = 0;
+        uint64_t count = 0;
+        double mean = 0.0;
+        double std_error = 0.0;
+        // the confidence interval of f(x)
+        double lower = 0.0;
+        double upper = 0.0;
+    };
+
+    Validator(const std::string &base_path, const std::string &prob_name, int nthreads,
+              const ValidatorOptions &options_ = ValidatorOptions());
+    ~Validator();
+
+    Validator(const Validator &) = delete;
+    Validator &operator=(const Validator &) = delete;
+
+    // start the validation thread, which waits for the first point
+    void start();
+
+    // stop the thread; rethrows an error it met
+    void stop();
+
+    // validate x from now on; returns false (and keeps the estimate) if x is
+    // the current point
+    bool set_point(const std::vector<double> &x);
+
+    Estimate get_estimate() const;
+
+    // (upper - lower_bound) / (1 + |upper|), with upper the upper confidence
+    // limit of f(point); infinity before min_samples scenarios
+    double pessimistic_gap(double lower_bound) const;
+
+    // the first stage dimension
+    size_t dimension() const;
+
+private:
+    ValidatorOptions options;
+
+    smps::SMPSCore cor;
+    smps::SMPSImplicitTime tim;
+    smps::SMPSStoch sto;
+
+    std::vector<double> cost_coefficients;
+    std::vector<std::unique_ptr<StageProblem>> prob1;
+    std::mt19937 rng;
+
+    // the point and its statistics, guarded by mutex
+    mutable std::mutex mutex;
+    std::condition_variable point_changed;
+    std::vector<double> point;
+    uint64_t point_version;
+    RunningStats stats;
+
+    std::thread thread;
+    std::atomic<bool> stopping;
+    std::exception_ptr thread_error;
+
+    void run();
+
+    // f(x) at each sample, solved in parallel
+    void evaluate_batch(const std::vector<double> &x, const std::vector<std::vector<double>> &samples,
+                        std::vector<double> &values);
+};
+
+#endif // VALIDATOR_H
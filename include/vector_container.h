@@ -1,15 +1,33 @@
+#ifndef VECTOR_CONTAINER_H
+#define VECTOR_CONTAINER_H
+
 #include <vector>
 #include <optional>
 #include <cstddef>
+#include <cstdint>
+#include <atomic>
 #include <unordered_map>
+#include "aligned_storage.h"
 
 class VectorContainer
 {
 public:
     static constexpr size_t GROUP_SIZE = 8;
 
+    // how the slot of a new vector is chosen once the container is full
+    // ROUND_ROBIN: overwrite the oldest vector
+    // LEAST_HITS: overwrite the vector with the lowest hit rate, hits per
+    //     timestamp since it was inserted
+    // LEAST_RECENT_WIN: overwrite the vector whose last hit is the oldest
+    // hits are reported by the consumer through record_hit. the usage-aware
+    // policies never evict a vector inserted at the latest timestamp, so a new
+    // vector gets a chance to win; if all are that new, round robin is used.
+    enum class EvictionPolicy { ROUND_ROBIN, LEAST_HITS, LEAST_RECENT_WIN };
+
     // Constructor
-    VectorContainer(size_t max_vectors, size_t vector_dim);
+    // the storage is aligned to STORAGE_ALIGNMENT bytes; see StorageOptions
+    // for huge pages and NUMA first-touch placement of whole vectors
+    VectorContainer(size_t max_vectors, size_t vector_dim, const StorageOptions &options = StorageOptions());
 
     // Destructor
     ~VectorContainer();
@@ -32,21 +50,47 @@ public:
     size_t get_vector_dims() const;
     size_t get_padding_dims() const;
     size_t size() const;
+    size_t capacity() const;
     std::vector<float> get(size_t index) const;
     const float *data() const;
 
+    // double precision copies, only if the container was built with
+    // StorageOptions::double_copy. vectors inserted as float are widened.
+    bool has_double_copy() const;
+    std::vector<double> get_double(size_t index) const;
+    // vector_dim doubles per slot, without padding
+    const double *double_data() const;
+
+    // Eviction
+    void set_eviction_policy(EvictionPolicy policy);
+    EvictionPolicy get_eviction_policy() const;
+
+    // record that the vector at index won count times at timestamp
+    // timestamps are expected to be non-decreasing, e.g. the iteration number
+    void record_hit(size_t index, uint64_t timestamp, uint64_t count = 1);
+    uint64_t get_hits(size_t index) const;
+    uint64_t get_last_hit(size_t index) const;
+
     // Sync related functions
     size_t get_current_position() const;
     size_t get_sync_position() const;
     bool get_wrap_around_flag() const;
 
+    // slots overwritten by a usage-aware eviction since the last reset_sync_range
+    // these are not covered by the range [sync position, current position)
+    const std::vector<size_t> &get_replaced_indices() const;
+
     void reset_sync_range();
 
 protected:
     size_t max_vectors;
     size_t vector_dim;
     size_t padded_vector_dim;
-    size_t pad_and_store(const float *src);
+    // exact is the double precision source of src, if the caller has one
+    size_t pad_and_store(const float *src, const double *exact = nullptr);
+
+    // slot the next inserted vector will be stored in
+    size_t next_insert_position() const;
 
     size_t current_size;
     size_t current_position;
@@ -56,8 +100,19 @@ private:
     size_t sync_start_position;
     bool wrap_around_flag;
     bool full_flag;
+    std::vector<size_t> replaced_indices;
+    std::vector<char> replaced_flag;
+
+    // usage statistics per slot
+    EvictionPolicy eviction_policy;
+    uint64_t clock;
+    std::vector<uint64_t> hits, last_hit, inserted_at;
+
+    // least useful slot under the eviction policy, if one can be evicted
+    std::optional<size_t> select_victim() const;
 
     float *data_storage;
+    std::vector<double> double_storage;
 
     size_t calculate_padded_dim(size_t dim) const;
 };
@@ -65,21 +120,134 @@ private:
 class UniqueVectorContainer : public VectorContainer
 {
 public:
-    // Inherit constructors
-    using VectorContainer::VectorContainer;
+    UniqueVectorContainer(size_t max_vectors, size_t vector_dim, const StorageOptions &options = StorageOptions());
 
     static constexpr float TOLERANCE = 1e-6;
+
+    // coordinates are quantized to cells of this width for hashing
+    // vectors within TOLERANCE of each other can only differ by one cell
+    // in a coordinate that lies within TOLERANCE of a cell boundary
+    static constexpr double HASH_CELL_WIDTH = 1024 * static_cast<double>(TOLERANCE);
+
+    // at most this many near-boundary coordinates have both neighbouring cells
+    // probed on lookup (2^MAX_PROBE_COORDS lookups); beyond that a near
+    // duplicate may be missed and stored twice, which is harmless
+    static constexpr size_t MAX_PROBE_COORDS = 6;
+
     std::optional<size_t> insert(const std::vector<float> &vec) override;
     std::optional<size_t> insert(const std::vector<double> &vec) override;
     std::optional<size_t> insert(const double *vec) override;
 
 private:
     // map from hash to indices
-    std::unordered_map<float, std::vector<size_t>> hashmap;
+    std::unordered_map<uint64_t, std::vector<size_t>> hashmap;
+
+    // hash stored for each slot, so an overwritten vector can be removed from the map
+    std::vector<uint64_t> slot_hash;
+
+    // quantize each coordinate to HASH_CELL_WIDTH
+    static int64_t quantize(float value);
 
-    // produce a hash from a vector, using the 1-norm
-    static float hash(const std::vector<float> &vec);
+    // 64-bit hash of one quantized coordinate at position i
+    static uint64_t hash_coordinate(int64_t cell, size_t i);
+
+    // produce a hash from a vector: the sum of the hashes of its quantized coordinates
+    uint64_t hash(const float *vec) const;
+
+    // position of a stored vector within TOLERANCE of vec, if any
+    std::optional<size_t> find(const float *vec) const;
+
+    // insert vec unless a duplicate is stored, exact as in pad_and_store
+    std::optional<size_t> insert_unique(const float *vec, const double *exact);
+
+    // remove the vector stored at pos from the hashmap
+    void remove_from_hashmap(size_t pos);
+
+    // compare two vectors of length n
+    static bool approx_equal(const float *v1, const float *v2, size_t n);
+};
+
+// Multi-writer version of VectorContainer with the same padded layout,
+// ring-buffer overwrite order and sync range semantics.
+//
+// Writers reserve a slot by taking a ticket from an atomic counter, copy the
+// vector into slot (ticket % max_vectors), and then publish it. The published
+// count only moves over consecutive completed tickets (with release semantics),
+// so a reader that loads it (acquire) sees every vector before that number.
+//
+// Each slot also carries a sequence counter (odd while it is being written),
+// which lets readers detect a slot that was overwritten while they read it.
+class ConcurrentVectorContainer
+{
+public:
+    static constexpr size_t GROUP_SIZE = VectorContainer::GROUP_SIZE;
+
+    // Constructor
+    ConcurrentVectorContainer(size_t max_vectors, size_t vector_dim, const StorageOptions &options = StorageOptions());
+
+    // Destructor
+    ~ConcurrentVectorContainer();
+
+    // Disallow Copying and Moving
+    ConcurrentVectorContainer(const ConcurrentVectorContainer &) = delete;
+    ConcurrentVectorContainer &operator=(const ConcurrentVectorContainer &) = delete;
+
+    // Insert operations, safe to call from any number of threads
+    // returns the slot the vector is stored in
+    std::optional<size_t> insert(const std::vector<float> &vec);
+    std::optional<size_t> insert(const std::vector<double> &vec);
+    std::optional<size_t> insert(const double *vec);
+
+    // State visible to readers: the number of vectors published so far.
+    // Every vector inserted before the sequence number is complete in storage.
+    struct Snapshot
+    {
+        uint64_t sequence;
+        // number of valid slots, min(sequence, max_vectors)
+        size_t size;
+    };
+    Snapshot snapshot() const;
+
+    // true if no writer has started overwriting one of the first snapshot.size
+    // slots since the snapshot was taken, so a sweep over them was consistent
+    bool validate(const Snapshot &snap) const;
+
+    // Accessors
+    size_t get_vector_dims() const;
+    size_t get_padding_dims() const;
+    size_t size() const;
+    // copies a published vector, retrying if it is overwritten during the copy
+    std::vector<float> get(size_t index) const;
+    const float *data() const;
+
+    // Sync related functions
+    // these follow VectorContainer, counting published vectors only,
+    // and are meant to be used by a single consumer thread
+    size_t get_current_position() const;
+    size_t get_sync_position() const;
+    bool get_wrap_around_flag() const;
+
+    void reset_sync_range();
+
+private:
+    size_t max_vectors;
+    size_t vector_dim;
+    size_t padded_vector_dim;
+
+    // tickets handed out to writers
+    std::atomic<uint64_t> reserved;
+    // tickets published, always <= reserved
+    std::atomic<uint64_t> published;
+    // published count at the last reset_sync_range
+    std::atomic<uint64_t> sync_sequence;
+
+    // per slot sequence: 2 * (completed writes), odd while a write is in progress
+    std::atomic<uint64_t> *slot_sequence;
+
+    float *data_storage;
+
+    size_t calculate_padded_dim(size_t dim) const;
+    size_t store(const float *src);
+};
 
-    // compare two vectors
-    static bool approx_equal(const std::vector<float> &v1, const std::vector<float> &v2);
-};
\ No newline at end of file
+#endif // VECTOR_CONTAINER_H
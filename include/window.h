@@ -0,0 +1,84 @@
+#ifndef WINDOW_H
+#define WINDOW_H
+
+#include "cut_helper.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Single writer, many reader window of doubles, for handing the latest state
+// of one thread to others without locks.
+//
+// There are two buffers, each with a sequence counter that is odd while the
+// buffer is being written. The writer always fills the buffer that is not the
+// latest, then flips the latest index, so a reader copying the latest buffer
+// only has to retry if the writer publishes twice during the copy.
+class SeqlockWindow
+{
+public:
+    // capacity: the most doubles one publish can hold
+    explicit SeqlockWindow(size_t capacity);
+
+    SeqlockWindow(const SeqlockWindow &) = delete;
+    SeqlockWindow &operator=(const SeqlockWindow &) = delete;
+
+    size_t capacity() const;
+
+    // publish data[0, n), returns the new version (1 for the first publish)
+    // only one thread may publish; throws if n exceeds the capacity
+    uint64_t publish(const double *data, size_t n);
+    uint64_t publish(const std::vector<double> &data);
+
+    // version of the latest publish, 0 if there is none
+    uint64_t version() const;
+
+    // copy the latest published data into out, resized to its length
+    // returns its version, or 0 (and leaves out empty) if there is none
+    uint64_t read(std::vector<double> &out) const;
+
+private:
+    size_t cap;
+
+    struct Buffer
+    {
+        // 2 * (completed writes), odd while a write is in progress
+        std::atomic<uint64_t> sequence{0};
+        // version and length of the data in the buffer
+        uint64_t version = 0;
+        size_t length = 0;
+        std::vector<double> data;
+    };
+    Buffer buffers[2];
+
+    // index of the buffer holding the latest version, and that version
+    std::atomic<unsigned> latest;
+    std::atomic<uint64_t> latest_version;
+};
+
+// What a worker of the independent approximations publishes: its recourse
+// approximation as cuts theta >= alpha - beta x at its own iteration, the
+// number of samples behind it, and the master timestamp of the points its
+// latest cuts were built at. Packed into doubles as
+//     [sample_count, iteration, timestamp, ncuts, (alpha, beta[0, dim)) per cut]
+// which holds the counts exactly below 2^53.
+struct ApproximationSnapshot
+{
+    uint64_t sample_count = 0;
+    uint64_t iteration = 0;
+    uint64_t timestamp = 0;
+    std::vector<Cut> cuts;
+
+    // number of doubles for ncuts cuts of dimension dim
+    static size_t packed_size(size_t ncuts, size_t dim);
+
+    void pack(size_t dim, std::vector<double> &out) const;
+
+    // throws if data is not a packed snapshot of dimension dim
+    static ApproximationSnapshot unpack(const std::vector<double> &data, size_t dim);
+
+    // max(0, max over the cuts at x), the approximation of a nonnegative recourse
+    double value(const std::vector<double> &x) const;
+};
+
+#endif // WINDOW_H
@@ -0,0 +1,54 @@
+#include "aligned_storage.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <omp.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+float *allocate_float_storage(size_t count, size_t block_size, const StorageOptions &options)
+{
+    size_t bytes = count * sizeof(float);
+    if (bytes == 0)
+        bytes = STORAGE_ALIGNMENT;
+
+    // huge pages need the region aligned to the page size
+    bool use_huge_pages = options.huge_pages && bytes >= HUGE_PAGE_SIZE;
+    size_t alignment = use_huge_pages ? HUGE_PAGE_SIZE : STORAGE_ALIGNMENT;
+
+    // aligned_alloc requires the size to be a multiple of the alignment
+    bytes = (bytes + alignment - 1) / alignment * alignment;
+    void *ptr = std::aligned_alloc(alignment, bytes);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+
+#ifdef __linux__
+    // only advice, ignore failures (e.g. THP disabled)
+    if (use_huge_pages)
+        madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+
+    float *storage = static_cast<float *>(ptr);
+    if (!options.numa_first_touch || block_size == 0)
+    {
+        std::memset(storage, 0, bytes);
+        return storage;
+    }
+
+    // first touch: each thread zeroes its static share of the blocks
+    size_t nblocks = count / block_size;
+    #pragma omp parallel for schedule(static)
+    for (size_t b = 0; b < nblocks; ++b)
+        std::memset(storage + b * block_size, 0, block_size * sizeof(float));
+
+    // remainder and the rounding at the end
+    std::memset(storage + nblocks * block_size, 0, bytes - nblocks * block_size * sizeof(float));
+    return storage;
+}
+
+void free_float_storage(float *ptr)
+{
+    std::free(ptr);
+}
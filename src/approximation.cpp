@@ -0,0 +1,109 @@
+#include "approximation.h"
+#include "scheduler.h"
+#include <stdexcept>
+
+namespace
+{
+    // the duals are kept in double too, for the exact argmax recheck and the cuts
+    StorageOptions dual_storage_options()
+    {
+        StorageOptions options;
+        options.double_copy = true;
+        return options;
+    }
+}
+
+SDApproximation::SDApproximation(const std::vector<StageProblem *> &workers_, size_t max_duals,
+                                 VectorContainer::EvictionPolicy policy)
+    : workers(workers_),
+      duals(max_duals, workers_.empty() ? 0 : workers_.front()->get_dual_dimension(), dual_storage_options()),
+      pool(workers_.empty() ? 0 : workers_.front()->nvars_last), iteration(0)
+{
+    if (workers.empty())
+        throw std::runtime_error("SDApproximation::SDApproximation: at least one worker problem is needed.");
+    duals.set_eviction_policy(policy);
+    // the sweeps run on the group's threads only
+    argmax = std::make_unique<ArgmaxEngine>(*workers.front(), duals, static_cast<int>(workers.size()));
+}
+
+void SDApproximation::add_samples(const std::vector<std::vector<double>> &samples,
+                                  const std::vector<const std::vector<double> *> &points)
+{
+    const size_t ntasks = samples.size() * points.size();
+    std::vector<std::vector<double>> task_duals(ntasks);
+
+    // LP times vary a lot between scenarios, so the tasks are handed out dynamically
+    parallel_sweep(static_cast<int>(workers.size()), ntasks, [&](int thread_id, size_t t)
+    {
+        StageProblem &prob1_inst = *workers[thread_id];
+        prob1_inst.update_solver_with_scenario(*points[t % points.size()], samples[t / points.size()]);
+        // solve the problem, require_dual_solution = true
+        task_duals[t] = prob1_inst.solve_problem(true).dual_solution;
+    });
+
+    // insertion is not thread safe; duplicates are dropped by the container
+    for (const auto &pi : task_duals)
+        duals.insert(pi);
+    for (const auto &omega : samples)
+        argmax->add_sample(omega);
+}
+
+Cut SDApproximation::cut_at(const std::vector<double> &x, uint64_t timestamp)
+{
+    return argmax->build_cut(argmax->compute(x, timestamp));
+}
+
+size_t SDApproximation::num_samples() const
+{
+    return argmax->num_samples();
+}
+
+size_t SDApproximation::num_duals() const
+{
+    return duals.size();
+}
+
+void SDApproximation::step(const std::vector<std::vector<double>> &samples, const std::vector<double> &candidate,
+                           const std::vector<double> &incumbent, uint64_t max_inactive)
+{
+    ++iteration;
+    std::vector<const std::vector<double> *> points{&candidate};
+    if (candidate != incumbent)
+        points.push_back(&incumbent);
+
+    add_samples(samples, points);
+    for (const auto *x : points)
+        pool.add(cut_at(*x, iteration), iteration);
+
+    // the cuts attaining the max at the two points stay active
+    for (const auto *x : points)
+    {
+        size_t index;
+        pool.max_value(*x, iteration, index);
+        if (index < pool.size())
+            pool.mark_active(index, iteration);
+    }
+    pool.remove(pool.inactive_cuts(iteration, max_inactive));
+}
+
+size_t SDApproximation::max_cuts(uint64_t max_inactive)
+{
+    return static_cast<size_t>(4 * (max_inactive + 1));
+}
+
+uint64_t SDApproximation::get_iteration() const
+{
+    return iteration;
+}
+
+ApproximationSnapshot SDApproximation::snapshot(uint64_t timestamp) const
+{
+    ApproximationSnapshot snap;
+    snap.sample_count = num_samples();
+    snap.iteration = iteration;
+    snap.timestamp = timestamp;
+    snap.cuts.reserve(pool.size());
+    for (size_t i = 0; i < pool.size(); ++i)
+        snap.cuts.push_back(pool.get_cut(i, iteration));
+    return snap;
+}
@@ -0,0 +1,522 @@
+#include "argmax.h"
+#include "kernels.h"
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // data cache size in bytes, or fallback if it cannot be queried
+    size_t cache_size(int level, size_t fallback)
+    {
+#if defined(__linux__) && defined(_SC_LEVEL1_DCACHE_SIZE)
+        long size = sysconf(level == 1 ? _SC_LEVEL1_DCACHE_SIZE : _SC_LEVEL2_CACHE_SIZE);
+        if (size > 0)
+            return static_cast<size_t>(size);
+#else
+        (void)level;
+#endif
+        return fallback;
+    }
+
+    // half of L1 holds the random parts of a sample block, and half of L2
+    // the random parts of a dual block; the rest is left for everything else
+    ArgmaxEngine::TileSizes default_tile_sizes(size_t padded_nrv)
+    {
+        static const size_t l1 = cache_size(1, 32 * 1024), l2 = cache_size(2, 1024 * 1024);
+        const size_t bytes = std::max<size_t>(padded_nrv, 1) * sizeof(float);
+        ArgmaxEngine::TileSizes tiles;
+        tiles.samples = std::clamp<size_t>(l1 / 2 / bytes, 1, 256);
+        tiles.duals = std::max<size_t>(l2 / 2 / bytes, VectorContainer::GROUP_SIZE);
+        return tiles;
+    }
+}
+
+ArgmaxEngine::ArgmaxEngine(const StageProblem &prob_, VectorContainer &duals_, int nthreads_)
+    : prob(prob_), duals(duals_), nthreads(nthreads_),
+      nx(prob_.nvars_last),
+      nrv(prob_.stage_stoc_pattern.rv_count),
+      padded_nrv((nrv + VectorContainer::GROUP_SIZE - 1) / VectorContainer::GROUP_SIZE * VectorContainer::GROUP_SIZE),
+      alpha_bar(duals_.capacity(), 0.0), beta_bar(duals_.capacity() * nx, 0.0),
+      pi_random(duals_.capacity() * padded_nrv, 0.0f), exact_recheck(duals_.has_double_copy()),
+      pi_random_exact(duals_.capacity() * nrv, 0.0), pi_random_norm1(duals_.capacity(), 0.0),
+      nsamples(0), pruning(true),
+      beta_norm(duals_.capacity(), 0.0), pi_transfer_norm(duals_.capacity(), 0.0),
+      max_transfer_delta(0.0), path_length(0.0), epoch(0)
+{
+    tiles = default_tile_sizes(padded_nrv);
+
+    // float dot product of the sweep: rounding of pi and w to float, the
+    // products, and a chain of padded_nrv / GROUP_SIZE + GROUP_SIZE additions,
+    // with a little slack for the second order terms
+    const double unit_roundoff = std::ldexp(1.0, -24);
+    float_error = 1.01 * unit_roundoff * static_cast<double>(padded_nrv / VectorContainer::GROUP_SIZE + VectorContainer::GROUP_SIZE + 3);
+
+    if (duals.get_vector_dims() != prob.get_dual_dimension())
+        throw std::runtime_error("ArgmaxEngine::ArgmaxEngine: dual dimension does not match the problem.");
+    for (size_t k = 0; k < nrv; ++k)
+        if (prob.stage_stoc_pattern.row_index[k] < 0)
+            throw std::runtime_error("ArgmaxEngine::ArgmaxEngine: randomness in cost is not supported.");
+
+    // everything already stored is new to us
+    for (size_t slot = 0; slot < duals.size(); ++slot)
+        refresh(slot);
+    duals.reset_sync_range();
+}
+
+void ArgmaxEngine::set_tile_sizes(const TileSizes &tiles_)
+{
+    if (tiles_.duals == 0 || tiles_.samples == 0)
+        throw std::runtime_error("ArgmaxEngine::set_tile_sizes: tile sizes must be positive.");
+    tiles = tiles_;
+}
+
+ArgmaxEngine::TileSizes ArgmaxEngine::get_tile_sizes() const
+{
+    return tiles;
+}
+
+void ArgmaxEngine::set_exact_recheck(bool enabled)
+{
+    if (enabled && !duals.has_double_copy())
+        throw std::runtime_error("ArgmaxEngine::set_exact_recheck: the container keeps no double copies.");
+    exact_recheck = enabled;
+    // the memo cutoffs depend on the mode
+    memo.assign(nsamples, Memo());
+}
+
+int ArgmaxEngine::team_size() const
+{
+    return nthreads > 0 ? nthreads : omp_get_max_threads();
+}
+
+void ArgmaxEngine::set_pruning(bool enabled)
+{
+    pruning = enabled;
+    if (!pruning)
+    {
+        memo.assign(nsamples, Memo());
+        refresh_log.clear();
+    }
+}
+
+void ArgmaxEngine::add_sample(const std::vector<double> &omega)
+{
+    if (omega.size() != nrv)
+        throw std::runtime_error("ArgmaxEngine::add_sample: sample size does not match the number of random variables.");
+    double transfer_norm = 0.0;
+    for (size_t k = 0; k < nrv; ++k)
+    {
+        double d = omega[k] - prob.stage_stoc_pattern.reference_values[k];
+        delta.push_back(d);
+        if (prob.stage_stoc_pattern.col_index[k] != -1)
+            transfer_norm += d * d;
+    }
+    max_transfer_delta = std::max(max_transfer_delta, std::sqrt(transfer_norm));
+    memo.emplace_back();
+    ++nsamples;
+}
+
+size_t ArgmaxEngine::num_samples() const
+{
+    return nsamples;
+}
+
+std::vector<double> ArgmaxEngine::dual(size_t slot) const
+{
+    if (duals.has_double_copy())
+        return duals.get_double(slot);
+    std::vector<float> pi_float = duals.get(slot);
+    return std::vector<double>(pi_float.begin(), pi_float.end());
+}
+
+void ArgmaxEngine::refresh(size_t slot)
+{
+    std::vector<double> pi = dual(slot);
+
+    Cut cut = CutHelper::get_static_part(prob, pi);
+    alpha_bar[slot] = cut.alpha;
+    std::copy(cut.beta.begin(), cut.beta.end(), beta_bar.begin() + slot * nx);
+
+    float *gathered = &pi_random[slot * padded_nrv];
+    double *gathered_exact = &pi_random_exact[slot * nrv];
+    double transfer_norm = 0.0, norm1 = 0.0;
+    for (size_t k = 0; k < nrv; ++k)
+    {
+        gathered_exact[k] = pi[prob.stage_stoc_pattern.row_index[k]];
+        gathered[k] = static_cast<float>(gathered_exact[k]);
+        norm1 += std::abs(static_cast<double>(gathered[k]));
+        if (prob.stage_stoc_pattern.col_index[k] != -1)
+            transfer_norm += static_cast<double>(gathered[k]) * gathered[k];
+    }
+    pi_random_norm1[slot] = norm1;
+
+    // norms for the pruning bound: the transfer part of beta_ij sums
+    // pi_ik delta_jk over k, whose norm is at most ||pi_i,T|| ||delta_j,T||
+    beta_norm[slot] = std::sqrt(kernels::dot(cut.beta.data(), cut.beta.data(), cut.beta.size()));
+    pi_transfer_norm[slot] = std::sqrt(transfer_norm);
+}
+
+double ArgmaxEngine::sample_value(double base, size_t i, const float *wj) const
+{
+    // GROUP_SIZE independent partial sums, one per SIMD lane;
+    // padded_nrv is a multiple of GROUP_SIZE
+    constexpr size_t L = VectorContainer::GROUP_SIZE;
+    const float *pi = &pi_random[i * padded_nrv];
+    float lane[L] = {};
+    for (size_t k = 0; k < padded_nrv; k += L)
+        for (size_t l = 0; l < L; ++l)
+            lane[l] += pi[k + l] * wj[k + l];
+
+    float dynamic = 0.0f;
+    for (size_t l = 0; l < L; ++l)
+        dynamic += lane[l];
+    return base + dynamic;
+}
+
+double ArgmaxEngine::exact_value(double base, size_t i, size_t j) const
+{
+    const StageStochasticPattern &pattern = prob.stage_stoc_pattern;
+    const double *pi = &pi_random_exact[i * nrv];
+    const double *d = &delta[j * nrv];
+    double dynamic = 0.0;
+    for (size_t k = 0; k < nrv; ++k)
+        dynamic += pi[k] * (pattern.col_index[k] == -1 ? d[k] : -d[k] * last_x[pattern.col_index[k]]);
+    return base + dynamic;
+}
+
+void ArgmaxEngine::TopCandidates::insert(size_t i, double v)
+{
+    constexpr size_t K = MEMO_CANDIDATES + 1;
+    if (count == K && v <= value[K - 1])
+        return;
+    size_t pos = count < K ? count++ : K - 1;
+    while (pos > 0 && value[pos - 1] < v)
+    {
+        index[pos] = index[pos - 1];
+        value[pos] = value[pos - 1];
+        --pos;
+    }
+    index[pos] = i;
+    value[pos] = v;
+}
+
+void ArgmaxEngine::sweep(const std::vector<double> &base, const std::vector<float> &w, const std::vector<double> &w_max,
+                         size_t ndual, const std::vector<size_t> &samples, Result &result)
+{
+    const size_t sample_block = tiles.samples, dual_block = tiles.duals;
+    const size_t nblocks = (samples.size() + sample_block - 1) / sample_block;
+
+    // largest error bound of a dual on a sample is max_error * w_max[j]
+    double max_error = 0.0;
+    for (size_t i = 0; i < ndual; ++i)
+        max_error = std::max(max_error, float_error * pi_random_norm1[i]);
+
+    size_t exact_evaluations = 0;
+    const int team = team_size();
+    #pragma omp parallel num_threads(team) if (!omp_in_parallel()) reduction(+ : exact_evaluations)
+    {
+        std::vector<TopCandidates> top(sample_block);
+
+        // exact recheck: the best lower bound value - error, and the duals
+        // whose upper bound value + error reached it when they were visited
+        std::vector<double> lower(sample_block);
+        std::vector<std::vector<std::pair<size_t, double>>> near(sample_block);
+
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t b = 0; b < nblocks; ++b)
+        {
+            const size_t first = b * sample_block;
+            const size_t count = std::min(sample_block, samples.size() - first);
+            std::fill(top.begin(), top.begin() + count, TopCandidates());
+            std::fill(lower.begin(), lower.begin() + count, -std::numeric_limits<double>::infinity());
+            for (size_t s = 0; s < count; ++s)
+                near[s].clear();
+
+            // the dual block stays in L2 while every sample of the block passes over it
+            for (size_t i0 = 0; i0 < ndual; i0 += dual_block)
+            {
+                const size_t i1 = std::min(ndual, i0 + dual_block);
+                for (size_t s = 0; s < count; ++s)
+                {
+                    const size_t j = samples[first + s];
+                    const float *wj = &w[j * padded_nrv];
+                    TopCandidates &t = top[s];
+                    if (!exact_recheck)
+                    {
+                        for (size_t i = i0; i < i1; ++i)
+                            t.insert(i, sample_value(base[i], i, wj));
+                        continue;
+                    }
+                    for (size_t i = i0; i < i1; ++i)
+                    {
+                        double v = sample_value(base[i], i, wj);
+                        double error = float_error * pi_random_norm1[i] * w_max[j];
+                        t.insert(i, v);
+                        lower[s] = std::max(lower[s], v - error);
+                        if (v + error >= lower[s])
+                            near[s].emplace_back(i, v + error);
+                    }
+                }
+            }
+
+            for (size_t s = 0; s < count; ++s)
+            {
+                const size_t j = samples[first + s];
+                const TopCandidates &t = top[s];
+                result.winner[j] = t.index[0];
+                result.value[j] = t.value[0];
+
+                // the exact winner is among the duals whose upper bound
+                // reaches the final lower bound
+                if (exact_recheck)
+                {
+                    double best = -std::numeric_limits<double>::infinity();
+                    for (const auto &[i, upper] : near[s])
+                    {
+                        if (upper < lower[s])
+                            continue;
+                        double v = exact_value(base[i], i, j);
+                        ++exact_evaluations;
+                        if (v > best || (v == best && i < result.winner[j]))
+                        {
+                            best = v;
+                            result.winner[j] = i;
+                        }
+                    }
+                    result.value[j] = best;
+                }
+
+                Memo &m = memo[j];
+                m.valid = pruning;
+                m.epoch = epoch;
+                m.path_length = path_length;
+                m.count = std::min(t.count, MEMO_CANDIDATES);
+                std::copy(t.index, t.index + m.count, m.candidates);
+                // the last of the MEMO_CANDIDATES + 1 is the cutoff for the rest;
+                // with exact values it has to cover the float error of the rest
+                m.cutoff = t.count == MEMO_CANDIDATES + 1 ? t.value[MEMO_CANDIDATES]
+                                                          : -std::numeric_limits<double>::infinity();
+                if (exact_recheck)
+                    m.cutoff += max_error * w_max[j];
+            }
+        }
+    }
+    result.exact_evaluations = exact_evaluations;
+}
+
+bool ArgmaxEngine::lookup(const std::vector<double> &base, const float *wj, size_t j, const Memo &m,
+                          double max_slope, size_t ndual, size_t &winner, double &value) const
+{
+    // duals refreshed since the sweep were not ranked; when there are
+    // many of them a full sweep is cheaper
+    auto first_new = std::upper_bound(refresh_log.begin(), refresh_log.end(),
+                                      std::make_pair(m.epoch, std::numeric_limits<size_t>::max()));
+    if (static_cast<size_t>(refresh_log.end() - first_new) > ndual / 2)
+        return false;
+
+    double best = -std::numeric_limits<double>::infinity();
+    size_t best_index = 0;
+    auto consider = [&](size_t i)
+    {
+        double v = exact_recheck ? exact_value(base[i], i, j) : sample_value(base[i], i, wj);
+        if (v > best || (v == best && i < best_index))
+        {
+            best = v;
+            best_index = i;
+        }
+    };
+    for (size_t c = 0; c < m.count; ++c)
+        consider(m.candidates[c]);
+    for (auto it = first_new; it != refresh_log.end(); ++it)
+        consider(it->second);
+
+    // no old dual outside the memo can have grown past this
+    double bound = m.cutoff + max_slope * (path_length - m.path_length);
+    if (best < bound)
+        return false;
+
+    winner = best_index;
+    value = best;
+    return true;
+}
+
+void ArgmaxEngine::sync()
+{
+    // the range [sync position, current position) of the ring,
+    // all of it if the ring went around once
+    std::vector<size_t> slots;
+    size_t start = duals.get_sync_position(), end = duals.get_current_position();
+    if (!duals.get_wrap_around_flag())
+    {
+        for (size_t slot = start; slot < end; ++slot)
+            slots.push_back(slot);
+    }
+    else if (start == end)
+    {
+        for (size_t slot = 0; slot < duals.size(); ++slot)
+            slots.push_back(slot);
+    }
+    else
+    {
+        for (size_t slot = start; slot < duals.size(); ++slot)
+            slots.push_back(slot);
+        for (size_t slot = 0; slot < end; ++slot)
+            slots.push_back(slot);
+    }
+
+    // and the slots overwritten out of order by eviction
+    slots.insert(slots.end(), duals.get_replaced_indices().begin(), duals.get_replaced_indices().end());
+    duals.reset_sync_range();
+
+    if (slots.empty())
+        return;
+    ++epoch;
+    for (size_t slot : slots)
+    {
+        refresh(slot);
+        if (pruning)
+            refresh_log.emplace_back(epoch, slot);
+    }
+}
+
+ArgmaxEngine::Result ArgmaxEngine::compute(const std::vector<double> &x, uint64_t timestamp)
+{
+    if (x.size() != nx)
+        throw std::runtime_error("ArgmaxEngine::compute: x has the wrong dimension.");
+    if (duals.size() == 0)
+        throw std::runtime_error("ArgmaxEngine::compute: no dual vertices.");
+
+    sync();
+    const size_t ndual = duals.size();
+
+    // static part of every dual at x
+    std::vector<double> base(ndual);
+    for (size_t i = 0; i < ndual; ++i)
+        base[i] = kernels::evaluate_cut(alpha_bar[i], &beta_bar[i * nx], x.data(), nx);
+
+    // random part of every sample at x
+    const StageStochasticPattern &pattern = prob.stage_stoc_pattern;
+    std::vector<float> w(nsamples * padded_nrv, 0.0f);
+    std::vector<double> w_max(nsamples, 0.0);
+    for (size_t j = 0; j < nsamples; ++j)
+        for (size_t k = 0; k < nrv; ++k)
+        {
+            double d = delta[j * nrv + k];
+            double wjk = pattern.col_index[k] == -1 ? d : -d * x[pattern.col_index[k]];
+            w[j * padded_nrv + k] = static_cast<float>(wjk);
+            w_max[j] = std::max(w_max[j], std::abs(wjk));
+        }
+
+    // path length of x, bounding how far x moved since any earlier call
+    if (!last_x.empty())
+    {
+        double step = 0.0;
+        for (size_t c = 0; c < nx; ++c)
+            step += (x[c] - last_x[c]) * (x[c] - last_x[c]);
+        path_length += std::sqrt(step);
+    }
+    last_x = x;
+
+    // bound on ||beta_ij|| over all duals and samples
+    double max_slope = 0.0;
+    for (size_t i = 0; i < ndual; ++i)
+        max_slope = std::max(max_slope, beta_norm[i] + pi_transfer_norm[i] * max_transfer_delta);
+
+    Result result;
+    result.winner.assign(nsamples, 0);
+    result.value.assign(nsamples, 0.0);
+
+    // memo lookups first; the samples they cannot certify get a full sweep
+    std::vector<char> certified(nsamples, 0);
+    if (pruning)
+    {
+        const int team = team_size();
+        #pragma omp parallel for num_threads(team) schedule(dynamic, 256) if (!omp_in_parallel())
+        for (size_t j = 0; j < nsamples; ++j)
+            if (memo[j].valid)
+                certified[j] = lookup(base, &w[j * padded_nrv], j, memo[j], max_slope, ndual,
+                                      result.winner[j], result.value[j]);
+    }
+
+    std::vector<size_t> uncertain;
+    for (size_t j = 0; j < nsamples; ++j)
+        if (!certified[j])
+            uncertain.push_back(j);
+    sweep(base, w, w_max, ndual, uncertain, result);
+    result.full_sweeps = uncertain.size();
+
+    // drop the log entries every memo has already ranked
+    if (pruning && nsamples > 0)
+    {
+        uint64_t oldest = epoch;
+        for (const Memo &m : memo)
+            oldest = std::min(oldest, m.epoch);
+        refresh_log.erase(refresh_log.begin(),
+                          std::upper_bound(refresh_log.begin(), refresh_log.end(),
+                                           std::make_pair(oldest, std::numeric_limits<size_t>::max())));
+    }
+
+    // usage statistics for the eviction policy, one update per winning dual
+    std::vector<uint64_t> wins(ndual, 0);
+    for (size_t j = 0; j < nsamples; ++j)
+        ++wins[result.winner[j]];
+    for (size_t i = 0; i < ndual; ++i)
+        if (wins[i] > 0)
+            duals.record_hit(i, timestamp, wins[i]);
+
+    return result;
+}
+
+Cut ArgmaxEngine::get_cut(size_t dual_index, size_t sample) const
+{
+    std::vector<double> pi = dual(dual_index);
+
+    Cut cut = CutHelper::get_static_part(prob, pi);
+    std::vector<double> delta_j(delta.begin() + sample * nrv, delta.begin() + (sample + 1) * nrv);
+    CutHelper::add_dynamic_part(prob, pi, delta_j, cut);
+    return cut;
+}
+
+Cut ArgmaxEngine::build_cut(const Result &result) const
+{
+    if (result.winner.size() != nsamples || nsamples == 0)
+        throw std::runtime_error("ArgmaxEngine::build_cut: result does not match the samples.");
+
+    // the static parts are summed with multiplicity, the random parts per sample
+    const StageStochasticPattern &pattern = prob.stage_stoc_pattern;
+    std::vector<uint64_t> wins(alpha_bar.size(), 0);
+    Cut cut{0.0, std::vector<double>(nx, 0.0)};
+    for (size_t j = 0; j < nsamples; ++j)
+    {
+        size_t i = result.winner[j];
+        ++wins[i];
+        const double *pi = &pi_random_exact[i * nrv];
+        for (size_t k = 0; k < nrv; ++k)
+        {
+            double contribution = pi[k] * delta[j * nrv + k];
+            if (pattern.col_index[k] == -1)
+                cut.alpha += contribution;
+            else
+                cut.beta[pattern.col_index[k]] += contribution;
+        }
+    }
+    for (size_t i = 0; i < wins.size(); ++i)
+        if (wins[i] > 0)
+        {
+            cut.alpha += static_cast<double>(wins[i]) * alpha_bar[i];
+            kernels::accumulate(cut.beta.data(), &beta_bar[i * nx], static_cast<double>(wins[i]), nx);
+        }
+
+    const double scale = 1.0 / static_cast<double>(nsamples);
+    cut.alpha *= scale;
+    for (double &b : cut.beta)
+        b *= scale;
+    return cut;
+}
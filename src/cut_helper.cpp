@@ -1,8 +1,9 @@
 #include "cut_helper.h"
+#include "kernels.h"
+#include <algorithm>
 
-Cut CutHelper::get_static_part(const StageProblem &prob, const std::vector<double> &pi)
+double CutHelper::static_alpha(const StageProblem &prob, const std::vector<double> &pi)
 {
-    // intercept
     double alpha = 0.0;
     for (size_t i = 0; i < prob.nrows; ++i)
         alpha += prob.rhs_bar[i] * pi[i];
@@ -14,16 +15,44 @@ Cut CutHelper::get_static_part(const StageProblem &prob, const std::vector<doubl
     {
         // fix bound means lb = ub so we only need to add one of them
         for (size_t i = 0; i < prob.non_trivial_fx_index.size(); ++i)
-            alpha += prob.ub[i] * pi[pos++];
+            alpha += prob.ub[prob.non_trivial_fx_index[i]] * pi[pos++];
         for (size_t i = 0; i < prob.non_trivial_lb_index.size(); ++i)
-            alpha += prob.lb[i] * pi[pos++];
+            alpha += prob.lb[prob.non_trivial_lb_index[i]] * pi[pos++];
         for (size_t i = 0; i < prob.non_trivial_ub_index.size(); ++i)
-            alpha += prob.ub[i] * pi[pos++];   
+            alpha += prob.ub[prob.non_trivial_ub_index[i]] * pi[pos++];
     }
+    return alpha;
+}
+
+double CutHelper::static_alpha(const StageProblem &prob, const SparseVector<double> &pi)
+{
+    // pi is ordered as [pi, pi_fx, pi_lb, pi_ub]
+    const size_t nfx = prob.non_trivial_fx_index.size(), nlb = prob.non_trivial_lb_index.size();
+    double alpha = 0.0;
+    for (size_t k = 0; k < pi.nnz(); ++k)
+    {
+        size_t i = static_cast<size_t>(pi.index[k]);
+        double bound;
+        if (i < prob.nrows)
+            bound = prob.rhs_bar[i];
+        else if (i < prob.nrows + nfx)
+            bound = prob.ub[prob.non_trivial_fx_index[i - prob.nrows]];
+        else if (i < prob.nrows + nfx + nlb)
+            bound = prob.lb[prob.non_trivial_lb_index[i - prob.nrows - nfx]];
+        else
+            bound = prob.ub[prob.non_trivial_ub_index[i - prob.nrows - nfx - nlb]];
+        alpha += bound * pi.value[k];
+    }
+    return alpha;
+}
+
+Cut CutHelper::get_static_part(const StageProblem &prob, const std::vector<double> &pi)
+{
+    double alpha = static_alpha(prob, pi);
 
     // beta part
     std::vector<double> beta(prob.nvars_last, 0.0);
-    prob.transfer_block.multiply_transpose_with_vector(pi, beta);
+    prob.transfer_block_csr->multiply_transpose_with_vector(pi, beta);
 
     if (beta.size() == 0)
     {
@@ -61,3 +90,71 @@ void CutHelper::add_dynamic_part(const StageProblem &prob, const std::vector<dou
         }
     }
 }
+
+Cut CutHelper::get_static_part(const StageProblem &prob, const SparseVector<double> &pi)
+{
+    double alpha = static_alpha(prob, pi);
+
+    // beta part, only the rows with non-zero duals
+    std::vector<double> beta;
+    prob.transfer_block_csr->multiply_transpose_with_vector(pi, beta);
+
+    return {alpha, beta};
+}
+
+void CutHelper::add_dynamic_part(const StageProblem &prob, const SparseVector<double> &pi, const std::vector<double> &scenario, Cut &cut)
+{
+    const StageStochasticPattern &pattern = prob.stage_stoc_pattern;
+
+    if (pattern.rv_count != scenario.size())
+        throw std::runtime_error("CutHelper::add_dynamic_part: scenario size does not match the number of random variables.");
+
+    for (size_t i = 0; i < pattern.rv_count; ++i)
+    {
+        // look up pi at the row of the random element, skip if it is zero
+        auto it = std::lower_bound(pi.index.begin(), pi.index.end(), pattern.row_index[i]);
+        if (it == pi.index.end() || *it != pattern.row_index[i])
+            continue;
+        double pi_row = pi.value[it - pi.index.begin()];
+
+        if (pattern.col_index[i] == -1)
+            cut.alpha += scenario[i] * pi_row;
+        else
+            cut.beta[pattern.col_index[i]] += scenario[i] * pi_row;
+    }
+}
+
+Cut CutHelper::get_static_part(const StageProblem &prob, const StageProblem::Solution &sol)
+{
+    if (sol.dual_is_sparse)
+        return get_static_part(prob, sol.sparse_dual_solution);
+    return get_static_part(prob, sol.dual_solution);
+}
+
+void CutHelper::add_dynamic_part(const StageProblem &prob, const StageProblem::Solution &sol, const std::vector<double> &scenario, Cut &cut)
+{
+    if (sol.dual_is_sparse)
+        add_dynamic_part(prob, sol.sparse_dual_solution, scenario, cut);
+    else
+        add_dynamic_part(prob, sol.dual_solution, scenario, cut);
+}
+
+void CutHelper::add_cut(const StageProblem &prob, const StageProblem::Solution &sol, const std::vector<double> &scenario, Cut &sum)
+{
+    if (sol.dual_is_sparse)
+    {
+        sum.alpha += static_alpha(prob, sol.sparse_dual_solution);
+        prob.transfer_block_csr->add_multiply_transpose_with_vector(sol.sparse_dual_solution, sum.beta);
+    }
+    else
+    {
+        sum.alpha += static_alpha(prob, sol.dual_solution);
+        prob.transfer_block_csr->add_multiply_transpose_with_vector(sol.dual_solution, sum.beta);
+    }
+    add_dynamic_part(prob, sol, scenario, sum);
+}
+
+double CutHelper::evaluate(const Cut &cut, const std::vector<double> &x)
+{
+    return kernels::evaluate_cut(cut.alpha, cut.beta.data(), x.data(), cut.beta.size());
+}
@@ -0,0 +1,234 @@
+#include "cut_pool.h"
+#include "kernels.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+CutPool::CutPool(size_t dim_)
+    : dim(dim_), stride((dim_ + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE) {}
+
+size_t CutPool::add(const Cut &cut, uint64_t iteration, size_t epigraph)
+{
+    if (cut.beta.size() != dim)
+        throw std::runtime_error("CutPool::add: cut dimension does not match the pool.");
+    if (iteration == 0)
+        throw std::runtime_error("CutPool::add: creation iteration must be positive.");
+
+    const double t = static_cast<double>(iteration);
+    scaled_alpha.push_back(t * cut.alpha);
+    iterations.push_back(iteration);
+    epigraphs.push_back(epigraph);
+    last_active.push_back(iteration);
+
+    size_t offset = scaled_beta.size();
+    scaled_beta.resize(offset + stride, 0.0);
+    for (size_t c = 0; c < dim; ++c)
+        scaled_beta[offset + c] = t * cut.beta[c];
+
+    scaled_alpha_float.push_back(static_cast<float>(scaled_alpha.back()));
+    scaled_beta_float.insert(scaled_beta_float.end(), scaled_beta.begin() + offset, scaled_beta.end());
+
+    return scaled_alpha.size() - 1;
+}
+
+void CutPool::remove(const std::vector<size_t> &indices)
+{
+    if (indices.empty())
+        return;
+    for (size_t n = 0; n < indices.size(); ++n)
+        if (indices[n] >= size() || (n > 0 && indices[n] <= indices[n - 1]))
+            throw std::runtime_error("CutPool::remove: indices must be increasing and in range.");
+
+    // compact in place, skipping the removed cuts
+    size_t next = 0, write = 0;
+    for (size_t read = 0; read < size(); ++read)
+    {
+        if (next < indices.size() && indices[next] == read)
+        {
+            ++next;
+            continue;
+        }
+        if (write != read)
+        {
+            scaled_alpha[write] = scaled_alpha[read];
+            scaled_alpha_float[write] = scaled_alpha_float[read];
+            iterations[write] = iterations[read];
+            epigraphs[write] = epigraphs[read];
+            last_active[write] = last_active[read];
+            std::copy_n(&scaled_beta[read * stride], stride, &scaled_beta[write * stride]);
+            std::copy_n(&scaled_beta_float[read * stride], stride, &scaled_beta_float[write * stride]);
+        }
+        ++write;
+    }
+
+    scaled_alpha.resize(write);
+    scaled_alpha_float.resize(write);
+    iterations.resize(write);
+    epigraphs.resize(write);
+    last_active.resize(write);
+    scaled_beta.resize(write * stride);
+    scaled_beta_float.resize(write * stride);
+}
+
+size_t CutPool::size() const
+{
+    return scaled_alpha.size();
+}
+
+size_t CutPool::get_dim() const
+{
+    return dim;
+}
+
+size_t CutPool::get_stride() const
+{
+    return stride;
+}
+
+uint64_t CutPool::get_iteration(size_t i) const
+{
+    return iterations[i];
+}
+
+size_t CutPool::get_epigraph(size_t i) const
+{
+    return epigraphs[i];
+}
+
+void CutPool::mark_active(size_t i, uint64_t k)
+{
+    last_active[i] = std::max(last_active[i], k);
+}
+
+uint64_t CutPool::get_last_active(size_t i) const
+{
+    return last_active[i];
+}
+
+std::vector<size_t> CutPool::inactive_cuts(uint64_t k, uint64_t max_inactive) const
+{
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < size(); ++i)
+        if (k > last_active[i] && k - last_active[i] > max_inactive)
+            indices.push_back(i);
+    return indices;
+}
+
+double CutPool::get_scaled_alpha(size_t i) const
+{
+    return scaled_alpha[i];
+}
+
+const double *CutPool::get_scaled_beta(size_t i) const
+{
+    return &scaled_beta[i * stride];
+}
+
+Cut CutPool::get_scaled_cut(size_t i) const
+{
+    const double *beta = get_scaled_beta(i);
+    return {scaled_alpha[i], std::vector<double>(beta, beta + dim)};
+}
+
+Cut CutPool::get_cut(size_t i, uint64_t k) const
+{
+    Cut cut = get_scaled_cut(i);
+    const double scale = epigraph_coefficient(k);
+    cut.alpha *= scale;
+    for (double &b : cut.beta)
+        b *= scale;
+    return cut;
+}
+
+double CutPool::epigraph_coefficient(uint64_t k)
+{
+    if (k == 0)
+        throw std::runtime_error("CutPool::epigraph_coefficient: iteration must be positive.");
+    return 1.0 / static_cast<double>(k);
+}
+
+void CutPool::evaluate(const std::vector<double> &x, uint64_t k, std::vector<double> &values) const
+{
+    if (x.size() != dim)
+        throw std::runtime_error("CutPool::evaluate: x has the wrong dimension.");
+
+    const double scale = epigraph_coefficient(k);
+    values.resize(size());
+    for (size_t i = 0; i < size(); ++i)
+        values[i] = scale * kernels::evaluate_cut(scaled_alpha[i], &scaled_beta[i * stride], x.data(), dim);
+}
+
+void CutPool::max_values(const std::vector<double> &points, uint64_t k, std::vector<double> &values,
+                         std::vector<size_t> &indices, Precision precision) const
+{
+    if (dim == 0 || points.size() % dim != 0)
+        throw std::runtime_error("CutPool::max_values: points do not match the pool dimension.");
+
+    const size_t npoints = points.size() / dim;
+    const double scale = epigraph_coefficient(k);
+    values.assign(npoints, -std::numeric_limits<double>::infinity());
+    indices.assign(npoints, size());
+    if (size() == 0)
+        return;
+
+    // points in the padded layout of the slopes
+    if (precision == Precision::DOUBLE && (dim < BATCH_MIN_DIM || npoints < kernels::BATCH_POINTS))
+    {
+        for (size_t p = 0; p < npoints; ++p)
+            values[p] = max_scaled_value(&points[p * dim], indices[p]);
+    }
+    else if (precision == Precision::DOUBLE)
+    {
+        std::vector<double> padded(npoints * stride, 0.0);
+        for (size_t p = 0; p < npoints; ++p)
+            std::copy_n(&points[p * dim], dim, &padded[p * stride]);
+        kernels::max_cuts(scaled_alpha.data(), scaled_beta.data(), size(), stride,
+                          padded.data(), npoints, values.data(), indices.data());
+    }
+    else
+    {
+        std::vector<float> padded(npoints * stride, 0.0f);
+        for (size_t p = 0; p < npoints; ++p)
+            std::copy_n(&points[p * dim], dim, &padded[p * stride]);
+        kernels::max_cuts(scaled_alpha_float.data(), scaled_beta_float.data(), size(), stride,
+                          padded.data(), npoints, values.data(), indices.data());
+    }
+
+    // the positive scale does not change the argmax
+    for (double &v : values)
+        v *= scale;
+}
+
+double CutPool::max_value(const std::vector<double> &x, uint64_t k, size_t &index) const
+{
+    if (x.size() != dim)
+        throw std::runtime_error("CutPool::max_value: x has the wrong dimension.");
+    return epigraph_coefficient(k) * max_scaled_value(x.data(), index);
+}
+
+double CutPool::max_scaled_value(const double *x, size_t &index) const
+{
+    double best = -std::numeric_limits<double>::infinity();
+    index = size();
+    for (size_t i = 0; i < size(); ++i)
+    {
+        double value = kernels::evaluate_cut(scaled_alpha[i], &scaled_beta[i * stride], x, dim);
+        if (value > best)
+        {
+            best = value;
+            index = i;
+        }
+    }
+    return best;
+}
+
+void CutPool::clear()
+{
+    scaled_alpha.clear();
+    scaled_beta.clear();
+    scaled_alpha_float.clear();
+    scaled_beta_float.clear();
+    iterations.clear();
+    epigraphs.clear();
+    last_active.clear();
+}
@@ -0,0 +1,231 @@
+#include "kernels.h"
+#include <array>
+#include <algorithm>
+#include <limits>
+#include <omp.h>
+#include <utility>
+
+namespace
+{
+    // Fixed dimension kernels
+    // the index sequence expands every loop at compile time,
+    // and the left folds keep the summation order of the generic loops
+    template <size_t... Is>
+    double fixed_dot(const double *a, const double *b, std::index_sequence<Is...>)
+    {
+        return (0.0 + ... + (a[Is] * b[Is]));
+    }
+
+    template <size_t N>
+    double dot_n(const double *a, const double *b)
+    {
+        return fixed_dot(a, b, std::make_index_sequence<N>());
+    }
+
+    template <size_t N>
+    void dot_and_norm_n(const double *g, const double *d, double &gd, double &gg)
+    {
+        gd = fixed_dot(g, d, std::make_index_sequence<N>());
+        gg = fixed_dot(g, g, std::make_index_sequence<N>());
+    }
+
+    template <size_t N>
+    double evaluate_cut_n(double alpha, const double *beta, const double *x)
+    {
+        return alpha - fixed_dot(beta, x, std::make_index_sequence<N>());
+    }
+
+    template <size_t... Is>
+    double fixed_update_direction(double *d, const double *g, double lambda, std::index_sequence<Is...>)
+    {
+        ((d[Is] = lambda * d[Is] + (1.0 - lambda) * g[Is]), ...);
+        return fixed_dot(d, d, std::index_sequence<Is...>());
+    }
+
+    template <size_t N>
+    double update_direction_n(double *d, const double *g, double lambda)
+    {
+        return fixed_update_direction(d, g, lambda, std::make_index_sequence<N>());
+    }
+
+    template <size_t... Is>
+    void fixed_accumulate(double *acc, const double *beta, double scale, std::index_sequence<Is...>)
+    {
+        ((acc[Is] += scale * beta[Is]), ...);
+    }
+
+    template <size_t N>
+    void accumulate_n(double *acc, const double *beta, double scale)
+    {
+        fixed_accumulate(acc, beta, scale, std::make_index_sequence<N>());
+    }
+
+    // Dispatch tables, entry n - 1 holds the kernel for dimension n
+    using DotFn = double (*)(const double *, const double *);
+    using DotAndNormFn = void (*)(const double *, const double *, double &, double &);
+    using EvaluateCutFn = double (*)(double, const double *, const double *);
+    using UpdateDirectionFn = double (*)(double *, const double *, double);
+    using AccumulateFn = void (*)(double *, const double *, double);
+
+    template <size_t... Is>
+    constexpr std::array<DotFn, sizeof...(Is)> make_dot_table(std::index_sequence<Is...>)
+    {
+        return {&dot_n<Is + 1>...};
+    }
+
+    template <size_t... Is>
+    constexpr std::array<DotAndNormFn, sizeof...(Is)> make_dot_and_norm_table(std::index_sequence<Is...>)
+    {
+        return {&dot_and_norm_n<Is + 1>...};
+    }
+
+    template <size_t... Is>
+    constexpr std::array<EvaluateCutFn, sizeof...(Is)> make_evaluate_cut_table(std::index_sequence<Is...>)
+    {
+        return {&evaluate_cut_n<Is + 1>...};
+    }
+
+    template <size_t... Is>
+    constexpr std::array<UpdateDirectionFn, sizeof...(Is)> make_update_direction_table(std::index_sequence<Is...>)
+    {
+        return {&update_direction_n<Is + 1>...};
+    }
+
+    template <size_t... Is>
+    constexpr std::array<AccumulateFn, sizeof...(Is)> make_accumulate_table(std::index_sequence<Is...>)
+    {
+        return {&accumulate_n<Is + 1>...};
+    }
+
+    constexpr auto dot_table = make_dot_table(std::make_index_sequence<kernels::MAX_FIXED_DIM>());
+    constexpr auto dot_and_norm_table = make_dot_and_norm_table(std::make_index_sequence<kernels::MAX_FIXED_DIM>());
+    constexpr auto evaluate_cut_table = make_evaluate_cut_table(std::make_index_sequence<kernels::MAX_FIXED_DIM>());
+    constexpr auto update_direction_table = make_update_direction_table(std::make_index_sequence<kernels::MAX_FIXED_DIM>());
+    constexpr auto accumulate_table = make_accumulate_table(std::make_index_sequence<kernels::MAX_FIXED_DIM>());
+
+    inline bool has_fixed_kernel(size_t n)
+    {
+        return n >= 1 && n <= kernels::MAX_FIXED_DIM;
+    }
+}
+
+double kernels::dot(const double *a, const double *b, size_t n)
+{
+    if (has_fixed_kernel(n))
+        return dot_table[n - 1](a, b);
+
+    double sum = 0.0;
+    for (size_t i = 0; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+void kernels::dot_and_norm(const double *g, const double *d, size_t n, double &gd, double &gg)
+{
+    if (has_fixed_kernel(n))
+    {
+        dot_and_norm_table[n - 1](g, d, gd, gg);
+        return;
+    }
+
+    gd = 0.0;
+    gg = 0.0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        gd += g[i] * d[i];
+        gg += g[i] * g[i];
+    }
+}
+
+double kernels::evaluate_cut(double alpha, const double *beta, const double *x, size_t n)
+{
+    if (has_fixed_kernel(n))
+        return evaluate_cut_table[n - 1](alpha, beta, x);
+
+    return alpha - dot(beta, x, n);
+}
+
+double kernels::update_direction(double *d, const double *g, double lambda, size_t n)
+{
+    if (has_fixed_kernel(n))
+        return update_direction_table[n - 1](d, g, lambda);
+
+    for (size_t i = 0; i < n; ++i)
+        d[i] = lambda * d[i] + (1.0 - lambda) * g[i];
+    return dot(d, d, n);
+}
+
+void kernels::accumulate(double *acc, const double *beta, double scale, size_t n)
+{
+    if (has_fixed_kernel(n))
+    {
+        accumulate_table[n - 1](acc, beta, scale);
+        return;
+    }
+
+    for (size_t i = 0; i < n; ++i)
+        acc[i] += scale * beta[i];
+}
+
+template <typename T>
+void kernels::max_cuts(const T *alpha, const T *beta, size_t ncuts, size_t stride,
+                       const T *points, size_t npoints, double *value, size_t *index)
+{
+    // 32 bytes of partial sums per point: 8 floats or 4 doubles, so the
+    // P x L accumulators fit in the vector registers for either type
+    constexpr size_t L = BATCH_LANES * sizeof(float) / sizeof(T), P = BATCH_POINTS;
+    const size_t nblocks = (npoints + P - 1) / P;
+
+    // only worth splitting when there is enough work for every thread
+    const bool parallel = nblocks > 1 && ncuts * npoints * stride >= (size_t(1) << 18) && !omp_in_parallel();
+
+    #pragma omp parallel for schedule(static) if (parallel)
+    for (size_t block = 0; block < nblocks; ++block)
+    {
+        const size_t first = block * P;
+        const size_t count = std::min(P, npoints - first);
+
+        // a short last block repeats its last point, whose results are dropped
+        const T *x[P];
+        for (size_t p = 0; p < P; ++p)
+            x[p] = points + (first + std::min(p, count - 1)) * stride;
+
+        double best[P];
+        size_t best_index[P] = {};
+        std::fill(best, best + P, -std::numeric_limits<double>::infinity());
+
+        for (size_t i = 0; i < ncuts; ++i)
+        {
+            const T *b = beta + i * stride;
+
+            // P x L independent partial sums keep the loop free of reductions
+            T acc[P][L] = {};
+            for (size_t c = 0; c < stride; c += L)
+                for (size_t p = 0; p < P; ++p)
+                    for (size_t l = 0; l < L; ++l)
+                        acc[p][l] += b[c + l] * x[p][c + l];
+
+            for (size_t p = 0; p < P; ++p)
+            {
+                T sum = T(0);
+                for (size_t l = 0; l < L; ++l)
+                    sum += acc[p][l];
+                double v = static_cast<double>(alpha[i]) - static_cast<double>(sum);
+                if (v > best[p])
+                {
+                    best[p] = v;
+                    best_index[p] = i;
+                }
+            }
+        }
+
+        for (size_t p = 0; p < count; ++p)
+        {
+            value[first + p] = best[p];
+            index[first + p] = best_index[p];
+        }
+    }
+}
+
+template void kernels::max_cuts<float>(const float *, const float *, size_t, size_t, const float *, size_t, double *, size_t *);
+template void kernels::max_cuts<double>(const double *, const double *, size_t, size_t, const double *, size_t, double *, size_t *);
@@ -1,16 +1,161 @@
 #include <iostream>
 #include <omp.h>
+#include <cstdint>
+#include <string>
 
-// #include "two_stage.h"
+#include "two_stage.h"
+#include "mpi_sd.h"
+#include "utils.h"
 
-int main() {
+#ifdef USE_MPI
+// usage: mpirun -np N twosd_mpi <base_path> <prob_name> [nworkers] [max_iterations]
+// rank 0 is the master, the other N - 1 ranks build one approximation each on nworkers threads
+// e.g. mpirun -np 4 twosd_mpi tests ssn 2
+int main(int argc, char *argv[]) {
 
-    // int nworkers = omp_get_max_threads();
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
-    // TwoStageSCS sp("tests", "ssn", nworkers);
+    if (argc < 3)
+    {
+        if (rank == 0)
+            std::cerr << "usage: mpirun -np N " << argv[0] << " <base_path> <prob_name> [nworkers] [max_iterations]\n";
+        MPI_Finalize();
+        return 1;
+    }
 
-    // // TwoStageSCS sp("tests", "lands", nworkers);
-    // sp.solve();
-    // return 0;
+    try
+    {
+        TwoStageMPISD::Options options;
+        options.verbose = true;
+        int nworkers = argc > 3 ? std::stoi(argv[3]) : omp_get_max_threads();
+        if (argc > 4)
+            options.max_iterations = std::stoull(argv[4]);
+
+        // the engine frees its window before MPI_Finalize
+        TwoStageMPISD sp(argv[1], argv[2], nworkers, options);
+        double start = MPI_Wtime();
+        sp.solve();
+        double wall = MPI_Wtime() - start;
+
+        if (sp.is_master())
+        {
+            const auto &stats = sp.get_worker_stats();
+            std::cout << "Iterations: " << sp.get_iterations() << '\n';
+            std::cout << "Estimated objective: " << sp.get_incumbent_estimate() << '\n';
+            std::cout << "Solution: " << vec_to_string(sp.get_incumbent()) << '\n';
+            std::cout << "Wall time (s): " << wall << '\n';
+            double busy = 0.0, total = 0.0;
+            for (size_t w = 1; w < stats.size(); ++w)
+            {
+                std::cout << "Worker " << w << ": steps " << stats[w].steps
+                          << ", samples " << stats[w].samples
+                          << ", busy " << stats[w].busy
+                          << ", wait " << stats[w].wait
+                          << ", efficiency " << stats[w].efficiency() << '\n';
+                busy += stats[w].busy;
+                total += stats[w].busy + stats[w].wait;
+            }
+            std::cout << "Worker efficiency: " << (total > 0.0 ? busy / total : 0.0) << '\n';
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "rank " << rank << ": " << e.what() << '\n';
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Finalize();
+    return 0;
 }
+#else
+
+// usage: twosd <base_path> <prob_name> [nworkers] [max_iterations] [napprox | lshaped]
+// with napprox > 1 the workers build that many independent approximations,
+// with lshaped the multi-cut L-shaped baseline runs instead of SD
+// e.g. twosd tests lands 4, twosd tests lands 4 1000 2 or twosd tests lands 4 1000 lshaped
+int main(int argc, char *argv[]) {
+
+    if (argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " <base_path> <prob_name> [nworkers] [max_iterations] [napprox | lshaped]\n";
+        return 1;
+    }
+
+    try
+    {
+        int nworkers = argc > 3 ? std::stoi(argv[3]) : omp_get_max_threads();
+        uint64_t max_iterations = argc > 4 ? std::stoull(argv[4]) : SDOptions().max_iterations;
+        bool lshaped = argc > 5 && std::string(argv[5]) == "lshaped";
+        size_t napprox = argc > 5 && !lshaped ? std::stoul(argv[5]) : 1;
+
+        if (lshaped)
+        {
+            TwoStageLShaped::Options options;
+            options.verbose = true;
+            options.max_iterations = max_iterations;
 
+            TwoStageLShaped sp(argv[1], argv[2], nworkers, options);
+            sp.solve();
+
+            const auto &timing = sp.get_timing();
+            std::cout << "Iterations: " << sp.get_iterations() << ", scenarios: " << sp.get_num_scenarios()
+                      << (sp.is_exact() ? "" : " (sampled)") << '\n';
+            std::cout << "Objective: " << sp.get_objective() << ", lower bound: " << sp.get_lower_bound() << '\n';
+            std::cout << "Solution: " << vec_to_string(sp.get_solution()) << '\n';
+            std::cout << "Time (s): total " << timing.total
+                      << ", subproblems " << timing.subproblems
+                      << ", cuts " << timing.cuts
+                      << ", master " << timing.master << '\n';
+        }
+        else if (napprox <= 1)
+        {
+            TwoStageSD::Options options;
+            options.verbose = true;
+            options.max_iterations = max_iterations;
+
+            TwoStageSD sp(argv[1], argv[2], nworkers, options);
+            sp.solve();
+
+            const auto &timing = sp.get_timing();
+            std::cout << "Iterations: " << sp.get_iterations() << ", samples: " << sp.get_num_samples() << '\n';
+            std::cout << "Estimated objective: " << sp.get_incumbent_estimate() << '\n';
+            std::cout << "Solution: " << vec_to_string(sp.get_incumbent()) << '\n';
+            std::cout << "Time (s): total " << timing.total
+                      << ", sampling " << timing.sampling
+                      << ", subproblems " << timing.subproblems
+                      << ", argmax " << timing.argmax
+                      << ", incumbent " << timing.incumbent
+                      << ", master " << timing.master << '\n';
+        }
+        else
+        {
+            // README Design One on threads
+            TwoStageIndependentSD::Options options;
+            options.verbose = true;
+            options.max_iterations = max_iterations;
+            options.napprox = napprox;
+
+            TwoStageIndependentSD sp(argv[1], argv[2], nworkers, options);
+            sp.solve();
+
+            const auto &timing = sp.get_timing();
+            std::cout << "Iterations: " << sp.get_iterations() << ", samples: " << vec_to_string(sp.get_sample_counts()) << '\n';
+            std::cout << "Estimated objective: " << sp.get_incumbent_estimate() << '\n';
+            std::cout << "Solution: " << vec_to_string(sp.get_incumbent()) << '\n';
+            std::cout << "Master time (s): total " << timing.total
+                      << ", read " << timing.read
+                      << ", incumbent " << timing.incumbent
+                      << ", master " << timing.master
+                      << ", wait " << timing.wait << '\n';
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+#endif // USE_MPI
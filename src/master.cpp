@@ -0,0 +1,319 @@
+#include "master.h"
+#include "kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+StageMasterProblem::StageMasterProblem(const smps::SMPSCore &cor, const smps::SMPSTime &tim,
+                                       const smps::SMPSStoch &sto, size_t n_epigraph_,
+                                       double epigraph_lower_bound_)
+    : StageProblem(cor, tim, sto, 0), n_epigraph(n_epigraph_),
+      epigraph_lower_bound(epigraph_lower_bound_), epigraph_weights(n_epigraph_, 1.0),
+      iteration(1), activity_iteration(1), trust_radius(std::numeric_limits<double>::infinity()),
+      trust_region_in_model(false), pool(nvars_current), cuts_in_model(0)
+{
+    if (n_epigraph == 0)
+        throw std::runtime_error("StageMasterProblem::StageMasterProblem: at least one epigraph variable is needed.");
+    if (!(epigraph_lower_bound < std::numeric_limits<double>::infinity()))
+        throw std::runtime_error("StageMasterProblem::StageMasterProblem: the epigraph lower bound must be below infinity.");
+}
+
+void StageMasterProblem::attach_solver()
+{
+    StageProblem::attach_solver();
+
+    // epigraph variables after the first stage variables
+    // eta = k (theta - L) >= 0, free without a bound
+    const double eta_bound = std::isinf(epigraph_lower_bound) ? -GRB_INFINITY : 0.0;
+    std::vector<double> obj(n_epigraph), lower(n_epigraph, eta_bound), upper(n_epigraph, GRB_INFINITY);
+    for (size_t g = 0; g < n_epigraph; ++g)
+        obj[g] = epigraph_weights[g] * CutPool::epigraph_coefficient(iteration);
+    int error = GRBaddvars(model, static_cast<int>(n_epigraph), 0, nullptr, nullptr, nullptr,
+                           obj.data(), lower.data(), upper.data(), nullptr, nullptr);
+    if (error)
+    {
+        throw std::runtime_error("StageMasterProblem::attach_solver: Gurobi error code " + std::to_string(error) + " when adding epigraph variables.");
+    }
+
+    // every cut of the pool is pending in the new model
+    cuts_in_model = 0;
+    cut_shift.clear();
+    update_solver_cuts();
+}
+
+size_t StageMasterProblem::get_num_epigraph() const
+{
+    return n_epigraph;
+}
+
+double StageMasterProblem::get_epigraph_lower_bound() const
+{
+    return epigraph_lower_bound;
+}
+
+const CutPool &StageMasterProblem::get_cut_pool() const
+{
+    return pool;
+}
+
+size_t StageMasterProblem::add_cut(const Cut &cut, uint64_t iteration_, size_t epigraph)
+{
+    if (epigraph >= n_epigraph)
+        throw std::runtime_error("StageMasterProblem::add_cut: epigraph index out of range.");
+    // a cut of theta is stored as a cut of theta - L
+    Cut shifted{cut.alpha - epigraph_shift(), cut.beta};
+    size_t index = pool.add(shifted, iteration_, epigraph);
+    pool.mark_active(index, activity_iteration);
+    return index;
+}
+
+void StageMasterProblem::set_iteration(uint64_t k)
+{
+    // validates k
+    CutPool::epigraph_coefficient(k);
+    if (k > 1 && std::isinf(epigraph_lower_bound))
+        throw std::runtime_error("StageMasterProblem::set_iteration: cut aging needs a finite epigraph lower bound.");
+    iteration = k;
+    activity_iteration = k;
+    if (is_solver_attached())
+        update_solver_epigraph_objective();
+}
+
+void StageMasterProblem::set_activity_iteration(uint64_t k)
+{
+    activity_iteration = k;
+}
+
+void StageMasterProblem::set_trust_region(double radius)
+{
+    if (!(radius > 0.0))
+        throw std::runtime_error("StageMasterProblem::set_trust_region: the radius must be positive.");
+    if (radius != std::numeric_limits<double>::infinity() && get_x_base() == nullptr)
+        throw std::runtime_error("StageMasterProblem::set_trust_region: x_base is not set.");
+    trust_radius = radius;
+}
+
+void StageMasterProblem::update_solver_trust_region()
+{
+    const std::vector<double> *base = get_x_base();
+    std::vector<double> lower(nvars_current), upper(nvars_current);
+    for (size_t j = 0; j < nvars_current; ++j)
+    {
+        double shift = base != nullptr ? (*base)[j] : 0.0;
+        lower[j] = std::max(std::max(lb[j] - shift, -trust_radius), -GRB_INFINITY);
+        upper[j] = std::min(std::min(ub[j] - shift, trust_radius), GRB_INFINITY);
+    }
+    int error = GRBsetdblattrarray(model, GRB_DBL_ATTR_LB, 0, static_cast<int>(nvars_current), lower.data());
+    if (!error)
+        error = GRBsetdblattrarray(model, GRB_DBL_ATTR_UB, 0, static_cast<int>(nvars_current), upper.data());
+    if (!error)
+        error = GRBupdatemodel(model);
+    if (error)
+    {
+        throw std::runtime_error("StageMasterProblem::update_solver_trust_region: Gurobi error code " + std::to_string(error) + " when setting the bounds.");
+    }
+}
+
+uint64_t StageMasterProblem::get_iteration() const
+{
+    return iteration;
+}
+
+void StageMasterProblem::set_epigraph_weights(const std::vector<double> &weights)
+{
+    if (weights.size() != n_epigraph)
+        throw std::runtime_error("StageMasterProblem::set_epigraph_weights: one weight per epigraph variable is needed.");
+    epigraph_weights = weights;
+    if (is_solver_attached())
+        update_solver_epigraph_objective();
+}
+
+void StageMasterProblem::update_solver_epigraph_objective()
+{
+    std::vector<double> obj(n_epigraph);
+    for (size_t g = 0; g < n_epigraph; ++g)
+        obj[g] = epigraph_weights[g] * CutPool::epigraph_coefficient(iteration);
+    int error = GRBsetdblattrarray(model, GRB_DBL_ATTR_OBJ, static_cast<int>(nvars_current), static_cast<int>(n_epigraph), obj.data());
+    if (error)
+    {
+        throw std::runtime_error("StageMasterProblem::update_solver_epigraph_objective: Gurobi error code " + std::to_string(error) + " when setting the objective.");
+    }
+}
+
+double StageMasterProblem::epigraph_shift() const
+{
+    return std::isinf(epigraph_lower_bound) ? 0.0 : epigraph_lower_bound;
+}
+
+double StageMasterProblem::cut_rhs(size_t i) const
+{
+    // eta + t beta (d + x_base) >= t alpha in d-space
+    double rhs = pool.get_scaled_alpha(i);
+    const std::vector<double> *base = get_x_base();
+    if (base != nullptr)
+        rhs -= kernels::dot(pool.get_scaled_beta(i), base->data(), nvars_current);
+    return rhs;
+}
+
+void StageMasterProblem::update_solver_cuts()
+{
+    if (!is_solver_attached())
+        throw std::runtime_error("StageMasterProblem::update_solver_cuts: solver is not attached");
+
+    int error = 0;
+
+    // shift the cut rows already in the model if x_base changed
+    const std::vector<double> *base = get_x_base();
+    std::vector<double> shift = base != nullptr ? *base : std::vector<double>();
+    if (shift != cut_shift && cuts_in_model > 0)
+    {
+        std::vector<double> rhs(cuts_in_model);
+        for (size_t i = 0; i < cuts_in_model; ++i)
+            rhs[i] = cut_rhs(i);
+        error = GRBsetdblattrarray(model, GRB_DBL_ATTR_RHS, static_cast<int>(nrows), static_cast<int>(cuts_in_model), rhs.data());
+        if (error)
+        {
+            throw std::runtime_error("StageMasterProblem::update_solver_cuts: Gurobi error code " + std::to_string(error) + " when shifting cuts.");
+        }
+    }
+    cut_shift = std::move(shift);
+
+    // add the pending cuts in one call, rows in CSR form
+    const size_t pending = pool.size() - cuts_in_model;
+    if (pending > 0)
+    {
+        std::vector<int> cbeg, cind;
+        std::vector<double> cval, rhs;
+        cbeg.reserve(pending);
+        rhs.reserve(pending);
+        for (size_t i = cuts_in_model; i < pool.size(); ++i)
+        {
+            cbeg.push_back(static_cast<int>(cind.size()));
+            const double *beta = pool.get_scaled_beta(i);
+            for (size_t c = 0; c < nvars_current; ++c)
+                if (beta[c] != 0.0)
+                {
+                    cind.push_back(static_cast<int>(c));
+                    cval.push_back(beta[c]);
+                }
+            cind.push_back(static_cast<int>(nvars_current + pool.get_epigraph(i)));
+            cval.push_back(1.0);
+            rhs.push_back(cut_rhs(i));
+        }
+        std::vector<char> sense(pending, GRB_GREATER_EQUAL);
+
+        error = GRBaddconstrs(model, static_cast<int>(pending), static_cast<int>(cind.size()),
+                              cbeg.data(), cind.data(), cval.data(), sense.data(), rhs.data(), nullptr);
+        if (error)
+        {
+            throw std::runtime_error("StageMasterProblem::update_solver_cuts: Gurobi error code " + std::to_string(error) + " when adding cuts.");
+        }
+        cuts_in_model = pool.size();
+    }
+
+    error = GRBupdatemodel(model);
+    if (error)
+    {
+        throw std::runtime_error("StageMasterProblem::update_solver_cuts: error updating model");
+    }
+}
+
+size_t StageMasterProblem::remove_inactive_cuts(uint64_t max_inactive)
+{
+    return remove_cuts(pool.inactive_cuts(activity_iteration, max_inactive));
+}
+
+size_t StageMasterProblem::remove_epigraph_cuts(size_t epigraph)
+{
+    if (epigraph >= n_epigraph)
+        throw std::runtime_error("StageMasterProblem::remove_epigraph_cuts: epigraph index out of range.");
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < pool.size(); ++i)
+        if (pool.get_epigraph(i) == epigraph)
+            indices.push_back(i);
+    return remove_cuts(indices);
+}
+
+size_t StageMasterProblem::remove_cuts(const std::vector<size_t> &indices)
+{
+    if (indices.empty())
+        return 0;
+
+    // rows of the removed cuts that are in the model, deleted in one call
+    std::vector<int> rows;
+    for (size_t i : indices)
+        if (i < cuts_in_model)
+            rows.push_back(static_cast<int>(nrows + i));
+
+    if (!rows.empty() && is_solver_attached())
+    {
+        int error = GRBdelconstrs(model, static_cast<int>(rows.size()), rows.data());
+        if (error)
+        {
+            throw std::runtime_error("StageMasterProblem::remove_cuts: Gurobi error code " + std::to_string(error) + " when deleting cuts.");
+        }
+        error = GRBupdatemodel(model);
+        if (error)
+        {
+            throw std::runtime_error("StageMasterProblem::remove_cuts: error updating model");
+        }
+    }
+
+    // the model and the pool both keep the order of the remaining cuts
+    cuts_in_model -= rows.size();
+    pool.remove(indices);
+    return indices.size();
+}
+
+StageProblem::Solution StageMasterProblem::solve_master()
+{
+    update_solver_root_stage();
+    // a removed trust region leaves its bounds in the model until reset once
+    if (trust_radius != std::numeric_limits<double>::infinity() || trust_region_in_model)
+    {
+        update_solver_trust_region();
+        trust_region_in_model = trust_radius != std::numeric_limits<double>::infinity();
+    }
+    update_solver_cuts();
+    Solution sol = solve_problem();
+    // the constant sum_g w_g L of the shifted epigraph variables
+    for (double w : epigraph_weights)
+        sol.obj_value += w * epigraph_shift();
+    mark_active_cuts();
+    return sol;
+}
+
+void StageMasterProblem::mark_active_cuts()
+{
+    if (cuts_in_model == 0)
+        return;
+
+    std::vector<double> slack(cuts_in_model), pi(cuts_in_model);
+    int error = GRBgetdblattrarray(model, GRB_DBL_ATTR_SLACK, static_cast<int>(nrows), static_cast<int>(cuts_in_model), slack.data());
+    if (!error)
+        error = GRBgetdblattrarray(model, GRB_DBL_ATTR_PI, static_cast<int>(nrows), static_cast<int>(cuts_in_model), pi.data());
+    if (error)
+    {
+        throw std::runtime_error("StageMasterProblem::mark_active_cuts: Gurobi error code " + std::to_string(error) + " when getting cut activity.");
+    }
+
+    for (size_t i = 0; i < cuts_in_model; ++i)
+        if (std::abs(slack[i]) <= ACTIVITY_TOLERANCE || std::abs(pi[i]) > ACTIVITY_TOLERANCE)
+            pool.mark_active(i, activity_iteration);
+}
+
+std::vector<double> StageMasterProblem::get_epigraph_values() const
+{
+    std::vector<double> eta(n_epigraph, 0.0);
+    int error = GRBgetdblattrarray(model, GRB_DBL_ATTR_X, static_cast<int>(nvars_current), static_cast<int>(n_epigraph), eta.data());
+    if (error)
+    {
+        throw std::runtime_error("StageMasterProblem::get_epigraph_values: Gurobi error code " + std::to_string(error) + " when getting epigraph values.");
+    }
+    // k theta = eta + k L
+    for (double &e : eta)
+        e += static_cast<double>(iteration) * epigraph_shift();
+    return eta;
+}
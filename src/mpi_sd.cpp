@@ -0,0 +1,262 @@
+#ifdef USE_MPI
+
+#include "mpi_sd.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // seconds since start
+    double elapsed(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    int comm_size(MPI_Comm comm)
+    {
+        int size;
+        MPI_Comm_size(comm, &size);
+        return size;
+    }
+
+    int comm_rank(MPI_Comm comm)
+    {
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+        return rank;
+    }
+
+    // a worker waiting for the master polls its window at this interval
+    constexpr auto POLL_INTERVAL = std::chrono::microseconds(100);
+}
+
+double TwoStageMPISD::WorkerStats::efficiency() const
+{
+    return busy + wait > 0.0 ? busy / (busy + wait) : 0.0;
+}
+
+TwoStageMPISD::TwoStageMPISD(const std::string &base_path, const std::string &prob_name, int nworkers_,
+                             const Options &options_, MPI_Comm comm_)
+    : TwoStageIndependentSP(base_path, prob_name, nworkers_, options_,
+                            static_cast<size_t>(std::max(comm_size(comm_) - 1, 1)),
+                            comm_rank(comm_) == 0 ? Solvers::MASTER : Solvers::WORKERS),
+      comm(comm_), win(MPI_WIN_NULL), snapshot_versions(napprox, 0), worker_stats(napprox + 1)
+{
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nranks);
+    if (nranks < 2)
+        throw std::runtime_error("TwoStageMPISD::TwoStageMPISD: at least two ranks are needed.");
+    if (options.samples_per_iteration == 0)
+        options.samples_per_iteration = static_cast<size_t>(nworkers);
+
+    const size_t dim = master->nvars_current;
+    snapshot_offset = STATE_OFFSET + master_state_size();
+    snapshot_capacity = ApproximationSnapshot::packed_size(SDApproximation::max_cuts(options.max_inactive), dim);
+    window_buffer.assign(snapshot_offset + 1 + snapshot_capacity, 0.0);
+
+    if (!is_master())
+    {
+        approximation = std::make_unique<SDApproximation>(worker_group(0, static_cast<size_t>(nworkers)),
+                                                          options.max_duals, options.eviction_policy);
+        // a different stream for every approximation
+        rng.seed(options.seed + static_cast<unsigned int>(rank));
+    }
+
+    MPI_Win_create(window_buffer.data(), static_cast<MPI_Aint>(window_buffer.size() * sizeof(double)),
+                   sizeof(double), MPI_INFO_NULL, comm, &win);
+}
+
+TwoStageMPISD::~TwoStageMPISD()
+{
+    if (win != MPI_WIN_NULL)
+        MPI_Win_free(&win);
+}
+
+bool TwoStageMPISD::is_master() const
+{
+    return rank == 0;
+}
+
+const std::vector<TwoStageMPISD::WorkerStats> &TwoStageMPISD::get_worker_stats() const
+{
+    return worker_stats;
+}
+
+void TwoStageMPISD::publish_master_state(uint64_t timestamp, bool stop)
+{
+    std::vector<double> state(1, stop ? 1.0 : 0.0), packed;
+    pack_master_state(timestamp, packed);
+    state.insert(state.end(), packed.begin(), packed.end());
+
+    for (int w = 1; w < nranks; ++w)
+    {
+        MPI_Win_lock(MPI_LOCK_EXCLUSIVE, w, 0, win);
+        MPI_Put(state.data(), static_cast<int>(state.size()), MPI_DOUBLE, w, 0,
+                static_cast<int>(state.size()), MPI_DOUBLE, win);
+        MPI_Win_unlock(w, win);
+    }
+}
+
+void TwoStageMPISD::read_snapshot(int w, std::vector<double> &packed)
+{
+    const size_t dim = master->nvars_current;
+
+    // the version and the snapshot header, then the rest if the version is new
+    const int header = static_cast<int>(ApproximationSnapshot::packed_size(0, dim));
+    std::vector<double> head(1 + header);
+    MPI_Win_lock(MPI_LOCK_SHARED, w, 0, win);
+    MPI_Get(head.data(), 1 + header, MPI_DOUBLE, w, static_cast<MPI_Aint>(snapshot_offset),
+            1 + header, MPI_DOUBLE, win);
+    MPI_Win_flush(w, win);
+
+    uint64_t version = static_cast<uint64_t>(head[0]);
+    size_t j = static_cast<size_t>(w - 1);
+    if (version == snapshot_versions[j])
+    {
+        MPI_Win_unlock(w, win);
+        return;
+    }
+    // ncuts sits at the end of the header
+    size_t ncuts = static_cast<size_t>(head[header]);
+    int length = static_cast<int>(ApproximationSnapshot::packed_size(ncuts, dim));
+    packed.resize(static_cast<size_t>(length));
+    MPI_Get(packed.data(), length, MPI_DOUBLE, w, static_cast<MPI_Aint>(snapshot_offset + 1),
+            length, MPI_DOUBLE, win);
+    MPI_Win_unlock(w, win);
+
+    snapshot_versions[j] = version;
+    set_snapshot(j, ApproximationSnapshot::unpack(packed, dim));
+}
+
+void TwoStageMPISD::run_master()
+{
+    // the validator runs on the master rank only
+    start_validation();
+
+    uint64_t timestamp = 1;
+    publish_master_state(timestamp, false);
+
+    std::vector<double> packed;
+    double predicted_decrease = 0.0;
+    while (iteration < options.max_iterations)
+    {
+        auto phase_start = Clock::now();
+        for (int w = 1; w < nranks; ++w)
+            read_snapshot(w, packed);
+        timing.read += elapsed(phase_start);
+
+        if (!ready(timestamp))
+        {
+            phase_start = Clock::now();
+            std::this_thread::sleep_for(POLL_INTERVAL);
+            timing.wait += elapsed(phase_start);
+            continue;
+        }
+
+        bool converged = update(predicted_decrease);
+        publish_master_state(++timestamp, false);
+        if (converged)
+            break;
+    }
+
+    publish_master_state(timestamp, true);
+    stop_validation();
+}
+
+void TwoStageMPISD::run_worker(WorkerStats &stats)
+{
+    const size_t dim = master->nvars_current;
+    const size_t state_size = master_state_size();
+    uint64_t timestamp = 0, steps = 0, version = 0;
+    std::vector<double> state(STATE_OFFSET + state_size), packed;
+    std::vector<double> x_candidate, x_incumbent;
+
+    while (true)
+    {
+        MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, win);
+        std::copy(window_buffer.begin(), window_buffer.begin() + STATE_OFFSET + state_size, state.begin());
+        MPI_Win_unlock(rank, win);
+
+        if (state[0] != 0.0)
+            break;
+        uint64_t master_timestamp = static_cast<uint64_t>(state[STATE_OFFSET]);
+        if (master_timestamp != timestamp)
+        {
+            timestamp = master_timestamp;
+            steps = 0;
+            auto x_begin = state.begin() + STATE_OFFSET + 1;
+            x_candidate.assign(x_begin, x_begin + dim);
+            x_incumbent.assign(x_begin + dim, x_begin + 2 * dim);
+        }
+
+        // bounded staleness: wait for the master after max_sample_count steps,
+        // and before its first state arrives
+        if (timestamp == 0 || steps >= max_sample_count)
+        {
+            auto wait_start = Clock::now();
+            std::this_thread::sleep_for(POLL_INTERVAL);
+            stats.wait += elapsed(wait_start);
+            continue;
+        }
+        ++steps;
+
+        auto step_start = Clock::now();
+        std::vector<std::vector<double>> samples(options.samples_per_iteration);
+        for (auto &omega : samples)
+            omega = second_stage_omega(sto.generate_scenario(rng));
+        approximation->step(samples, x_candidate, x_incumbent, options.max_inactive);
+        approximation->snapshot(timestamp).pack(dim, packed);
+
+        MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, win);
+        window_buffer[snapshot_offset] = static_cast<double>(++version);
+        std::copy(packed.begin(), packed.end(), window_buffer.begin() + snapshot_offset + 1);
+        MPI_Win_unlock(rank, win);
+        stats.busy += elapsed(step_start);
+        ++stats.steps;
+    }
+    stats.samples = approximation->num_samples();
+}
+
+void TwoStageMPISD::solve()
+{
+    const auto start_time = Clock::now();
+    timing = Timing();
+
+    // the workers take the candidate and the incumbent from the master state
+    WorkerStats own;
+    if (is_master())
+    {
+        start();
+        run_master();
+    }
+    else
+        run_worker(own);
+
+    // statistics of every worker to the master
+    double local[4] = {own.busy, own.wait, static_cast<double>(own.steps), static_cast<double>(own.samples)};
+    std::vector<double> all(4 * static_cast<size_t>(nranks));
+    MPI_Gather(local, 4, MPI_DOUBLE, all.data(), 4, MPI_DOUBLE, 0, comm);
+    if (is_master())
+        for (int w = 1; w < nranks; ++w)
+        {
+            WorkerStats &stats = worker_stats[static_cast<size_t>(w)];
+            stats.busy = all[4 * w];
+            stats.wait = all[4 * w + 1];
+            stats.steps = static_cast<uint64_t>(all[4 * w + 2]);
+            stats.samples = static_cast<uint64_t>(all[4 * w + 3]);
+        }
+
+    // the result on every rank
+    incumbent.resize(master->nvars_current);
+    MPI_Bcast(incumbent.data(), static_cast<int>(incumbent.size()), MPI_DOUBLE, 0, comm);
+    MPI_Bcast(&incumbent_estimate, 1, MPI_DOUBLE, 0, comm);
+    MPI_Bcast(&iteration, 1, MPI_UINT64_T, 0, comm);
+
+    timing.total = elapsed(start_time);
+}
+
+#endif // USE_MPI
@@ -119,3 +119,11 @@ StageStochasticPattern::StageStochasticPattern(int _stage, const std::vector<int
                                                const std::vector<size_t> &_indices_in_scenario)
     : stage(_stage), row_index(_row_index), col_index(_col_index),
       reference_values(_reference_values), indices_in_scenario(_indices_in_scenario), rv_count(_indices_in_scenario.size()) {}
+
+void stage_omega(const StageStochasticPattern &pattern, const std::vector<double> &scenario,
+                 std::vector<double> &omega)
+{
+    omega.resize(pattern.rv_count);
+    for (size_t i = 0; i < pattern.rv_count; ++i)
+        omega[i] = scenario[pattern.indices_in_scenario[i]];
+}
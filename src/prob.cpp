@@ -1,4 +1,5 @@
 #include "prob.h"
+#include <cmath>
 #include <stdexcept> // For std::runtime_error
 
 #if UNIT_TEST
@@ -14,6 +15,7 @@ StageProblem::StageProblem(const StageProblem &other)
     : nvars_last(other.nvars_last), nvars_current(other.nvars_current), nrows(other.nrows),
       last_stage_var_names(other.last_stage_var_names), current_stage_var_names(other.current_stage_var_names), current_stage_row_names(other.current_stage_row_names),
       transfer_block(other.transfer_block), current_block(other.current_block),
+      transfer_block_csr(other.transfer_block_csr), current_block_csr(other.current_block_csr),
       lb(other.lb), ub(other.ub), rhs_bar(other.rhs_bar),
       inequality_directions(other.inequality_directions),
       cost_coefficients(other.cost_coefficients),
@@ -35,6 +37,7 @@ StageProblem::StageProblem(StageProblem &&other) noexcept
     : nvars_last(other.nvars_last), nvars_current(other.nvars_current), nrows(other.nrows),
       last_stage_var_names(std::move(other.last_stage_var_names)), current_stage_var_names(std::move(other.current_stage_var_names)), current_stage_row_names(std::move(other.current_stage_row_names)),
       transfer_block(std::move(other.transfer_block)), current_block(std::move(other.current_block)),
+      transfer_block_csr(std::move(other.transfer_block_csr)), current_block_csr(std::move(other.current_block_csr)),
       lb(std::move(other.lb)), ub(std::move(other.ub)), rhs_bar(std::move(other.rhs_bar)),
       inequality_directions(std::move(other.inequality_directions)),
       cost_coefficients(std::move(other.cost_coefficients)),
@@ -66,6 +69,8 @@ StageProblem &StageProblem::operator=(StageProblem &&other) noexcept
         current_stage_row_names = std::move(other.current_stage_row_names);
         transfer_block = std::move(other.transfer_block);
         current_block = std::move(other.current_block);
+        transfer_block_csr = std::move(other.transfer_block_csr);
+        current_block_csr = std::move(other.current_block_csr);
         lb = std::move(other.lb);
         ub = std::move(other.ub);
         rhs_bar = std::move(other.rhs_bar);
@@ -128,10 +133,8 @@ void StageProblem::attach_solver()
     }
 
     // Add constraints block
-    SparseMatrixCSR A(current_block);
-    std::vector<int> cbeg(A.getRowBegin()),
-        cind(A.getColumnIndex());
-    std::vector<double> cval(A.getValues());
+    // the shared CSR arrays are passed to the solver directly, gurobi only reads them
+    const SparseMatrixCSR<double> &A = *current_block_csr;
 
     // generate sense that is compatible with gurobi
     std::vector<char> sense;
@@ -149,8 +152,10 @@ void StageProblem::attach_solver()
     }
 
     error = GRBaddconstrs(model, nrows,
-                          current_block.nnz(),
-                          cbeg.data(), cind.data(), cval.data(),
+                          A.nnz(),
+                          const_cast<int *>(A.getRowBegin().data()),
+                          const_cast<int *>(A.getColumnIndex().data()),
+                          const_cast<double *>(A.getValues().data()),
                           sense.data(),
                           rhs_bar.data(),
                           nullptr);
@@ -190,8 +195,8 @@ void StageProblem::update_solver_with_scenario(const std::vector<double> &z_valu
     std::vector<double> new_rhs(rhs_bar);
 
     // Apply transfer block
-    if (transfer_block.nnz() > 0)
-        transfer_block.subtract_multiply_with_vector(z_value, new_rhs);
+    if (transfer_block_csr->nnz() > 0)
+        transfer_block_csr->subtract_multiply_with_vector(z_value, new_rhs);
 
     // Apply RHS shift
     if (shift_x_base)
@@ -267,7 +272,14 @@ void StageProblem::update_solver_root_stage()
     }
 }
 
-StageProblem::Solution StageProblem::solve_problem(bool require_dual_solution)
+StageProblem::Solution StageProblem::solve_problem(bool require_dual_solution, bool sparse_dual)
+{
+    Solution solution;
+    solve_problem(solution, require_dual_solution, sparse_dual);
+    return solution;
+}
+
+void StageProblem::solve_problem(Solution &solution, bool require_dual_solution, bool sparse_dual)
 {
     if (!is_solver_attached())
     {
@@ -281,20 +293,40 @@ StageProblem::Solution StageProblem::solve_problem(bool require_dual_solution)
         throw std::runtime_error("StageProblem::solve_problem: Gurobi error code " + std::to_string(error) + " when optimizing.");
     }
 
-    // get the solution
-    std::vector<double> solution = get_primal_solution();
-
-    // get the objective value
-    double obj_value = get_obj_value();
+    // get the solution and the objective value
+    get_primal_solution(solution.solution);
+    solution.obj_value = get_obj_value();
+    solution.dual_is_sparse = false;
+    solution.sparse_dual_solution.dim = 0;
+    solution.sparse_dual_solution.index.clear();
+    solution.sparse_dual_solution.value.clear();
 
     if (!require_dual_solution)
     {
-        return {obj_value, solution, {}};
-    } else {
-        // get the dual solution
-        std::vector<double> dual_solution = get_dual_solution();
-        return {obj_value, solution, dual_solution};
+        solution.dual_solution.clear();
+        return;
+    }
+
+    // get the dual solution
+    get_dual_solution(solution.dual_solution);
+    if (!sparse_dual)
+        return;
+
+    // gurobi only returns dense arrays, so keep the index/value pairs of the
+    // non-zero entries, or the dense form if there are too many of them
+    solution.sparse_dual_solution.assign_dense(solution.dual_solution, SPARSE_DUAL_TOLERANCE);
+    if (solution.sparse_dual_solution.density() > SPARSE_DUAL_MAX_DENSITY)
+    {
+        for (double &pi : solution.dual_solution)
+            if (std::abs(pi) <= SPARSE_DUAL_TOLERANCE)
+                pi = 0.0;
+        solution.sparse_dual_solution.dim = 0;
+        solution.sparse_dual_solution.index.clear();
+        solution.sparse_dual_solution.value.clear();
+        return;
     }
+    solution.dual_solution.clear();
+    solution.dual_is_sparse = true;
 }
 
 void StageProblem::set_x_base(const std::vector<double> &x_base_)
@@ -333,6 +365,11 @@ double StageProblem::get_cost_shift() const
         return 0.0;
 }
 
+const std::vector<double> *StageProblem::get_x_base() const
+{
+    return shift_x_base ? &x_base : nullptr;
+}
+
 size_t StageProblem::get_dual_dimension() const
 {
     return nrows + non_trivial_fx_index.size() + non_trivial_lb_index.size() + non_trivial_ub_index.size();
@@ -353,7 +390,7 @@ void StageProblem::update_rhs_shift()
     if (!shift_x_base)
         return;
     // then add current_block * x_base
-    current_block.multiply_with_vector(x_base, rhs_shift);
+    current_block_csr->multiply_with_vector(x_base, rhs_shift);
 }
 
 void StageProblem::update_cost_shift()
@@ -396,22 +433,41 @@ void StageProblem::update_solver_bounds()
     }
 }
 
-std::vector<double> StageProblem::get_primal_solution() const
+void StageProblem::get_rhs_ranging(std::vector<double> &rhs, std::vector<double> &low, std::vector<double> &up) const
+{
+    if (!is_solver_attached())
+    {
+        throw std::runtime_error("StageProblem::get_rhs_ranging: solver is not attached");
+    }
+
+    rhs.resize(nrows);
+    low.resize(nrows);
+    up.resize(nrows);
+    int error = GRBgetdblattrarray(model, GRB_DBL_ATTR_RHS, 0, nrows, rhs.data());
+    if (!error)
+        error = GRBgetdblattrarray(model, GRB_DBL_ATTR_SARHSLOW, 0, nrows, low.data());
+    if (!error)
+        error = GRBgetdblattrarray(model, GRB_DBL_ATTR_SARHSUP, 0, nrows, up.data());
+    if (error)
+    {
+        throw std::runtime_error("StageProblem::get_rhs_ranging: Gurobi error code " + std::to_string(error) + " when getting the rhs ranging.");
+    }
+}
+
+void StageProblem::get_primal_solution(std::vector<double> &solution) const
 {
-    std::vector<double> solution(nvars_current, 0.0);
+    solution.assign(nvars_current, 0.0);
     int error = GRBgetdblattrarray(model, GRB_DBL_ATTR_X, 0, nvars_current, solution.data());
     if (error)
     {
         throw std::runtime_error("StageProblem::solve_problem: Gurobi error code " + std::to_string(error) + " when getting solution.");
     }
-
-    return solution;
 }
 
-std::vector<double> StageProblem::get_dual_solution() const
+void StageProblem::get_dual_solution(std::vector<double> &dual) const
 {
-    std::vector<double> dual(get_dual_dimension(), 0.0);
-    
+    dual.assign(get_dual_dimension(), 0.0);
+
     // get dual solution
     int error = GRBgetdblattrarray(model, GRB_DBL_ATTR_PI, 0, nrows, dual.data());
     if (error)
@@ -449,8 +505,6 @@ std::vector<double> StageProblem::get_dual_solution() const
             throw std::runtime_error("StageProblem::solve_problem: Gurobi error code " + std::to_string(error) + " when getting dual solution for non-trivial upper bound.");
         }
     }
-
-    return dual;
 }
 
 double StageProblem::get_obj_value() const
@@ -496,11 +550,9 @@ void StageProblem::read_smps(const smps::SMPSCore &cor, const smps::SMPSTime &ti
     inequality_directions.assign(nrows, '\0');
 
     // Set matrix size
-    transfer_block.clear();
-    transfer_block.resize(nrows, nvars_last);
-
-    current_block.clear();
-    current_block.resize(nrows, nvars_current);
+    SparseMatrix<double> transfer, current;
+    transfer.resize(nrows, nvars_last);
+    current.resize(nrows, nvars_current);
 
     // Process columns
     for (size_t i = 0; i < total_ncols; ++i)
@@ -576,16 +628,22 @@ void StageProblem::read_smps(const smps::SMPSCore &cor, const smps::SMPSTime &ti
             if (col_stage == stage - 1)
             {
                 // Transfer block
-                transfer_block.add_element(row_index, col_index, value);
+                transfer.add_element(row_index, col_index, value);
             }
             else if (col_stage == stage)
             {
                 // Current block
-                current_block.add_element(row_index, col_index, value);
+                current.add_element(row_index, col_index, value);
             }
         }
     }
 
+    // Row-major copies for the matrix-vector products
+    transfer_block_csr = std::make_shared<const SparseMatrixCSR<double>>(transfer);
+    current_block_csr = std::make_shared<const SparseMatrixCSR<double>>(current);
+    transfer_block = std::make_shared<const SparseMatrix<double>>(std::move(transfer));
+    current_block = std::make_shared<const SparseMatrix<double>>(std::move(current));
+
     // Read the stochastic pattern
     stage_stoc_pattern = StochasticPattern::from_smps(cor, tim, sto).filter_by_stage(stage);
 
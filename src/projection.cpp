@@ -55,7 +55,7 @@ bool StageProjectionProblem::is_feasible(const std::vector<double> &x0)
 
     // multiply the constraint matrix with x0
     std::vector<double> result(nrows, 0.0);
-    current_block.multiply_with_vector(x0, result);
+    current_block_csr->multiply_with_vector(x0, result);
 
     // check the inequality constraints
     for (size_t i = 0; i < nrows; i++)
@@ -0,0 +1,38 @@
+#include "scheduler.h"
+#include <atomic>
+#include <exception>
+#include <omp.h>
+#include <stdexcept>
+
+void parallel_sweep(int nthreads, size_t ntasks, const std::function<void(int, size_t)> &body)
+{
+    if (nthreads <= 0)
+        throw std::runtime_error("parallel_sweep: at least one thread is needed.");
+
+    // exceptions cannot leave the parallel region, the first one is rethrown after it
+    std::exception_ptr error;
+    std::atomic<bool> failed(false);
+
+    #pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+    for (size_t task = 0; task < ntasks; ++task)
+    {
+        if (failed.load(std::memory_order_relaxed))
+            continue;
+        try
+        {
+            body(omp_get_thread_num(), task);
+        }
+        catch (...)
+        {
+            #pragma omp critical(parallel_sweep_error)
+            {
+                if (!error)
+                    error = std::current_exception();
+            }
+            failed.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
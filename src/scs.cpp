@@ -1,4 +1,5 @@
 #include "scs.h"
+#include "kernels.h"
 #include <cstddef>
 // #define DEBUG_SCS
 #ifdef DEBUG_SCS
@@ -11,31 +12,19 @@ void SCS::update(const std::vector<double> &grad)
     {
         current_direction = grad;
         initialized = true;
+
+        // update norm
+        d_norm_squared = kernels::dot(current_direction.data(), current_direction.data(), current_direction.size());
     } else [[likely]]
     {
         // dg = g^T d and gg = g^T g
         double dg = 0.0, gg = 0.0;
-        for (size_t i = 0; i < current_direction.size(); i++)
-        {
-            dg += grad[i] * current_direction[i];
-            gg += grad[i] * grad[i];
-        }
+        kernels::dot_and_norm(grad.data(), current_direction.data(), current_direction.size(), dg, gg);
 
+        // update the direction and its norm
         double lambda = optimal_lambda(dg, gg, d_norm_squared);
-        for (size_t i = 0; i < current_direction.size(); i++)
-        {
-            current_direction[i] = lambda * current_direction[i] + (1.0 - lambda) * grad[i];
-        }
-    }
-
-    // update norm
-    double new_norm_squared = 0.0;
-    for (size_t i = 0; i < current_direction.size(); i++)
-    {
-        new_norm_squared += current_direction[i] * current_direction[i];
+        d_norm_squared = kernels::update_direction(current_direction.data(), grad.data(), lambda, current_direction.size());
     }
-
-    d_norm_squared = new_norm_squared;
 }
 
 const std::vector<double> &SCS::get_current_direction() const
@@ -82,11 +71,7 @@ bool UnconstrainedSCS::satisfy_L_condition(double f_forward, double f_current, d
 bool UnconstrainedSCS::satisfy_R_condition(const std::vector<double> &g_forward) const
 {
     // dot product of grad_forward and current_direction
-    double dg = 0.0;
-    for (size_t i = 0; i < current_direction.size(); i++)
-    {
-        dg += g_forward[i] * current_direction[i];
-    }
+    double dg = kernels::dot(g_forward.data(), current_direction.data(), current_direction.size());
 
     bool satisfied = dg >= - m2 * d_norm_squared;
 
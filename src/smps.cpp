@@ -360,6 +360,13 @@ namespace smps
         return s;
     }
 
+    bool SMPSStoch::SMPSIndepDiscrete::support(std::vector<double> &_values, std::vector<double> &_probs) const
+    {
+        _values = values;
+        _probs = dist.probabilities();
+        return true;
+    }
+
     double SMPSStoch::SMPSIndepNormal::generate(std::mt19937 &rng)
     {
         return dist(rng);
@@ -558,4 +565,38 @@ namespace smps
         return indep_pos;
     }
 
+    std::vector<SMPSStoch::Scenario> SMPSStoch::enumerate_scenarios(size_t max_scenarios) const
+    {
+        std::vector<std::vector<double>> values(indep_elem.size()), probs(indep_elem.size());
+        size_t count = 1;
+        for (size_t i = 0; i < indep_elem.size(); i++) {
+            if (!indep_elem[i]->support(values[i], probs[i]) || values[i].empty())
+                return {};
+            // count * size > max_scenarios, without overflow
+            if (count > max_scenarios / values[i].size())
+                return {};
+            count *= values[i].size();
+        }
+
+        // odometer over the value indices
+        std::vector<Scenario> scenarios;
+        scenarios.reserve(count);
+        std::vector<size_t> index(indep_elem.size(), 0);
+        for (size_t s = 0; s < count; s++) {
+            Scenario scenario{std::vector<double>(indep_elem.size()), 1.0};
+            for (size_t i = 0; i < indep_elem.size(); i++) {
+                scenario.omega[i] = values[i][index[i]];
+                scenario.probability *= probs[i][index[i]];
+            }
+            scenarios.push_back(std::move(scenario));
+
+            for (size_t i = indep_elem.size(); i-- > 0;) {
+                if (++index[i] < values[i].size())
+                    break;
+                index[i] = 0;
+            }
+        }
+        return scenarios;
+    }
+
 } // namespace smps
@@ -1,35 +1,40 @@
 #include "sparse.h"
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
+#include <omp.h>
 
-template <typename T>
-SparseMatrix<T>::SparseMatrix() : num_rows(0), num_cols(0) {}
+template <typename T, typename I>
+SparseMatrix<T, I>::SparseMatrix() : num_rows(0), num_cols(0) {}
 
-template <typename T>
-SparseMatrix<T>::SparseMatrix(const std::vector<int> &_row_indices, const std::vector<int> &_col_indices, 
-                              const std::vector<T> &_values, size_t _num_rows, size_t _num_cols)
+template <typename T, typename I>
+SparseMatrix<T, I>::SparseMatrix(const std::vector<I> &_row_indices, const std::vector<I> &_col_indices,
+                                 const std::vector<T> &_values, size_t _num_rows, size_t _num_cols)
     : num_rows(_num_rows), num_cols(_num_cols), 
       row_indices(_row_indices), col_indices(_col_indices), values(_values) {}
 
-template <typename T>
-void SparseMatrix<T>::resize(size_t _num_rows, size_t _num_cols) {
+template <typename T, typename I>
+void SparseMatrix<T, I>::resize(size_t _num_rows, size_t _num_cols) {
+    if (!fits_in_index<I>(_num_rows) || !fits_in_index<I>(_num_cols))
+        throw std::overflow_error("SparseMatrix::resize: dimensions too large for the index type, use a 64-bit index type");
     num_rows = _num_rows;
     num_cols = _num_cols;
 }
 
-template <typename T>
-void SparseMatrix<T>::add_element(int row, int col, T value) {
+template <typename T, typename I>
+void SparseMatrix<T, I>::add_element(I row, I col, T value) {
     row_indices.push_back(row);
     col_indices.push_back(col);
     values.push_back(value);
 }
 
-template <typename T>
-size_t SparseMatrix<T>::nnz() const {
+template <typename T, typename I>
+size_t SparseMatrix<T, I>::nnz() const {
     return values.size();
 }
 
-template <typename T>
-T SparseMatrix<T>::get_element(int row, int col) const {
+template <typename T, typename I>
+T SparseMatrix<T, I>::get_element(I row, I col) const {
     for (size_t i = 0; i < values.size(); ++i) {
         if (row_indices[i] == row && col_indices[i] == col) {
             return values[i];
@@ -38,150 +43,352 @@ T SparseMatrix<T>::get_element(int row, int col) const {
     return T(0);
 }
 
-template <typename T>
-void SparseMatrix<T>::multiply_with_vector(const std::vector<T> &vec, std::vector<T> &result) const {
-    result.assign(num_rows, T(0));
+template <typename T, typename I>
+template <typename V>
+void SparseMatrix<T, I>::multiply_with_vector(const std::vector<V> &vec, std::vector<V> &result) const {
+    result.assign(num_rows, V(0));
     for (size_t i = 0; i < values.size(); ++i) {
-        result[row_indices[i]] += values[i] * vec[col_indices[i]];
+        result[row_indices[i]] += static_cast<V>(values[i]) * vec[col_indices[i]];
     }
 }
 
-template <typename T>
-void SparseMatrix<T>::multiply_transpose_with_vector(const std::vector<T> &vec, std::vector<T> &result) const {
-    result.assign(num_cols, T(0));
+template <typename T, typename I>
+template <typename V>
+void SparseMatrix<T, I>::multiply_transpose_with_vector(const std::vector<V> &vec, std::vector<V> &result) const {
+    result.assign(num_cols, V(0));
     for (size_t i = 0; i < values.size(); ++i) {
-        result[col_indices[i]] += values[i] * vec[row_indices[i]];
+        result[col_indices[i]] += static_cast<V>(values[i]) * vec[row_indices[i]];
     }
 }
 
-template <typename T>
-void SparseMatrix<T>::subtract_multiply_with_vector(const std::vector<T> &vec, std::vector<T> &result) const
+template <typename T, typename I>
+template <typename V>
+void SparseMatrix<T, I>::subtract_multiply_with_vector(const std::vector<V> &vec, std::vector<V> &result) const
 {
     // if (result.size() < num_rows) {
     //     throw std::runtime_error("SparseMatrix::subtract_multiply_with_vector: result vector has incorrect size");
     // }
 
     for (size_t i = 0; i < values.size(); ++i) {
-        result[row_indices[i]] -= values[i] * vec[col_indices[i]];
+        result[row_indices[i]] -= static_cast<V>(values[i]) * vec[col_indices[i]];
     }
 }
 
 // Iterator class
-template <typename T>
-SparseMatrix<T>::Iterator::Iterator(const SparseMatrix &matrix, size_t pos) 
+template <typename T, typename I>
+SparseMatrix<T, I>::Iterator::Iterator(const SparseMatrix &matrix, size_t pos) 
     : matrix_(matrix), pos_(pos) {}
 
-template <typename T>
-bool SparseMatrix<T>::Iterator::operator!=(const Iterator &other) const {
+template <typename T, typename I>
+bool SparseMatrix<T, I>::Iterator::operator!=(const Iterator &other) const {
     return pos_ != other.pos_;
 }
 
-template <typename T>
-const typename SparseMatrix<T>::Iterator &SparseMatrix<T>::Iterator::operator++() {
+template <typename T, typename I>
+const typename SparseMatrix<T, I>::Iterator &SparseMatrix<T, I>::Iterator::operator++() {
     ++pos_;
     return *this;
 }
 
-template <typename T>
-std::pair<int, int> SparseMatrix<T>::Iterator::position() const {
+template <typename T, typename I>
+std::pair<I, I> SparseMatrix<T, I>::Iterator::position() const {
     return std::make_pair(matrix_.row_indices[pos_], matrix_.col_indices[pos_]);
 }
 
-template <typename T>
-T SparseMatrix<T>::Iterator::value() const {
+template <typename T, typename I>
+T SparseMatrix<T, I>::Iterator::value() const {
     return matrix_.values[pos_];
 }
 
-template <typename T>
-typename SparseMatrix<T>::Iterator::Element SparseMatrix<T>::Iterator::operator*() const {
+template <typename T, typename I>
+typename SparseMatrix<T, I>::Iterator::Element SparseMatrix<T, I>::Iterator::operator*() const {
     return Element(matrix_.row_indices[pos_], matrix_.col_indices[pos_], matrix_.values[pos_]);
 }
 
-template <typename T>
-SparseMatrix<T>::Iterator::Element::Element(int _row, int _col, T _val) 
+template <typename T, typename I>
+SparseMatrix<T, I>::Iterator::Element::Element(I _row, I _col, T _val) 
     : row(_row), col(_col), val(_val) {}
 
-template <typename T>
-typename SparseMatrix<T>::Iterator SparseMatrix<T>::begin() const {
+template <typename T, typename I>
+typename SparseMatrix<T, I>::Iterator SparseMatrix<T, I>::begin() const {
     return Iterator(*this);
 }
 
-template <typename T>
-typename SparseMatrix<T>::Iterator SparseMatrix<T>::end() const {
+template <typename T, typename I>
+typename SparseMatrix<T, I>::Iterator SparseMatrix<T, I>::end() const {
     return Iterator(*this, values.size());
 }
 
-template <typename T>
-size_t SparseMatrix<T>::get_num_rows() const
+template <typename T, typename I>
+size_t SparseMatrix<T, I>::get_num_rows() const
 {
     return num_rows;
 }
 
-template <typename T>
-size_t SparseMatrix<T>::get_num_cols() const
+template <typename T, typename I>
+size_t SparseMatrix<T, I>::get_num_cols() const
 {
     return num_cols;
 }
 
-template <typename T>
-void SparseMatrix<T>::clear()
+template <typename T, typename I>
+void SparseMatrix<T, I>::clear()
 {
     row_indices.clear();
     col_indices.clear();
     values.clear();
 }
 
-// Explicit template instantiation
-template class SparseMatrix<double>;
-template class SparseMatrix<float>;
-
-SparseMatrixCSR::SparseMatrixCSR(const SparseMatrix<double>& matrix) {
-    convertToCSR(matrix);
-}
+template <typename T, typename I>
+SparseMatrixCSR<T, I>::SparseMatrixCSR() : num_rows(0), num_cols(0), cbeg(1, 0) {}
 
-const std::vector<int>& SparseMatrixCSR::getRowBegin() const {
+template <typename T, typename I>
+const std::vector<I>& SparseMatrixCSR<T, I>::getRowBegin() const {
     return cbeg;
 }
 
-const std::vector<int>& SparseMatrixCSR::getColumnIndex() const {
+template <typename T, typename I>
+const std::vector<I>& SparseMatrixCSR<T, I>::getColumnIndex() const {
     return cind;
 }
 
-const std::vector<double>& SparseMatrixCSR::getValues() const {
+template <typename T, typename I>
+const std::vector<T>& SparseMatrixCSR<T, I>::getValues() const {
     return cval;
 }
 
-void SparseMatrixCSR::convertToCSR(const SparseMatrix<double>& matrix) {
-    size_t numRows = matrix.get_num_rows();
+template <typename T, typename I>
+size_t SparseMatrixCSR<T, I>::get_num_rows() const
+{
+    return num_rows;
+}
 
-    // Initialize row begin array with zeroes
-    cbeg.assign(numRows + 1, 0);
+template <typename T, typename I>
+size_t SparseMatrixCSR<T, I>::get_num_cols() const
+{
+    return num_cols;
+}
 
-    // First pass to count the number of elements in each row
-    for (auto it = matrix.begin(); it != matrix.end(); ++it) {
-        int row = it.position().first;
-        cbeg[row + 1]++;
+template <typename T, typename I>
+size_t SparseMatrixCSR<T, I>::nnz() const
+{
+    return cval.size();
+}
+
+template <typename T, typename I>
+bool SparseMatrixCSR<T, I>::use_parallel() const
+{
+    return nnz() >= PARALLEL_NNZ_THRESHOLD && omp_get_max_threads() > 1 && !omp_in_parallel();
+}
+
+template <typename T, typename I>
+std::pair<size_t, size_t> SparseMatrixCSR<T, I>::row_range(int part, int nparts) const
+{
+    // first row whose offset reaches part / nparts of the non-zeros
+    auto split = [&](int p) -> size_t {
+        if (p <= 0)
+            return 0;
+        if (p >= nparts)
+            return num_rows;
+        I target = static_cast<I>(nnz() * static_cast<size_t>(p) / static_cast<size_t>(nparts));
+        return std::lower_bound(cbeg.begin(), cbeg.end() - 1, target) - cbeg.begin();
+    };
+    return std::make_pair(split(part), split(part + 1));
+}
+
+template <typename T, typename I>
+template <typename V>
+void SparseMatrixCSR<T, I>::multiply_rows(const std::vector<V> &vec, std::vector<V> &result, V sign,
+                                          size_t row_begin, size_t row_end) const
+{
+    for (size_t r = row_begin; r < row_end; ++r)
+    {
+        V sum = V(0);
+        for (I k = cbeg[r]; k < cbeg[r + 1]; ++k)
+            sum += static_cast<V>(cval[k]) * vec[cind[k]];
+        result[r] += sign * sum;
+    }
+}
+
+template <typename T, typename I>
+template <typename V>
+void SparseMatrixCSR<T, I>::accumulate_multiply(const std::vector<V> &vec, std::vector<V> &result, V sign) const
+{
+    if (!use_parallel())
+    {
+        multiply_rows(vec, result, sign, 0, num_rows);
+        return;
     }
 
-    // Cumulative sum to get actual starting positions
-    for (size_t i = 1; i < cbeg.size(); i++) {
-        cbeg[i] += cbeg[i - 1];
+    #pragma omp parallel
+    {
+        auto range = row_range(omp_get_thread_num(), omp_get_num_threads());
+        multiply_rows(vec, result, sign, range.first, range.second);
     }
+}
+
+template <typename T, typename I>
+template <typename V>
+void SparseMatrixCSR<T, I>::multiply_with_vector(const std::vector<V> &vec, std::vector<V> &result) const
+{
+    result.assign(num_rows, V(0));
+    accumulate_multiply(vec, result, V(1));
+}
+
+template <typename T, typename I>
+template <typename V>
+void SparseMatrixCSR<T, I>::subtract_multiply_with_vector(const std::vector<V> &vec, std::vector<V> &result) const
+{
+    accumulate_multiply(vec, result, V(-1));
+}
 
-    // Resize cind and cval to accommodate all non-zero elements
-    cind.resize(matrix.nnz());
-    cval.resize(matrix.nnz());
-
-    // Second pass to fill cind and cval
-    std::vector<int> next_pos(numRows, 0);
-    for (auto it = matrix.begin(); it != matrix.end(); ++it) {
-        int row = it.position().first;
-        int col = it.position().second;
-        double value = static_cast<double>(it.value());
-
-        int pos = cbeg[row] + next_pos[row];
-        cind[pos] = col;
-        cval[pos] = value;
-        next_pos[row]++;
+template <typename T, typename I>
+template <typename V>
+void SparseMatrixCSR<T, I>::multiply_transpose_with_vector(const std::vector<V> &vec, std::vector<V> &result) const
+{
+    result.assign(num_cols, V(0));
+
+    if (!use_parallel())
+    {
+        for (size_t r = 0; r < num_rows; ++r)
+            for (I k = cbeg[r]; k < cbeg[r + 1]; ++k)
+                result[cind[k]] += static_cast<V>(cval[k]) * vec[r];
+        return;
     }
-}
\ No newline at end of file
+
+    // one private accumulator per thread, reduced column-wise afterwards
+    int max_threads = omp_get_max_threads();
+    std::vector<V> partial(static_cast<size_t>(max_threads) * num_cols, V(0));
+
+    #pragma omp parallel num_threads(max_threads)
+    {
+        int tid = omp_get_thread_num(), nthreads = omp_get_num_threads();
+        auto range = row_range(tid, nthreads);
+        V *local = partial.data() + static_cast<size_t>(tid) * num_cols;
+        for (size_t r = range.first; r < range.second; ++r)
+            for (I k = cbeg[r]; k < cbeg[r + 1]; ++k)
+                local[cind[k]] += static_cast<V>(cval[k]) * vec[r];
+
+        #pragma omp barrier
+
+        #pragma omp for schedule(static)
+        for (size_t c = 0; c < num_cols; ++c)
+        {
+            V sum = V(0);
+            for (int t = 0; t < nthreads; ++t)
+                sum += partial[static_cast<size_t>(t) * num_cols + c];
+            result[c] = sum;
+        }
+    }
+}
+
+template <typename T, typename I>
+template <typename V>
+void SparseMatrixCSR<T, I>::multiply_transpose_with_vector(const SparseVector<V, I> &vec, std::vector<V> &result) const
+{
+    result.assign(num_cols, V(0));
+    add_multiply_transpose_with_vector(vec, result);
+}
+
+template <typename T, typename I>
+template <typename V>
+void SparseMatrixCSR<T, I>::add_multiply_transpose_with_vector(const std::vector<V> &vec, std::vector<V> &result) const
+{
+    for (size_t r = 0; r < num_rows; ++r)
+    {
+        if (vec[r] == V(0))
+            continue;
+        for (I k = cbeg[r]; k < cbeg[r + 1]; ++k)
+            result[cind[k]] += static_cast<V>(cval[k]) * vec[r];
+    }
+}
+
+template <typename T, typename I>
+template <typename V>
+void SparseMatrixCSR<T, I>::add_multiply_transpose_with_vector(const SparseVector<V, I> &vec, std::vector<V> &result) const
+{
+    for (size_t i = 0; i < vec.nnz(); ++i)
+    {
+        size_t r = static_cast<size_t>(vec.index[i]);
+        if (r >= num_rows)
+            break;
+        for (I k = cbeg[r]; k < cbeg[r + 1]; ++k)
+            result[cind[k]] += static_cast<V>(cval[k]) * vec.value[i];
+    }
+}
+
+template <typename T, typename I>
+size_t SparseVector<T, I>::nnz() const
+{
+    return value.size();
+}
+
+template <typename T, typename I>
+double SparseVector<T, I>::density() const
+{
+    if (dim == 0)
+        return 0.0;
+    return static_cast<double>(value.size()) / static_cast<double>(dim);
+}
+
+template <typename T, typename I>
+SparseVector<T, I> SparseVector<T, I>::from_dense(const std::vector<T> &dense, T tolerance)
+{
+    SparseVector<T, I> vec;
+    vec.assign_dense(dense, tolerance);
+    return vec;
+}
+
+template <typename T, typename I>
+void SparseVector<T, I>::assign_dense(const std::vector<T> &dense, T tolerance)
+{
+    if (!fits_in_index<I>(dense.size()))
+        throw std::overflow_error("SparseVector::from_dense: vector too large for the index type");
+
+    dim = dense.size();
+    index.clear();
+    value.clear();
+    for (size_t i = 0; i < dense.size(); ++i)
+    {
+        if (std::abs(dense[i]) > tolerance)
+        {
+            index.push_back(static_cast<I>(i));
+            value.push_back(dense[i]);
+        }
+    }
+}
+
+template <typename T, typename I>
+std::vector<T> SparseVector<T, I>::to_dense() const
+{
+    std::vector<T> dense(dim, T(0));
+    for (size_t i = 0; i < value.size(); ++i)
+        dense[index[i]] = value[i];
+    return dense;
+}
+
+// Explicit template instantiation
+// value types: float, double; index types: int32_t, int64_t
+// vector types for the products: float, double
+#define INSTANTIATE_SPARSE_PRODUCTS(T, I, V) \
+    template void SparseMatrix<T, I>::multiply_with_vector<V>(const std::vector<V> &, std::vector<V> &) const; \
+    template void SparseMatrix<T, I>::multiply_transpose_with_vector<V>(const std::vector<V> &, std::vector<V> &) const; \
+    template void SparseMatrix<T, I>::subtract_multiply_with_vector<V>(const std::vector<V> &, std::vector<V> &) const; \
+    template void SparseMatrixCSR<T, I>::multiply_with_vector<V>(const std::vector<V> &, std::vector<V> &) const; \
+    template void SparseMatrixCSR<T, I>::multiply_transpose_with_vector<V>(const std::vector<V> &, std::vector<V> &) const; \
+    template void SparseMatrixCSR<T, I>::subtract_multiply_with_vector<V>(const std::vector<V> &, std::vector<V> &) const; \
+    template void SparseMatrixCSR<T, I>::multiply_transpose_with_vector<V>(const SparseVector<V, I> &, std::vector<V> &) const; \
+    template void SparseMatrixCSR<T, I>::add_multiply_transpose_with_vector<V>(const std::vector<V> &, std::vector<V> &) const; \
+    template void SparseMatrixCSR<T, I>::add_multiply_transpose_with_vector<V>(const SparseVector<V, I> &, std::vector<V> &) const;
+
+#define INSTANTIATE_SPARSE(T, I) \
+    template class SparseMatrix<T, I>; \
+    template class SparseMatrixCSR<T, I>; \
+    template struct SparseVector<T, I>; \
+    INSTANTIATE_SPARSE_PRODUCTS(T, I, float) \
+    INSTANTIATE_SPARSE_PRODUCTS(T, I, double)
+
+INSTANTIATE_SPARSE(double, int32_t)
+INSTANTIATE_SPARSE(float, int32_t)
+INSTANTIATE_SPARSE(double, int64_t)
+INSTANTIATE_SPARSE(float, int64_t)
@@ -1,241 +1,1304 @@
-// #include "two_stage.h"
-// #include "scs.h"
-// #include "utils.h"
-// #include <filesystem>
-// #include "gurobi_c.h"
-// #include <vector>
-// #include <random>
-
-// namespace fs = std::filesystem;
-
-// TwoStageSP::TwoStageSP(const std::string base_path, const std::string prob_name, int nworkers_):
-// nworkers(nworkers_),
-// cor((fs::path(base_path) / prob_name / (prob_name + ".cor")).string()),
-// tim((fs::path(base_path) / prob_name / (prob_name + ".tim")).string()),
-// sto((fs::path(base_path) / prob_name / (prob_name + ".sto")).string())
-// {
-//     // construct stage problems
-//     prob0 = std::make_unique<StageProblem>(cor, tim, sto, 0);
-//     prob0->attach_solver();
-
-//     // create a second stage problem, and copy it nworkers times
-//     StageProblem prob1_tmp(cor, tim, sto, 1);
-
-//     for (int i = 0; i < nworkers; ++i) {
-//         prob1.push_back(std::make_unique<StageProblem>(prob1_tmp));
-//         prob1[i]->attach_solver();
-//     }
-
-// }
-
-// TwoStageSCS::TwoStageSCS(const std::string base_path, const std::string prob_name, int nworkers_)
-//     : TwoStageSP(base_path, prob_name, nworkers_)
-// {
-//     // create a projection problem
-//     proj_prob0 = std::make_unique<StageProjectionProblem>(cor, tim, sto, 0);
-//     proj_prob0->attach_solver();   
-// }
-
-// void TwoStageSCS::solve()
-// {
-//     // set prob1 to single thread mode
-//     for (int i = 0; i < nworkers; ++i) {
-//         int error;
-//         error = GRBsetintparam(prob1[i]->get_env(), GRB_INT_PAR_THREADS, 1);
-//         check_solver_error(error, "Error setting threads parameter");
-//     }
-    
-//     // sample pool
-//     std::vector<std::vector<double>> samples;
-
-//     // random number generator
-//     std::mt19937 rng(0);
-
-//     // generate initial samples
-//     const int INITIAL_SAMPLES = 1000;
-//     for(int i = 0; i < INITIAL_SAMPLES; ++i) {
-//         samples.push_back(sto.generate_scenario(rng));
-//     }
-
-//     std::vector<double> x(prob0 -> nvars_current, 0.0);
-//     SCS scs;
-
-//     const int MAX_ITER = 1000;
-//     for (int iter = 0; iter <MAX_ITER; ++iter) 
-//     {
-//         // obtain some feasible first stage solution
-//         // by projecting the zero vector onto the feasible set
-//         auto proj_solution = proj_prob0->project(x);
-//         if (proj_solution.has_value())
-//         {
-//             for (size_t j = 0; j < x.size(); ++j)
-//                 x[j] += proj_solution.value()[j];
-//         }
-
-//         // print feasible solution
-//         // std::cout << "Feasible solution: " << vec_to_string(x) << '\n';
- 
-//         double obj_value = 0.0;
-//         std::vector<double> grad(prob0->nvars_current, 0.0);
-
-//         // solve all subproblems
-//         auto sol_pair = solve_subproblems(x, samples);
-//         auto &solutions = sol_pair.first;
-//         auto &cuts = sol_pair.second;
-
-//         // accumulate gradient  = -beta
-//         for (size_t i = 0; i < samples.size(); ++i)
-//             for (size_t j = 0; j < prob0->nvars_current; ++j)
-//                 grad[j] -= cuts[i].beta[j];
-
-//         // divide gradient by the number of samples
-//         for (size_t j = 0; j < prob0->nvars_current; ++j)
-//             grad[j] /= samples.size();
-
-//         // add first stage cost to gradient
-//         for (size_t j = 0; j < x.size(); ++j)
-//             grad[j] += prob0->cost_coefficients[j];
-
-//         // accumulate objective solution.obj_value
-//         for (size_t i = 0; i < samples.size(); ++i)
-//             obj_value += solutions[i].obj_value;
-        
-//         // divide objective by the number of samples
-//         obj_value /= samples.size();
-
-//         // add the first stage objective
-//         for (size_t j = 0; j < x.size(); ++j)
-//             obj_value += prob0->cost_coefficients[j] * x[j];
-    
-//         // print objective
-//         std::cout << "Objective value: " << obj_value << '\n';
-
-//         // print gradient
-//         // std::cout << "Gradient: " << vec_to_string(grad) << '\n';
-
-//         // gradient descent
-//         // x = x - grad * step_size
-//         // const double step_size = 0.01;
-//         // for (size_t j = 0; j < x.size(); ++j)
-//         //     x[j] -= grad[j] * step_size;
-
-//         scs.update(grad);
-//         std::vector<double> direction = scs.get_current_direction();
-
-//         // // constant step size
-//         // const double step_size = 0.2;
-
-//         // line search
-//         double step_size = 0.0;
-
-//         const double max_step_size = 10.0;
-
-//         double l = 0.0, r = max_step_size, m = (l + r) / 2.0;
-//         while (true)
-//         {
-//             double f_current = obj_value;
-//             // x - m * direction;
-//             std::vector<double> x_forward(x);
-//             for (size_t j = 0; j < x.size(); ++j)
-//                 x_forward[j] -= m * direction[j];
-            
-//             // project x_forward onto the feasible set
-//             auto proj_solution = proj_prob0->project(x_forward);
-//             if (proj_solution.has_value())
-//             {
-//                 for (size_t j = 0; j < x_forward.size(); ++j)
-//                     x_forward[j] += proj_solution.value()[j];
-//             }
-
-//             // solve all subproblems
-//             auto sol_pair = solve_subproblems(x_forward, samples);
-//             auto &solutions = sol_pair.first;
-//             auto &cuts = sol_pair.second;
-
-//             // get f_forward by averaging objective values
-//             double f_forward = 0.0;
-//             for (size_t i = 0; i < samples.size(); ++i)
-//                 f_forward += solutions[i].obj_value;
-//             f_forward /= samples.size();
-
-//             // add the first stage objective to f_forward
-//             for (size_t j = 0; j < x.size(); ++j)
-//                 f_forward += prob0->cost_coefficients[j] * x_forward[j];
-
-//             // dk_hat = (x_forward - x) / m
-//             std::vector<double> dk_hat(x.size());
-//             for (size_t j = 0; j < x.size(); ++j)
-//                 dk_hat[j] = (x_forward[j] - x[j]) / m;
-
-//             if (!scs.satisfy_L_condition(f_forward, f_current, m))
-//             {
-//                 // shrink the interval
-//                 r = m;
-//                 m = (l + r) / 2.0;
-//                 continue;
-//             }
-
-//             // accumulate gradient  = -beta
-//             std::vector<double> grad_forward(prob0->nvars_current, 0.0);
-//             for (size_t i = 0; i < samples.size(); ++i)
-//                 for (size_t j = 0; j < prob0->nvars_current; ++j)
-//                     grad_forward[j] -= cuts[i].beta[j];
-            
-//             // divide gradient by the number of samples
-//             for (size_t j = 0; j < prob0->nvars_current; ++j)
-//                 grad_forward[j] /= samples.size();
-
-//             // add first stage cost to gradient
-//             for (size_t j = 0; j < x.size(); ++j)
-//                 grad_forward[j] += prob0->cost_coefficients[j];
-
-//             if (!scs.satisfy_R_condition(grad_forward))
-//             {
-//                 // shrink the interval
-//                 l = m;
-//                 m = (l + r) / 2.0;
-//                 continue;
-//             }
-
-//             // satisfy both conditions
-//             step_size = m;
-//             break;
-//         }
-
-
-//         std::cout << "Line search Step size: " << step_size << '\n';
-
-//         // descent step
-//         for (size_t j = 0; j < x.size(); ++j)
-//             x[j] -= direction[j] * step_size;
-//     }
-// }
-
-// std::pair<
-//     std::vector<StageProblem::Solution>,
-//     std::vector<Cut> > TwoStageSCS::solve_subproblems(const std::vector<double> &x, const std::vector<std::vector<double>> &samples)
-// {
-
-//     std::vector<StageProblem::Solution> solutions(samples.size());
-//     std::vector<Cut> cuts(samples.size());
-
-//     #pragma omp parallel for
-//     for (size_t i = 0; i < samples.size(); ++i)
-//     {
-//         int thread_id = omp_get_thread_num();
-//         StageProblem &prob1_inst = *prob1[thread_id];
-
-//         prob1_inst.update_solver_with_scenario(x, samples[i]);
-//         // solve the problem, require_dual_solution = true
-//         solutions[i] = prob1_inst.solve_problem(true);
-
-//         // get the static part of the cut
-//         cuts[i] = CutHelper::get_static_part(prob1_inst, solutions[i].dual_solution);
-
-//         // add the dynamic part of the cut
-//         CutHelper::add_dynamic_part(prob1_inst, solutions[i].dual_solution, samples[i], cuts[i]);
-
-//     }
-    
-//     return std::make_pair(solutions, cuts);
-// }
+#include "two_stage.h"
+#include "kernels.h"
+#include "utils.h"
+#include "scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <filesystem>
+#include <limits>
+#include "gurobi_c.h"
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // seconds since start
+    double elapsed(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+}
+
+TwoStageSP::TwoStageSP(const std::string &base_path, const std::string &prob_name, int nworkers_, Solvers solvers):
+nworkers(nworkers_),
+cor((fs::path(base_path) / prob_name / (prob_name + ".cor")).string()),
+tim((fs::path(base_path) / prob_name / (prob_name + ".tim")).string()),
+sto((fs::path(base_path) / prob_name / (prob_name + ".sto")).string())
+{
+    if (nworkers <= 0)
+        throw std::runtime_error("TwoStageSP::TwoStageSP: at least one worker is needed.");
+
+    // create a second stage problem, and copy it nworkers times
+    StageProblem prob1_tmp(cor, tim, sto, 1);
+    if (solvers == Solvers::MASTER)
+    {
+        prob1.push_back(std::make_unique<StageProblem>(prob1_tmp));
+        return;
+    }
+
+    for (int i = 0; i < nworkers; ++i) {
+        prob1.push_back(std::make_unique<StageProblem>(prob1_tmp));
+        prob1[i]->attach_solver();
+
+        // the workers run in parallel, so each solver gets one thread
+        int error = GRBsetintparam(GRBgetenv(prob1[i]->get_model()), GRB_INT_PAR_THREADS, 1);
+        check_solver_error(error, "Error setting threads parameter");
+    }
+}
+
+std::vector<double> TwoStageSP::second_stage_omega(const std::vector<double> &scenario) const
+{
+    std::vector<double> omega;
+    stage_omega(prob1.front()->stage_stoc_pattern, scenario, omega);
+    return omega;
+}
+
+TwoStageRegularizedSP::TwoStageRegularizedSP(const std::string &base_path, const std::string &prob_name,
+                                             int nworkers_, const SDOptions &options_, size_t n_epigraph,
+                                             Solvers solvers)
+    : TwoStageSP(base_path, prob_name, nworkers_, solvers), options(options_),
+      iteration(0), sigma(options_.sigma), incumbent_estimate(0.0),
+      base_path(base_path), prob_name(prob_name), last_gap(std::numeric_limits<double>::infinity())
+{
+    if (options.incumbent_ratio <= 0.0 || options.incumbent_ratio >= 1.0)
+        throw std::runtime_error("TwoStageRegularizedSP::TwoStageRegularizedSP: the incumbent ratio must be in (0, 1).");
+    if (options.min_sigma <= 0.0 || options.min_sigma > options.sigma || options.sigma > options.max_sigma)
+        throw std::runtime_error("TwoStageRegularizedSP::TwoStageRegularizedSP: sigma must satisfy 0 < min_sigma <= sigma <= max_sigma.");
+
+    master = std::make_unique<StageMasterProblem>(cor, tim, sto, n_epigraph);
+    if (master->nvars_current != prob1.front()->nvars_last)
+        throw std::runtime_error("TwoStageRegularizedSP::TwoStageRegularizedSP: first stage dimension does not match the second stage.");
+    proj_prob0 = std::make_unique<StageProjectionProblem>(cor, tim, sto, 0);
+
+    if (solvers != Solvers::WORKERS)
+    {
+        master->attach_solver();
+        proj_prob0->attach_solver();
+    }
+}
+
+const std::vector<double> &TwoStageRegularizedSP::get_incumbent() const
+{
+    return incumbent;
+}
+
+double TwoStageRegularizedSP::get_incumbent_estimate() const
+{
+    return incumbent_estimate;
+}
+
+uint64_t TwoStageRegularizedSP::get_iterations() const
+{
+    return iteration;
+}
+
+Validator::Estimate TwoStageRegularizedSP::get_validation() const
+{
+    return validator ? validator->get_estimate() : Validator::Estimate();
+}
+
+double TwoStageRegularizedSP::get_validation_gap() const
+{
+    return last_gap;
+}
+
+void TwoStageRegularizedSP::start()
+{
+    if (iteration > 0)
+        throw std::runtime_error("TwoStageRegularizedSP::start: solve can only be called once.");
+
+    candidate.assign(master->nvars_current, 0.0);
+    auto proj_solution = proj_prob0->project(candidate);
+    if (proj_solution.has_value())
+    {
+        for (size_t j = 0; j < candidate.size(); ++j)
+            candidate[j] += proj_solution.value()[j];
+    }
+    incumbent = candidate;
+    sigma = options.sigma;
+}
+
+void TwoStageRegularizedSP::update_sigma(bool accepted)
+{
+    if (accepted)
+        sigma = std::max(sigma / 2.0, options.min_sigma);
+    else
+        sigma = std::min(sigma * 2.0, options.max_sigma);
+}
+
+std::vector<double> TwoStageRegularizedSP::solve_master()
+{
+    // sigma / 2 ||d||^2 in the d-space around the incumbent: x = incumbent + d
+    master->remove_quadratic_term();
+    master->add_quadratic_term(sigma / 2.0);
+    master->set_x_base(incumbent);
+    auto sol = master->solve_master();
+    std::vector<double> x(incumbent);
+    for (size_t j = 0; j < x.size(); ++j)
+        x[j] += sol.solution[j];
+    return x;
+}
+
+std::vector<StageProblem *> TwoStageRegularizedSP::worker_group(size_t first, size_t count) const
+{
+    std::vector<StageProblem *> group;
+    for (size_t i = first; i < first + count; ++i)
+        group.push_back(prob1.at(i).get());
+    return group;
+}
+
+void TwoStageRegularizedSP::start_validation()
+{
+    if (options.validation_gap <= 0.0)
+        return;
+    if (!validator)
+        validator = std::make_unique<Validator>(base_path, prob_name, options.validation_threads, options.validation);
+    validator->set_point(incumbent);
+    validator->start();
+}
+
+double TwoStageRegularizedSP::model_lower_bound()
+{
+    // the same d-space as solve_master, so the rows are not shifted again;
+    // the objective value includes c x_base
+    master->remove_quadratic_term();
+    master->set_x_base(incumbent);
+    return master->solve_master().obj_value;
+}
+
+bool TwoStageRegularizedSP::validated()
+{
+    if (!validator)
+        return false;
+    validator->set_point(incumbent);
+    Validator::Estimate estimate = validator->get_estimate();
+    if (estimate.point_version == 0 || estimate.count < options.validation.min_samples)
+    {
+        last_gap = std::numeric_limits<double>::infinity();
+        return false;
+    }
+    last_gap = validator->pessimistic_gap(model_lower_bound());
+    return last_gap <= options.validation_gap;
+}
+
+void TwoStageRegularizedSP::stop_validation()
+{
+    if (validator)
+        validator->stop();
+}
+
+TwoStageSD::TwoStageSD(const std::string &base_path, const std::string &prob_name, int nworkers_,
+                       const Options &options_)
+    : TwoStageRegularizedSP(base_path, prob_name, nworkers_, options_, 1),
+      approximation(worker_group(0, static_cast<size_t>(nworkers_)), options_.max_duals, options_.eviction_policy),
+      rng(options_.seed)
+{
+    if (options.samples_per_iteration == 0)
+        options.samples_per_iteration = static_cast<size_t>(nworkers);
+}
+
+size_t TwoStageSD::get_num_samples() const
+{
+    return approximation.num_samples();
+}
+
+const TwoStageSD::Timing &TwoStageSD::get_timing() const
+{
+    return timing;
+}
+
+double TwoStageSD::evaluate(const std::vector<double> &x, uint64_t k) const
+{
+    std::vector<double> values;
+    evaluate(x, k, values);
+    return values[0];
+}
+
+void TwoStageSD::evaluate(const std::vector<double> &points, uint64_t k, std::vector<double> &values) const
+{
+    // the pool holds the cuts of theta - L, and theta >= L in the master
+    const size_t n = master->nvars_current;
+    std::vector<size_t> indices;
+    master->get_cut_pool().max_values(points, k, values, indices);
+    for (size_t p = 0; p < values.size(); ++p)
+        values[p] = kernels::dot(master->cost_coefficients.data(), &points[p * n], n) +
+                    master->get_epigraph_lower_bound() + std::max(values[p], 0.0);
+}
+
+void TwoStageSD::solve()
+{
+    const auto start_time = Clock::now();
+    timing = Timing();
+    start();
+    start_validation();
+
+    // f_{k-1}(candidate) - f_{k-1}(incumbent), as predicted by the last master
+    double predicted_decrease = 0.0;
+
+    for (uint64_t k = 1; k <= options.max_iterations; ++k)
+    {
+        iteration = k;
+        const bool distinct = candidate != incumbent;
+
+        // new samples
+        auto phase_start = Clock::now();
+        std::vector<std::vector<double>> samples(options.samples_per_iteration);
+        for (auto &omega : samples)
+            omega = second_stage_omega(sto.generate_scenario(rng));
+        timing.sampling += elapsed(phase_start);
+
+        // second stage LPs of the new samples, at the candidate and the incumbent
+        phase_start = Clock::now();
+        std::vector<const std::vector<double> *> points{&candidate};
+        if (distinct)
+            points.push_back(&incumbent);
+        approximation.add_samples(samples, points);
+        timing.subproblems += elapsed(phase_start);
+
+        // SD cuts over all samples from the stored duals
+        phase_start = Clock::now();
+        master->set_iteration(k);
+        master->add_cut(approximation.cut_at(candidate, k), k);
+        if (distinct)
+            master->add_cut(approximation.cut_at(incumbent, k), k);
+        timing.argmax += elapsed(phase_start);
+
+        // incumbent test on the updated approximation, both points in one batch
+        phase_start = Clock::now();
+        bool accepted = false;
+        if (distinct)
+        {
+            std::vector<double> points(candidate), values;
+            points.insert(points.end(), incumbent.begin(), incumbent.end());
+            evaluate(points, k, values);
+            accepted = values[0] - values[1] < options.incumbent_ratio * predicted_decrease;
+            if (accepted)
+                incumbent = candidate;
+            update_sigma(accepted);
+            incumbent_estimate = values[accepted ? 0 : 1];
+        }
+        else
+            incumbent_estimate = evaluate(incumbent, k);
+        timing.incumbent += elapsed(phase_start);
+
+        // regularized master for the next candidate
+        phase_start = Clock::now();
+        master->remove_inactive_cuts(options.max_inactive);
+        candidate = solve_master();
+        predicted_decrease = evaluate(candidate, k) - incumbent_estimate;
+        timing.master += elapsed(phase_start);
+
+        bool valid = validated();
+
+        if (options.verbose)
+        {
+            std::cout << "Iteration " << k << ": samples " << approximation.num_samples()
+                      << ", duals " << approximation.num_duals() << ", cuts " << master->get_cut_pool().size()
+                      << ", incumbent estimate " << incumbent_estimate
+                      << ", predicted decrease " << predicted_decrease
+                      << ", sigma " << sigma << (accepted ? ", new incumbent" : "");
+            if (options.validation_gap > 0.0)
+                std::cout << ", validation gap " << get_validation_gap();
+            std::cout << '\n';
+        }
+
+        if (k >= options.min_iterations &&
+            (valid || -predicted_decrease <= options.tolerance * (1.0 + std::abs(incumbent_estimate))))
+            break;
+    }
+
+    stop_validation();
+    timing.total = elapsed(start_time);
+}
+
+TwoStageIndependentSP::TwoStageIndependentSP(const std::string &base_path, const std::string &prob_name,
+                                             int nworkers_, const IndependentSDOptions &options_, size_t napprox_,
+                                             Solvers solvers)
+    : TwoStageRegularizedSP(base_path, prob_name, nworkers_, options_, std::max<size_t>(napprox_, 1), solvers),
+      napprox(napprox_), max_sample_count(options_.max_sample_count), snapshots(napprox_), new_snapshot(false)
+{
+    if (napprox == 0)
+        throw std::runtime_error("TwoStageIndependentSP::TwoStageIndependentSP: at least one approximation is needed.");
+    if (max_sample_count == 0)
+        throw std::runtime_error("TwoStageIndependentSP::TwoStageIndependentSP: max_sample_count must be positive.");
+}
+
+std::vector<uint64_t> TwoStageIndependentSP::get_sample_counts() const
+{
+    std::vector<uint64_t> counts;
+    for (const auto &snapshot : snapshots)
+        counts.push_back(snapshot.sample_count);
+    return counts;
+}
+
+const TwoStageIndependentSP::Timing &TwoStageIndependentSP::get_timing() const
+{
+    return timing;
+}
+
+size_t TwoStageIndependentSP::master_state_size() const
+{
+    return 1 + 2 * master->nvars_current;
+}
+
+void TwoStageIndependentSP::pack_master_state(uint64_t timestamp, std::vector<double> &state) const
+{
+    state.clear();
+    state.reserve(master_state_size());
+    state.push_back(static_cast<double>(timestamp));
+    state.insert(state.end(), candidate.begin(), candidate.end());
+    state.insert(state.end(), incumbent.begin(), incumbent.end());
+}
+
+void TwoStageIndependentSP::set_snapshot(size_t j, ApproximationSnapshot snapshot)
+{
+    master->remove_epigraph_cuts(j);
+    for (const Cut &cut : snapshot.cuts)
+        master->add_cut(cut, 1, j);
+    snapshots[j] = std::move(snapshot);
+    new_snapshot = true;
+}
+
+bool TwoStageIndependentSP::ready(uint64_t timestamp) const
+{
+    if (!new_snapshot)
+        return false;
+    // bounded staleness: timestamp 0 is no snapshot yet
+    for (const auto &snapshot : snapshots)
+        if (snapshot.timestamp == 0 || snapshot.timestamp + max_sample_count < timestamp)
+            return false;
+    return true;
+}
+
+double TwoStageIndependentSP::evaluate(const std::vector<double> &x, const std::vector<double> &weights) const
+{
+    double value = kernels::dot(master->cost_coefficients.data(), x.data(), x.size());
+    for (size_t j = 0; j < napprox; ++j)
+        if (weights[j] > 0.0)
+            value += weights[j] * snapshots[j].value(x);
+    return value;
+}
+
+bool TwoStageIndependentSP::update(double &predicted_decrease)
+{
+    ++iteration;
+    new_snapshot = false;
+
+    // alpha_j proportional to the samples behind Q_j
+    uint64_t total_samples = 0;
+    for (const auto &snapshot : snapshots)
+        total_samples += snapshot.sample_count;
+    std::vector<double> weights(napprox);
+    for (size_t j = 0; j < napprox; ++j)
+        weights[j] = static_cast<double>(snapshots[j].sample_count) / static_cast<double>(total_samples);
+    master->set_epigraph_weights(weights);
+
+    // incumbent test on the combined approximation
+    auto phase_start = Clock::now();
+    bool accepted = false;
+    if (candidate != incumbent)
+    {
+        double actual_decrease = evaluate(candidate, weights) - evaluate(incumbent, weights);
+        accepted = actual_decrease < options.incumbent_ratio * predicted_decrease;
+        if (accepted)
+            incumbent = candidate;
+        update_sigma(accepted);
+    }
+    incumbent_estimate = evaluate(incumbent, weights);
+    timing.incumbent += elapsed(phase_start);
+
+    phase_start = Clock::now();
+    candidate = solve_master();
+    predicted_decrease = evaluate(candidate, weights) - incumbent_estimate;
+    timing.master += elapsed(phase_start);
+
+    bool valid = validated();
+
+    if (options.verbose)
+    {
+        std::cout << "Iteration " << iteration << ": samples " << total_samples
+                  << ", cuts " << master->get_cut_pool().size()
+                  << ", incumbent estimate " << incumbent_estimate
+                  << ", predicted decrease " << predicted_decrease
+                  << ", sigma " << sigma << (accepted ? ", new incumbent" : "");
+        if (options.validation_gap > 0.0)
+            std::cout << ", validation gap " << get_validation_gap();
+        std::cout << '\n';
+    }
+
+    return iteration >= options.min_iterations &&
+           (valid || -predicted_decrease <= options.tolerance * (1.0 + std::abs(incumbent_estimate)));
+}
+
+TwoStageIndependentSD::TwoStageIndependentSD(const std::string &base_path, const std::string &prob_name,
+                                             int nworkers_, const Options &options_)
+    : TwoStageIndependentSP(base_path, prob_name, nworkers_, options_, options_.napprox),
+      snapshot_versions(options_.napprox, 0), master_window(master_state_size()), stop(false),
+      snapshots_published(0), published_timestamp(0), worker_errors(options_.napprox)
+{
+    if (static_cast<size_t>(nworkers) < napprox)
+        throw std::runtime_error("TwoStageIndependentSD::TwoStageIndependentSD: need napprox <= nworkers.");
+    if (options.samples_per_iteration == 0)
+        options.samples_per_iteration = static_cast<size_t>(nworkers) / napprox;
+
+    const size_t dim = master->nvars_current;
+    const size_t max_cuts = SDApproximation::max_cuts(options.max_inactive);
+    const size_t group = static_cast<size_t>(nworkers) / napprox;
+    for (size_t j = 0; j < napprox; ++j)
+    {
+        approximations.push_back(std::make_unique<SDApproximation>(worker_group(j * group, group),
+                                                                   options.max_duals, options.eviction_policy));
+        cut_windows.push_back(std::make_unique<SeqlockWindow>(ApproximationSnapshot::packed_size(max_cuts, dim)));
+    }
+}
+
+void TwoStageIndependentSD::halt()
+{
+    {
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        stop.store(true, std::memory_order_release);
+    }
+    progress.notify_all();
+}
+
+void TwoStageIndependentSD::run_worker(size_t j)
+{
+    const size_t dim = master->nvars_current;
+    SDApproximation &approx = *approximations[j];
+    // a different stream for every approximation
+    std::mt19937 rng(options.seed + 1 + static_cast<unsigned int>(j));
+
+    uint64_t timestamp = 0, steps = 0;
+    std::vector<double> state, x_candidate, x_incumbent, packed;
+
+    while (!stop.load(std::memory_order_acquire))
+    {
+        master_window.read(state);
+        uint64_t master_timestamp = static_cast<uint64_t>(state[0]);
+        if (master_timestamp != timestamp)
+        {
+            timestamp = master_timestamp;
+            steps = 0;
+            x_candidate.assign(state.begin() + 1, state.begin() + 1 + dim);
+            x_incumbent.assign(state.begin() + 1 + dim, state.end());
+        }
+
+        // bounded staleness: wait for the master after max_sample_count steps
+        if (steps >= max_sample_count)
+        {
+            std::unique_lock<std::mutex> lock(progress_mutex);
+            progress.wait(lock, [&]()
+            {
+                return published_timestamp != timestamp || stop.load(std::memory_order_acquire);
+            });
+            continue;
+        }
+        ++steps;
+
+        // sto is shared by all workers
+        std::vector<std::vector<double>> samples(options.samples_per_iteration);
+        {
+            std::lock_guard<std::mutex> lock(sampling_mutex);
+            for (auto &omega : samples)
+                omega = second_stage_omega(sto.generate_scenario(rng));
+        }
+
+        approx.step(samples, x_candidate, x_incumbent, options.max_inactive);
+        approx.snapshot(timestamp).pack(dim, packed);
+        cut_windows[j]->publish(packed);
+        {
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            ++snapshots_published;
+        }
+        progress.notify_all();
+    }
+}
+
+void TwoStageIndependentSD::solve()
+{
+    const auto start_time = Clock::now();
+    timing = Timing();
+    start();
+    start_validation();
+
+    uint64_t timestamp = 1;
+    std::vector<double> state;
+    pack_master_state(timestamp, state);
+    master_window.publish(state);
+    snapshots_published = 0;
+    published_timestamp = timestamp;
+
+    stop.store(false, std::memory_order_release);
+    std::vector<std::thread> workers;
+    for (size_t j = 0; j < napprox; ++j)
+        workers.emplace_back([this, j]()
+        {
+            try
+            {
+                run_worker(j);
+            }
+            catch (...)
+            {
+                worker_errors[j] = std::current_exception();
+                halt();
+            }
+        });
+
+    try
+    {
+        const size_t dim = master->nvars_current;
+        std::vector<double> packed;
+        double predicted_decrease = 0.0;
+
+        while (iteration < options.max_iterations && !stop.load(std::memory_order_acquire))
+        {
+            // a publish after this count wakes the wait below
+            uint64_t seen;
+            {
+                std::lock_guard<std::mutex> lock(progress_mutex);
+                seen = snapshots_published;
+            }
+
+            // replace the cuts of every approximation with a newer snapshot
+            auto phase_start = Clock::now();
+            for (size_t j = 0; j < napprox; ++j)
+            {
+                if (cut_windows[j]->version() == snapshot_versions[j])
+                    continue;
+                snapshot_versions[j] = cut_windows[j]->read(packed);
+                set_snapshot(j, ApproximationSnapshot::unpack(packed, dim));
+            }
+            timing.read += elapsed(phase_start);
+
+            if (!ready(timestamp))
+            {
+                phase_start = Clock::now();
+                std::unique_lock<std::mutex> lock(progress_mutex);
+                progress.wait(lock, [&]()
+                {
+                    return snapshots_published != seen || stop.load(std::memory_order_acquire);
+                });
+                timing.wait += elapsed(phase_start);
+                continue;
+            }
+
+            bool converged = update(predicted_decrease);
+            pack_master_state(++timestamp, state);
+            master_window.publish(state);
+            {
+                std::lock_guard<std::mutex> lock(progress_mutex);
+                published_timestamp = timestamp;
+            }
+            progress.notify_all();
+            if (converged)
+                break;
+        }
+    }
+    catch (...)
+    {
+        halt();
+        for (auto &worker : workers)
+            worker.join();
+        throw;
+    }
+
+    halt();
+    for (auto &worker : workers)
+        worker.join();
+    for (auto &error : worker_errors)
+        if (error)
+            std::rethrow_exception(error);
+    stop_validation();
+
+    timing.total = elapsed(start_time);
+}
+
+TwoStageSCS::TwoStageSCS(const std::string &base_path, const std::string &prob_name, int nworkers_,
+                         const Options &options_)
+    : TwoStageSP(base_path, prob_name, nworkers_), options(options_),
+      rng(options_.seed), objective(0.0), iteration(0)
+{
+    if (options.num_samples == 0)
+        throw std::runtime_error("TwoStageSCS::TwoStageSCS: at least one sample is needed.");
+    if (options.max_samples > options.num_samples && (options.theta <= 0.0 || options.max_growth <= 1.0))
+        throw std::runtime_error("TwoStageSCS::TwoStageSCS: adaptive sampling needs theta > 0 and max_growth > 1.");
+    if (options.speculation_depth < 1 || options.speculation_depth > 6)
+        throw std::runtime_error("TwoStageSCS::TwoStageSCS: speculation_depth must be in [1, 6].");
+    if (options.max_line_search < 1)
+        throw std::runtime_error("TwoStageSCS::TwoStageSCS: max_line_search must be positive.");
+
+    // create a projection problem
+    proj_prob0 = std::make_unique<StageProjectionProblem>(cor, tim, sto, 0);
+    proj_prob0->attach_solver();
+    if (proj_prob0->nvars_current != prob1.front()->nvars_last)
+        throw std::runtime_error("TwoStageSCS::TwoStageSCS: first stage dimension does not match the second stage.");
+
+    // one set of accumulators per point of a speculative round
+    const size_t n = proj_prob0->nvars_current;
+    const size_t max_points = (size_t(1) << options.speculation_depth) - 1;
+    accumulators.resize(max_points * static_cast<size_t>(nworkers));
+    for (auto &acc : accumulators)
+    {
+        acc.cut.beta.assign(n, 0.0);
+        if (options.max_samples > options.num_samples)
+            acc.beta_sq.assign(n, 0.0);
+    }
+
+    workspaces.resize(static_cast<size_t>(nworkers));
+    for (auto &ws : workspaces)
+        ws.cut.beta.assign(n, 0.0);
+
+    add_samples(options.num_samples);
+}
+
+size_t TwoStageSCS::get_num_samples() const
+{
+    return samples.size();
+}
+
+void TwoStageSCS::add_samples(size_t count)
+{
+    // the cache entries of the samples already drawn stay valid
+    for (size_t i = 0; i < count; ++i)
+        samples.push_back(second_stage_omega(sto.generate_scenario(rng)));
+    if (options.reuse_solutions)
+        cache.resize(samples.size());
+}
+
+size_t TwoStageSCS::next_sample_size(const SampleVariance &variance, const std::vector<double> &grad,
+                                     double decrease) const
+{
+    const double nsamples = static_cast<double>(samples.size());
+    const double theta_sq = options.theta * options.theta;
+    const double gg = kernels::dot(grad.data(), grad.data(), grad.size());
+
+    // the smallest N for which each test holds; a zero gradient fails at any N
+    double target = nsamples;
+    if (options.sample_test == SCSOptions::SampleTest::NORM)
+        target = std::max(target, variance.gradient / (theta_sq * gg));
+    else if (reference.size() == grad.size())
+    {
+        // g' v is the mean of the g_i' v, so both sides are along v
+        const double gv = kernels::dot(grad.data(), reference.data(), grad.size());
+        target = std::max(target, variance.inner / (theta_sq * gv * gv));
+    }
+    if (options.objective_ratio > 0.0 && decrease > 0.0)
+        target = std::max(target, variance.objective / std::pow(options.objective_ratio * decrease, 2));
+
+    target = std::min({target, nsamples * options.max_growth, static_cast<double>(options.max_samples)});
+    return std::max(samples.size(), static_cast<size_t>(std::ceil(target)));
+}
+
+const TwoStageSCS::SweepStats &TwoStageSCS::get_sweep_stats() const
+{
+    return sweep_stats;
+}
+
+bool TwoStageSCS::basis_holds(const SolutionCache &entry, const std::vector<double> &omega,
+                              const std::vector<double> &point, Workspace &ws) const
+{
+    // the change of the rhs, -T(omega) dx, as in update_solver_with_scenario
+    const StageProblem &prob = *prob1.front();
+    ws.dx.resize(point.size());
+    for (size_t j = 0; j < point.size(); ++j)
+        ws.dx[j] = point[j] - entry.x[j];
+    prob.transfer_block_csr->multiply_with_vector(ws.dx, ws.drhs);
+    const StageStochasticPattern &pattern = prob.stage_stoc_pattern;
+    for (size_t k = 0; k < pattern.rv_count; ++k)
+        if (pattern.col_index[k] >= 0)
+            ws.drhs[pattern.row_index[k]] += (omega[k] - pattern.reference_values[k]) * ws.dx[pattern.col_index[k]];
+
+    // 100% rule, with a margin for the tolerances of the ranging
+    double used = 0.0;
+    for (size_t r = 0; r < ws.drhs.size(); ++r)
+    {
+        double d = -ws.drhs[r];
+        if (d > 0.0)
+            used += d / entry.room_up[r];
+        else if (d < 0.0)
+            used -= d / entry.room_down[r];
+        if (used > 1.0 - 1e-6)
+            return false;
+    }
+    return true;
+}
+
+const std::vector<double> &TwoStageSCS::get_solution() const
+{
+    return x;
+}
+
+double TwoStageSCS::get_objective() const
+{
+    return objective;
+}
+
+uint64_t TwoStageSCS::get_iterations() const
+{
+    return iteration;
+}
+
+void TwoStageSCS::project(std::vector<double> &x_proj)
+{
+    auto proj_solution = proj_prob0->project(x_proj);
+    if (proj_solution.has_value())
+    {
+        for (size_t j = 0; j < x_proj.size(); ++j)
+            x_proj[j] += proj_solution.value()[j];
+    }
+}
+
+double TwoStageSCS::evaluate(const std::vector<double> &x_eval, std::vector<double> &grad)
+{
+    // a batch of one point
+    std::vector<std::vector<double>> grads(1);
+    grads[0].swap(grad);
+    std::vector<double> values;
+    evaluate({&x_eval}, values, grads);
+    grad.swap(grads[0]);
+    return values[0];
+}
+
+void TwoStageSCS::evaluate(const std::vector<const std::vector<double> *> &points, std::vector<double> &values,
+                           std::vector<std::vector<double>> &grads)
+{
+    const size_t npoints = points.size(), nthreads = static_cast<size_t>(nworkers);
+    const size_t n = proj_prob0->nvars_current;
+    if (npoints * nthreads > accumulators.size())
+        throw std::runtime_error("TwoStageSCS::evaluate: more points than accumulators.");
+    const bool adaptive = options.max_samples > options.num_samples;
+    const bool inner_test = adaptive && reference.size() == n;
+
+    for (size_t a = 0; a < npoints * nthreads; ++a)
+    {
+        Accumulator &acc = accumulators[a];
+        acc.objective = 0.0;
+        acc.cut.alpha = 0.0;
+        std::fill(acc.cut.beta.begin(), acc.cut.beta.end(), 0.0);
+        acc.objective_sq = acc.inner = acc.inner_sq = 0.0;
+        std::fill(acc.beta_sq.begin(), acc.beta_sq.end(), 0.0);
+    }
+
+    // the value and the cut of one sample at one point
+    auto add_sample = [&](Accumulator &acc, double value, const Cut &cut)
+    {
+        acc.objective += value;
+        acc.cut.alpha += cut.alpha;
+        for (size_t j = 0; j < n; ++j)
+            acc.cut.beta[j] += cut.beta[j];
+        if (!adaptive)
+            return;
+        acc.objective_sq += value * value;
+        for (size_t j = 0; j < n; ++j)
+            acc.beta_sq[j] += cut.beta[j] * cut.beta[j];
+        if (inner_test)
+        {
+            double inner = kernels::dot(cut.beta.data(), reference.data(), n);
+            acc.inner += inner;
+            acc.inner_sq += inner * inner;
+        }
+    };
+
+    // task i is sample i at every point, so one thread owns its cache entry
+    const size_t nsamples = samples.size();
+    parallel_sweep(nworkers, nsamples, [&](int thread_id, size_t i)
+    {
+        StageProblem &prob1_inst = *prob1[thread_id];
+        Workspace &ws = workspaces[thread_id];
+        for (size_t p = 0; p < npoints; ++p)
+        {
+            Accumulator &acc = accumulators[p * nthreads + thread_id];
+
+            const std::vector<double> &point = *points[p];
+            if (options.reuse_solutions && cache[i].valid && basis_holds(cache[i], samples[i], point, ws))
+            {
+                // the dual of the cached basis is optimal, so its cut is exact at the point
+                const Cut &cut = cache[i].cut;
+                add_sample(acc, CutHelper::evaluate(cut, point), cut);
+                ++ws.stats.reuses;
+                continue;
+            }
+
+            prob1_inst.update_solver_with_scenario(point, samples[i]);
+            prob1_inst.solve_problem(ws.solution, true, true);
+            const StageProblem::Solution &solution = ws.solution;
+            ++ws.stats.solves;
+            if (!options.reuse_solutions)
+            {
+                ws.cut.alpha = 0.0;
+                std::fill(ws.cut.beta.begin(), ws.cut.beta.end(), 0.0);
+                CutHelper::add_cut(prob1_inst, solution, samples[i], ws.cut);
+                add_sample(acc, solution.obj_value, ws.cut);
+                continue;
+            }
+
+            SolutionCache &entry = cache[i];
+            entry.valid = false;
+            entry.x = point;
+            entry.cut.alpha = 0.0;
+            entry.cut.beta.assign(n, 0.0);
+            CutHelper::add_cut(prob1_inst, solution, samples[i], entry.cut);
+            add_sample(acc, solution.obj_value, entry.cut);
+            prob1_inst.get_rhs_ranging(ws.rhs, ws.low, ws.up);
+            entry.room_up.resize(ws.rhs.size());
+            entry.room_down.resize(ws.rhs.size());
+            for (size_t r = 0; r < ws.rhs.size(); ++r)
+            {
+                entry.room_up[r] = ws.up[r] - ws.rhs[r];
+                entry.room_down[r] = ws.rhs[r] - ws.low[r];
+            }
+            entry.valid = true;
+        }
+    });
+
+    for (auto &ws : workspaces)
+    {
+        sweep_stats.solves += ws.stats.solves;
+        sweep_stats.reuses += ws.stats.reuses;
+        ws.stats = SweepStats();
+    }
+
+    // the gradient of h(x, omega) is -beta
+    const double inv_n = 1.0 / static_cast<double>(nsamples);
+    const auto &cost = proj_prob0->cost_coefficients;
+    values.resize(npoints);
+    grads.resize(npoints);
+    variances.assign(npoints, SampleVariance());
+    for (size_t p = 0; p < npoints; ++p)
+    {
+        // pairwise tree over the threads, the total ends up in the first accumulator
+        Accumulator *acc = &accumulators[p * nthreads];
+        for (size_t stride = 1; stride < nthreads; stride *= 2)
+            for (size_t t = 0; t + stride < nthreads; t += 2 * stride)
+            {
+                acc[t].objective += acc[t + stride].objective;
+                acc[t].cut.alpha += acc[t + stride].cut.alpha;
+                for (size_t j = 0; j < n; ++j)
+                    acc[t].cut.beta[j] += acc[t + stride].cut.beta[j];
+                if (!adaptive)
+                    continue;
+                acc[t].objective_sq += acc[t + stride].objective_sq;
+                for (size_t j = 0; j < n; ++j)
+                    acc[t].beta_sq[j] += acc[t + stride].beta_sq[j];
+                acc[t].inner += acc[t + stride].inner;
+                acc[t].inner_sq += acc[t + stride].inner_sq;
+            }
+
+        grads[p].resize(n);
+        for (size_t j = 0; j < n; ++j)
+            grads[p][j] = cost[j] - acc[0].cut.beta[j] * inv_n;
+        values[p] = kernels::dot(cost.data(), points[p]->data(), n) + acc[0].objective * inv_n;
+
+        // unbiased variances from the sums and the sums of squares; the
+        // subgradients c - beta_i vary as the beta_i do
+        if (adaptive && nsamples > 1)
+        {
+            const double scale = 1.0 / static_cast<double>(nsamples - 1);
+            auto variance = [&](double sum, double sum_sq)
+            {
+                return std::max((sum_sq - sum * sum * inv_n) * scale, 0.0);
+            };
+            SampleVariance &var = variances[p];
+            var.objective = variance(acc[0].objective, acc[0].objective_sq);
+            for (size_t j = 0; j < n; ++j)
+                var.gradient += variance(acc[0].cut.beta[j], acc[0].beta_sq[j]);
+            var.inner = variance(acc[0].inner, acc[0].inner_sq);
+        }
+    }
+}
+
+double TwoStageSCS::line_search(const UnconstrainedSCS &scs, const std::vector<double> &direction,
+                                std::vector<double> &x_forward, double &f_forward, std::vector<double> &grad_forward,
+                                SampleVariance &variance_forward)
+{
+    std::vector<double> steps, values, lower, upper;
+    std::vector<std::vector<double>> points, grads;
+    std::vector<const std::vector<double> *> point_ptrs;
+
+    // bisection on [l, r] until both the L and the R condition hold;
+    // the last point tried is taken if the search runs out
+    double l = 0.0, r = options.max_step, step = r / 2.0;
+    int remaining = options.max_line_search;
+    while (remaining > 0)
+    {
+        // the midpoints of the next levels in heap order: node k has interval
+        // [lower, upper], its left child follows a failed L condition (r = m)
+        // and its right child a failed R condition (l = m)
+        const int levels = std::min(options.speculation_depth, remaining);
+        const size_t nnodes = (size_t(1) << levels) - 1;
+        steps.resize(nnodes);
+        lower.resize(nnodes);
+        upper.resize(nnodes);
+        lower[0] = l;
+        upper[0] = r;
+        for (size_t k = 0; k < nnodes; ++k)
+        {
+            steps[k] = (lower[k] + upper[k]) / 2.0;
+            if (2 * k + 2 < nnodes)
+            {
+                lower[2 * k + 1] = lower[k];
+                upper[2 * k + 1] = steps[k];
+                lower[2 * k + 2] = steps[k];
+                upper[2 * k + 2] = upper[k];
+            }
+        }
+
+        points.resize(nnodes);
+        for (size_t k = 0; k < nnodes; ++k)
+        {
+            points[k] = x;
+            for (size_t j = 0; j < x.size(); ++j)
+                points[k][j] -= steps[k] * direction[j];
+            project(points[k]);
+        }
+        point_ptrs.resize(nnodes);
+        for (size_t k = 0; k < nnodes; ++k)
+            point_ptrs[k] = &points[k];
+        evaluate(point_ptrs, values, grads);
+
+        // replay the bisection on the evaluated points
+        size_t k = 0;
+        for (int level = 0; level < levels; ++level)
+        {
+            --remaining;
+            step = steps[k];
+            x_forward.swap(points[k]);
+            grad_forward.swap(grads[k]);
+            f_forward = values[k];
+            variance_forward = variances[k];
+            if (!scs.satisfy_L_condition(f_forward, objective, step))
+            {
+                r = step;
+                k = 2 * k + 1;
+            }
+            else if (!scs.satisfy_R_condition(grad_forward))
+            {
+                l = step;
+                k = 2 * k + 2;
+            }
+            else
+                return step;
+        }
+    }
+    return step;
+}
+
+void TwoStageSCS::solve()
+{
+    if (iteration > 0)
+        throw std::runtime_error("TwoStageSCS::solve: solve can only be called once.");
+
+    // obtain some feasible first stage solution
+    // by projecting the zero vector onto the feasible set
+    x.assign(proj_prob0->nvars_current, 0.0);
+    project(x);
+
+    const bool adaptive = options.max_samples > options.num_samples;
+    std::vector<double> grad, x_forward, grad_forward;
+    objective = evaluate(x, grad);
+    UnconstrainedSCS scs;
+
+    while (iteration < options.max_iterations)
+    {
+        ++iteration;
+        scs.update(grad);
+        const std::vector<double> &direction = scs.get_current_direction();
+        double d_norm_squared = kernels::dot(direction.data(), direction.data(), direction.size());
+        if (d_norm_squared <= options.tolerance)
+            break;
+
+        // the gradient at the new point comes with its objective, and is the next gradient
+        if (adaptive)
+            reference = grad;
+        double f_forward = objective;
+        SampleVariance variance;
+        double step = line_search(scs, direction, x_forward, f_forward, grad_forward, variance);
+
+        const double decrease = objective - f_forward;
+        x.swap(x_forward);
+        grad.swap(grad_forward);
+        objective = f_forward;
+
+        // grow the pool if the variance at the new point fails the tests; with
+        // reuse_solutions the old samples are answered from their cache at the
+        // same point, so only the new ones are solved
+        if (adaptive)
+        {
+            size_t target = next_sample_size(variance, grad, decrease);
+            if (target > samples.size())
+            {
+                add_samples(target - samples.size());
+                objective = evaluate(x, grad);
+            }
+        }
+
+        if (options.verbose)
+        {
+            std::cout << "Iteration " << iteration << ": objective " << objective
+                      << ", step " << step << ", |d|^2 " << d_norm_squared
+                      << ", samples " << samples.size()
+                      << ", solves " << sweep_stats.solves << ", reuses " << sweep_stats.reuses << '\n';
+        }
+    }
+}
+
+TwoStageLShaped::TwoStageLShaped(const std::string &base_path, const std::string &prob_name, int nworkers_,
+                                 const Options &options_)
+    : TwoStageSP(base_path, prob_name, nworkers_), options(options_), exact(false),
+      objective(std::numeric_limits<double>::infinity()), lower_bound(-std::numeric_limits<double>::infinity()),
+      iteration(0)
+{
+    if (options.acceptance_ratio <= 0.0 || options.acceptance_ratio >= 1.0)
+        throw std::runtime_error("TwoStageLShaped::TwoStageLShaped: the acceptance ratio must be in (0, 1).");
+    if (options.trust_region > 0.0 &&
+        (options.min_trust_region <= 0.0 || options.min_trust_region > options.trust_region ||
+         options.trust_region > options.max_trust_region))
+        throw std::runtime_error("TwoStageLShaped::TwoStageLShaped: the trust region must satisfy 0 < min_trust_region <= trust_region <= max_trust_region.");
+
+    // the whole distribution if it is small and finite, a sample otherwise
+    auto enumerated = sto.enumerate_scenarios(options.max_scenarios);
+    exact = !enumerated.empty();
+    if (exact)
+    {
+        for (const auto &scenario : enumerated)
+        {
+            scenarios.push_back(second_stage_omega(scenario.omega));
+            probabilities.push_back(scenario.probability);
+        }
+    }
+    else
+    {
+        if (options.num_samples == 0)
+            throw std::runtime_error("TwoStageLShaped::TwoStageLShaped: the distribution is not finite and num_samples is 0.");
+        std::mt19937 rng(options.seed);
+        for (size_t i = 0; i < options.num_samples; ++i)
+            scenarios.push_back(second_stage_omega(sto.generate_scenario(rng)));
+        probabilities.assign(options.num_samples, 1.0 / static_cast<double>(options.num_samples));
+    }
+
+    const size_t nscenarios = scenarios.size();
+    const size_t nclusters = options.num_clusters == 0 ? nscenarios : std::min(options.num_clusters, nscenarios);
+    clusters.resize(nscenarios);
+    for (size_t s = 0; s < nscenarios; ++s)
+        clusters[s] = s * nclusters / nscenarios;
+
+    // theta_g >= recourse_lower_bound * P_g for every cluster, with one bound for all
+    std::vector<double> cluster_probability(nclusters, 0.0);
+    for (size_t s = 0; s < nscenarios; ++s)
+        cluster_probability[clusters[s]] += probabilities[s];
+    const auto [min_probability, max_probability] =
+        std::minmax_element(cluster_probability.begin(), cluster_probability.end());
+    const double bound = options.recourse_lower_bound;
+    const double epigraph_bound = bound < 0.0 ? bound * *max_probability
+                                  : bound > 0.0 ? bound * *min_probability : 0.0;
+
+    master = std::make_unique<StageMasterProblem>(cor, tim, sto, nclusters, epigraph_bound);
+    master->attach_solver();
+    if (master->nvars_current != prob1.front()->nvars_last)
+        throw std::runtime_error("TwoStageLShaped::TwoStageLShaped: first stage dimension does not match the second stage.");
+
+    proj_prob0 = std::make_unique<StageProjectionProblem>(cor, tim, sto, 0);
+    proj_prob0->attach_solver();
+
+    scenario_values.resize(nscenarios);
+    scenario_cuts.assign(nscenarios, Cut{0.0, std::vector<double>(master->nvars_current, 0.0)});
+}
+
+const std::vector<double> &TwoStageLShaped::get_solution() const
+{
+    return solution;
+}
+
+double TwoStageLShaped::get_objective() const
+{
+    return objective;
+}
+
+double TwoStageLShaped::get_lower_bound() const
+{
+    return lower_bound;
+}
+
+uint64_t TwoStageLShaped::get_iterations() const
+{
+    return iteration;
+}
+
+size_t TwoStageLShaped::get_num_scenarios() const
+{
+    return scenarios.size();
+}
+
+bool TwoStageLShaped::is_exact() const
+{
+    return exact;
+}
+
+const TwoStageLShaped::Timing &TwoStageLShaped::get_timing() const
+{
+    return timing;
+}
+
+double TwoStageLShaped::evaluate(const std::vector<double> &x, std::vector<Cut> &cluster_cuts)
+{
+    auto phase_start = Clock::now();
+    parallel_sweep(nworkers, scenarios.size(), [&](int thread_id, size_t s)
+    {
+        StageProblem &prob1_inst = *prob1[thread_id];
+        prob1_inst.update_solver_with_scenario(x, scenarios[s]);
+        auto sol = prob1_inst.solve_problem(true, true);
+        scenario_values[s] = sol.obj_value;
+
+        Cut &cut = scenario_cuts[s];
+        cut.alpha = 0.0;
+        std::fill(cut.beta.begin(), cut.beta.end(), 0.0);
+        CutHelper::add_cut(prob1_inst, sol, scenarios[s], cut);
+    });
+    timing.subproblems += elapsed(phase_start);
+
+    // the cut of a cluster is the probability weighted sum of its scenarios
+    phase_start = Clock::now();
+    const size_t n = x.size();
+    for (auto &cut : cluster_cuts)
+    {
+        cut.alpha = 0.0;
+        cut.beta.assign(n, 0.0);
+    }
+    double value = kernels::dot(master->cost_coefficients.data(), x.data(), n);
+    for (size_t s = 0; s < scenarios.size(); ++s)
+    {
+        const double p = probabilities[s];
+        value += p * scenario_values[s];
+        Cut &cut = cluster_cuts[clusters[s]];
+        cut.alpha += p * scenario_cuts[s].alpha;
+        for (size_t j = 0; j < n; ++j)
+            cut.beta[j] += p * scenario_cuts[s].beta[j];
+    }
+    timing.cuts += elapsed(phase_start);
+    return value;
+}
+
+void TwoStageLShaped::solve()
+{
+    if (iteration > 0)
+        throw std::runtime_error("TwoStageLShaped::solve: solve can only be called once.");
+
+    const auto start_time = Clock::now();
+    timing = Timing();
+    const size_t n = master->nvars_current, nclusters = master->get_num_epigraph();
+    const bool trust = options.trust_region > 0.0;
+    double radius = options.trust_region;
+
+    // start from the projection of the origin onto the first stage feasible set
+    std::vector<double> candidate(n, 0.0), incumbent;
+    auto proj_solution = proj_prob0->project(candidate);
+    if (proj_solution.has_value())
+    {
+        for (size_t j = 0; j < n; ++j)
+            candidate[j] += proj_solution.value()[j];
+    }
+
+    std::vector<Cut> cluster_cuts(nclusters);
+    // epigraph values of the master at the candidate, none before the first solve
+    std::vector<double> theta;
+    double incumbent_value = 0.0, model_value = 0.0;
+
+    for (uint64_t k = 1; k <= options.max_iterations; ++k)
+    {
+        iteration = k;
+        double value = evaluate(candidate, cluster_cuts);
+        if (value < objective)
+        {
+            objective = value;
+            solution = candidate;
+        }
+
+        // only the cuts that cut off the master solution
+        auto phase_start = Clock::now();
+        master->set_activity_iteration(k);
+        size_t added = 0;
+        for (size_t g = 0; g < nclusters; ++g)
+        {
+            double cut_value = CutHelper::evaluate(cluster_cuts[g], candidate);
+            if (theta.empty() || cut_value > theta[g] + options.tolerance * (1.0 + std::abs(cut_value)))
+            {
+                master->add_cut(cluster_cuts[g], 1, g);
+                ++added;
+            }
+        }
+        timing.cuts += elapsed(phase_start);
+
+        // incumbent test against the decrease the master predicted
+        bool accepted = false;
+        if (trust)
+        {
+            const double predicted = incumbent_value - model_value, actual = incumbent_value - value;
+            accepted = k == 1 || actual >= options.acceptance_ratio * predicted;
+            if (accepted && k > 1)
+            {
+                // a good step to the boundary of the region grows it
+                double step = 0.0;
+                for (size_t j = 0; j < n; ++j)
+                    step = std::max(step, std::abs(candidate[j] - incumbent[j]));
+                if (actual >= 0.5 * predicted && step >= radius * (1.0 - 1e-6))
+                    radius = std::min(2.0 * radius, options.max_trust_region);
+            }
+            else if (!accepted && actual < 0.0)
+                radius = std::max(radius / 2.0, options.min_trust_region);
+            if (accepted)
+            {
+                incumbent = candidate;
+                incumbent_value = value;
+            }
+        }
+
+        // master for the next candidate, in the d-space around the incumbent with a trust region
+        phase_start = Clock::now();
+        master->remove_inactive_cuts(options.max_inactive);
+        if (trust)
+        {
+            master->set_x_base(incumbent);
+            master->set_trust_region(radius);
+        }
+        auto sol = master->solve_master();
+        candidate = sol.solution;
+        if (trust)
+            for (size_t j = 0; j < n; ++j)
+                candidate[j] += incumbent[j];
+        theta = master->get_epigraph_values();
+        model_value = kernels::dot(master->cost_coefficients.data(), candidate.data(), n);
+        for (double t : theta)
+            model_value += t;
+        // dropping inactive cuts can lower the master value, the bound keeps the best
+        if (!trust)
+            lower_bound = std::max(lower_bound, model_value);
+        timing.master += elapsed(phase_start);
+
+        // m(candidate) <= m(incumbent) <= f(incumbent), and the bound <= f(best) without a trust region
+        const double reference = trust ? incumbent_value : objective;
+        const double gap = reference - (trust ? model_value : lower_bound);
+
+        if (options.verbose)
+        {
+            std::cout << "Iteration " << k << ": value " << value << ", best " << objective
+                      << ", master " << model_value << ", gap " << gap
+                      << ", cuts " << master->get_cut_pool().size() << " (" << added << " new)";
+            if (trust)
+                std::cout << ", radius " << radius << (accepted ? ", new incumbent" : "");
+            std::cout << '\n';
+        }
+
+        if (gap <= options.tolerance * (1.0 + std::abs(reference)))
+            break;
+    }
+
+    timing.total = elapsed(start_time);
+}
@@ -0,0 +1,196 @@
+#include "validator.h"
+#include "kernels.h"
+#include "utils.h"
+#include "scheduler.h"
+#include <cmath>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+void RunningStats::add(double value)
+{
+    ++n;
+    double delta = value - running_mean;
+    running_mean += delta / static_cast<double>(n);
+    m2 += delta * (value - running_mean);
+}
+
+void RunningStats::reset()
+{
+    n = 0;
+    running_mean = 0.0;
+    m2 = 0.0;
+}
+
+uint64_t RunningStats::count() const
+{
+    return n;
+}
+
+double RunningStats::mean() const
+{
+    return running_mean;
+}
+
+double RunningStats::variance() const
+{
+    return n > 1 ? m2 / static_cast<double>(n - 1) : 0.0;
+}
+
+double RunningStats::std_error() const
+{
+    return n > 0 ? std::sqrt(variance() / static_cast<double>(n)) : 0.0;
+}
+
+Validator::Validator(const std::string &base_path, const std::string &prob_name, int nthreads,
+                     const ValidatorOptions &options_)
+    : options(options_),
+      cor((fs::path(base_path) / prob_name / (prob_name + ".cor")).string()),
+      tim((fs::path(base_path) / prob_name / (prob_name + ".tim")).string()),
+      sto((fs::path(base_path) / prob_name / (prob_name + ".sto")).string()),
+      rng(options_.seed), point_version(0), stopping(false)
+{
+    if (nthreads <= 0)
+        throw std::runtime_error("Validator::Validator: at least one thread is needed.");
+    if (options.batch_size == 0)
+        throw std::runtime_error("Validator::Validator: batch_size must be positive.");
+
+    cost_coefficients = StageProblem(cor, tim, sto, 0).cost_coefficients;
+
+    StageProblem prob1_tmp(cor, tim, sto, 1);
+    for (int i = 0; i < nthreads; ++i)
+    {
+        prob1.push_back(std::make_unique<StageProblem>(prob1_tmp));
+        prob1[i]->attach_solver();
+        int error = GRBsetintparam(GRBgetenv(prob1[i]->get_model()), GRB_INT_PAR_THREADS, 1);
+        check_solver_error(error, "Error setting threads parameter");
+    }
+}
+
+Validator::~Validator()
+{
+    // errors are dropped here, stop() reports them
+    stopping.store(true);
+    point_changed.notify_all();
+    if (thread.joinable())
+        thread.join();
+}
+
+void Validator::start()
+{
+    if (thread.joinable())
+        throw std::runtime_error("Validator::start: already started.");
+    stopping.store(false);
+    thread_error = nullptr;
+    thread = std::thread([this]()
+    {
+        try
+        {
+            run();
+        }
+        catch (...)
+        {
+            thread_error = std::current_exception();
+        }
+    });
+}
+
+void Validator::stop()
+{
+    stopping.store(true);
+    point_changed.notify_all();
+    if (thread.joinable())
+        thread.join();
+    if (thread_error)
+        std::rethrow_exception(thread_error);
+}
+
+bool Validator::set_point(const std::vector<double> &x)
+{
+    if (x.size() != cost_coefficients.size())
+        throw std::runtime_error("Validator::set_point: dimension mismatch.");
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (point_version > 0 && x == point)
+            return false;
+        point = x;
+        ++point_version;
+        stats.reset();
+    }
+    point_changed.notify_all();
+    return true;
+}
+
+Validator::Estimate Validator::get_estimate() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Estimate estimate;
+    estimate.point_version = point_version;
+    estimate.count = stats.count();
+    estimate.mean = stats.mean();
+    estimate.std_error = stats.std_error();
+    estimate.lower = estimate.mean - options.z * estimate.std_error;
+    estimate.upper = estimate.mean + options.z * estimate.std_error;
+    return estimate;
+}
+
+double Validator::pessimistic_gap(double lower_bound) const
+{
+    Estimate estimate = get_estimate();
+    if (estimate.point_version == 0 || estimate.count < options.min_samples)
+        return std::numeric_limits<double>::infinity();
+    return (estimate.upper - lower_bound) / (1.0 + std::abs(estimate.upper));
+}
+
+size_t Validator::dimension() const
+{
+    return cost_coefficients.size();
+}
+
+void Validator::run()
+{
+    const StageStochasticPattern &pattern = prob1.front()->stage_stoc_pattern;
+    std::vector<double> x, values;
+    std::vector<std::vector<double>> samples(options.batch_size);
+
+    while (!stopping.load())
+    {
+        uint64_t version;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            point_changed.wait(lock, [this]() { return stopping.load() || point_version > 0; });
+            if (stopping.load())
+                break;
+            x = point;
+            version = point_version;
+        }
+
+        // the second stage part of each scenario
+        for (auto &omega : samples)
+            stage_omega(pattern, sto.generate_scenario(rng), omega);
+        evaluate_batch(x, samples, values);
+
+        // a batch for an old point is dropped
+        std::lock_guard<std::mutex> lock(mutex);
+        if (version != point_version)
+            continue;
+        for (double value : values)
+            stats.add(value);
+    }
+}
+
+void Validator::evaluate_batch(const std::vector<double> &x, const std::vector<std::vector<double>> &samples,
+                               std::vector<double> &values)
+{
+    const double first_stage = kernels::dot(cost_coefficients.data(), x.data(), x.size());
+    values.assign(samples.size(), 0.0);
+
+    parallel_sweep(static_cast<int>(prob1.size()), samples.size(), [&](int thread_id, size_t s)
+    {
+        StageProblem &prob1_inst = *prob1[thread_id];
+        prob1_inst.update_solver_with_scenario(x, samples[s]);
+        values[s] = first_stage + prob1_inst.solve_problem(false).obj_value;
+    });
+}
@@ -1,33 +1,44 @@
 #include "vector_container.h"
 #include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <thread>
 
-VectorContainer::VectorContainer(size_t max_vecs, size_t vec_dim) 
+VectorContainer::VectorContainer(size_t max_vecs, size_t vec_dim, const StorageOptions &options) 
     : max_vectors(max_vecs), vector_dim(vec_dim), 
       padded_vector_dim(calculate_padded_dim(vec_dim)), 
       current_size(0), current_position(0), 
       sync_start_position(0), wrap_around_flag(false),
-      full_flag(false) {
-    data_storage = new float[max_vectors * padded_vector_dim]();
+      full_flag(false), replaced_flag(max_vecs, 0),
+      eviction_policy(EvictionPolicy::ROUND_ROBIN), clock(0),
+      hits(max_vecs, 0), last_hit(max_vecs, 0), inserted_at(max_vecs, 0) {
+    data_storage = allocate_float_storage(max_vectors * padded_vector_dim, padded_vector_dim, options);
+    if (options.double_copy)
+        double_storage.assign(max_vectors * vector_dim, 0.0);
 }
 
 
 VectorContainer::~VectorContainer() {
-    delete[] data_storage;
+    free_float_storage(data_storage);
 }
 
 VectorContainer::VectorContainer(VectorContainer&& other) noexcept
     : max_vectors(other.max_vectors), vector_dim(other.vector_dim),
       padded_vector_dim(other.padded_vector_dim), current_size(other.current_size),
       current_position(other.current_position), sync_start_position(other.sync_start_position),
-      wrap_around_flag(other.wrap_around_flag), data_storage(other.data_storage) {
+      wrap_around_flag(other.wrap_around_flag), full_flag(other.full_flag),
+      replaced_indices(std::move(other.replaced_indices)), replaced_flag(std::move(other.replaced_flag)),
+      eviction_policy(other.eviction_policy), clock(other.clock),
+      hits(std::move(other.hits)), last_hit(std::move(other.last_hit)),
+      inserted_at(std::move(other.inserted_at)),
+      data_storage(other.data_storage), double_storage(std::move(other.double_storage)) {
     other.data_storage = nullptr;
     other.current_size = 0;
 }
 
 VectorContainer& VectorContainer::operator=(VectorContainer&& other) noexcept {
     if (this != &other) {
-        delete[] data_storage;
+        free_float_storage(data_storage);
 
         max_vectors = other.max_vectors;
         vector_dim = other.vector_dim;
@@ -36,7 +47,16 @@ VectorContainer& VectorContainer::operator=(VectorContainer&& other) noexcept {
         current_position = other.current_position;
         sync_start_position = other.sync_start_position;
         wrap_around_flag = other.wrap_around_flag;
+        full_flag = other.full_flag;
+        replaced_indices = std::move(other.replaced_indices);
+        replaced_flag = std::move(other.replaced_flag);
+        eviction_policy = other.eviction_policy;
+        clock = other.clock;
+        hits = std::move(other.hits);
+        last_hit = std::move(other.last_hit);
+        inserted_at = std::move(other.inserted_at);
         data_storage = other.data_storage;
+        double_storage = std::move(other.double_storage);
 
         other.data_storage = nullptr;
         other.current_size = 0;
@@ -52,7 +72,7 @@ std::optional<size_t> VectorContainer::insert(const std::vector<float>& vec) {
 std::optional<size_t> VectorContainer::insert(const std::vector<double>& vec) {
     if (vec.size() != vector_dim) return std::nullopt;
     std::vector<float> temp(vec.begin(), vec.end());
-    return insert(temp);
+    return pad_and_store(temp.data(), vec.data());
 }
 
 std::optional<size_t> VectorContainer::insert(const double* vec) {
@@ -72,6 +92,10 @@ size_t VectorContainer::size() const {
     return current_size;
 }
 
+size_t VectorContainer::capacity() const {
+    return max_vectors;
+}
+
 std::vector<float> VectorContainer::get(size_t index) const {
     std::vector<float> vec(vector_dim);
     if (index < current_size) {
@@ -84,6 +108,48 @@ const float* VectorContainer::data() const {
     return data_storage;
 }
 
+bool VectorContainer::has_double_copy() const {
+    return !double_storage.empty();
+}
+
+std::vector<double> VectorContainer::get_double(size_t index) const {
+    std::vector<double> vec(vector_dim, 0.0);
+    if (index < current_size && has_double_copy())
+        std::copy_n(&double_storage[index * vector_dim], vector_dim, vec.begin());
+    return vec;
+}
+
+const double* VectorContainer::double_data() const {
+    return double_storage.data();
+}
+
+void VectorContainer::set_eviction_policy(EvictionPolicy policy) {
+    eviction_policy = policy;
+}
+
+VectorContainer::EvictionPolicy VectorContainer::get_eviction_policy() const {
+    return eviction_policy;
+}
+
+void VectorContainer::record_hit(size_t index, uint64_t timestamp, uint64_t count) {
+    if (index >= current_size || count == 0) return;
+    clock = std::max(clock, timestamp);
+    hits[index] += count;
+    last_hit[index] = std::max(last_hit[index], timestamp);
+}
+
+uint64_t VectorContainer::get_hits(size_t index) const {
+    return index < current_size ? hits[index] : 0;
+}
+
+uint64_t VectorContainer::get_last_hit(size_t index) const {
+    return index < current_size ? last_hit[index] : 0;
+}
+
+const std::vector<size_t> &VectorContainer::get_replaced_indices() const {
+    return replaced_indices;
+}
+
 size_t VectorContainer::get_current_position() const
 {
     return current_position;
@@ -99,13 +165,76 @@ bool VectorContainer::get_wrap_around_flag() const
     return wrap_around_flag;
 }
 
-size_t VectorContainer::pad_and_store(const float* src) {
+std::optional<size_t> VectorContainer::select_victim() const {
+    if (current_size < max_vectors || eviction_policy == EvictionPolicy::ROUND_ROBIN)
+        return std::nullopt;
+
+    // a single pass over the slots; the container is small enough
+    // to be swept by the argmax, so this is cheap next to the sweep.
+    // ties go to the slot inserted first.
+    std::optional<size_t> victim;
+    double victim_score = 0.0;
+    for (size_t i = 0; i < max_vectors; ++i)
+    {
+        if (inserted_at[i] >= clock)
+            continue;
+
+        double score;
+        if (eviction_policy == EvictionPolicy::LEAST_HITS)
+            score = static_cast<double>(hits[i]) / static_cast<double>(clock - inserted_at[i]);
+        else
+            score = static_cast<double>(last_hit[i]);
+
+        if (!victim.has_value() || score < victim_score ||
+            (score == victim_score && inserted_at[i] < inserted_at[victim.value()]))
+        {
+            victim = i;
+            victim_score = score;
+        }
+    }
+    return victim;
+}
+
+size_t VectorContainer::next_insert_position() const {
+    std::optional<size_t> victim = select_victim();
+    return victim.has_value() ? victim.value() : current_position;
+}
+
+size_t VectorContainer::pad_and_store(const float* src, const double* exact) {
+    if (has_double_copy())
+    {
+        double *dst = &double_storage[next_insert_position() * vector_dim];
+        if (exact != nullptr)
+            std::copy_n(exact, vector_dim, dst);
+        else
+            std::copy_n(src, vector_dim, dst);
+    }
+
+    // usage-aware eviction: overwrite the victim in place, the ring position
+    // does not move and the slot is reported through get_replaced_indices
+    std::optional<size_t> victim = select_victim();
+    if (victim.has_value())
+    {
+        size_t pos = victim.value();
+        std::memcpy(&data_storage[pos * padded_vector_dim], src, vector_dim * sizeof(float));
+        hits[pos] = 0;
+        last_hit[pos] = inserted_at[pos] = clock;
+        if (!replaced_flag[pos])
+        {
+            replaced_flag[pos] = 1;
+            replaced_indices.push_back(pos);
+        }
+        return pos;
+    }
+
     size_t offset = current_position * padded_vector_dim;
     std::memcpy(&data_storage[offset], src, vector_dim * sizeof(float));
 
     // record the position where the vector is actually stored
     size_t pos = current_position;
-    
+    hits[pos] = 0;
+    last_hit[pos] = inserted_at[pos] = clock;
+
     if (current_size < max_vectors) ++current_size;
 
     current_position ++;
@@ -132,6 +261,9 @@ size_t VectorContainer::pad_and_store(const float* src) {
 }
 
 void VectorContainer::reset_sync_range() {
+    for (size_t pos : replaced_indices)
+        replaced_flag[pos] = 0;
+    replaced_indices.clear();
     sync_start_position = current_position;
     wrap_around_flag = false;
     full_flag = false;
@@ -141,77 +273,274 @@ size_t VectorContainer::calculate_padded_dim(size_t dim) const {
     return (dim + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE;
 }
 
+UniqueVectorContainer::UniqueVectorContainer(size_t max_vecs, size_t vec_dim, const StorageOptions &options)
+    : VectorContainer(max_vecs, vec_dim, options), slot_hash(max_vecs, 0) {}
+
 std::optional<size_t> UniqueVectorContainer::insert(const std::vector<float> &vec)
 {
     if (vec.size() != vector_dim) return std::nullopt;
-    // calculate the hash value
-    float hash_value = hash(vec);
-    
-    if (hashmap.find(hash_value) != hashmap.end())
-    {
-        std::vector<size_t> &indices = hashmap[hash_value];
-        for (size_t i = 0; i < indices.size(); ++i)
-        {
-            // if we find a vector that is the same as the input vector
-            // then dont insert it
-            if (approx_equal(vec, get(indices[i])))
-            {
-                return std::nullopt;
-            }
-        }
-    }
+    return insert_unique(vec.data(), nullptr);
+}
+
+std::optional<size_t> UniqueVectorContainer::insert(const std::vector<double> &vec) {
+    if (vec.size() != vector_dim) return std::nullopt;
+    std::vector<float> temp(vec.begin(), vec.end());
+    return insert_unique(temp.data(), vec.data());
+}
+
+std::optional<size_t> UniqueVectorContainer::insert(const double *vec)
+{
+    std::vector<double> temp(vec, vec + vector_dim);
+    return insert(temp);
+}
+
+std::optional<size_t> UniqueVectorContainer::insert_unique(const float *vec, const double *exact)
+{
+    // if we find a vector that is the same as the input vector
+    // then dont insert it
+    if (find(vec).has_value())
+        return std::nullopt;
 
     // if we reach here, then we need to insert the vector
 
-    // check if we need to overwrite the oldest vector,
+    // check if we need to overwrite a vector,
     // if overwriting, we should also remove the old index from the hashmap
     if (current_size == max_vectors)
+        remove_from_hashmap(next_insert_position());
+
+    // store the vector, then record its hash
+    uint64_t hash_value = hash(vec);
+    size_t pos = pad_and_store(vec, exact);
+    hashmap[hash_value].push_back(pos);
+    slot_hash[pos] = hash_value;
+    return pos;
+}
+
+int64_t UniqueVectorContainer::quantize(float value)
+{
+    // clamp so that huge values cannot overflow the cell index
+    constexpr double limit = 4e18;
+    double cell = std::floor(static_cast<double>(value) / HASH_CELL_WIDTH);
+    return static_cast<int64_t>(std::clamp(cell, -limit, limit));
+}
+
+uint64_t UniqueVectorContainer::hash_coordinate(int64_t cell, size_t i)
+{
+    // splitmix64 finalizer on the cell index mixed with the position
+    uint64_t x = static_cast<uint64_t>(cell) ^ (static_cast<uint64_t>(i) * 0x9e3779b97f4a7c15ULL);
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+uint64_t UniqueVectorContainer::hash(const float *vec) const
+{
+    uint64_t hash = 0;
+    for (size_t i = 0; i < vector_dim; ++i)
+        hash += hash_coordinate(quantize(vec[i]), i);
+    return hash;
+}
+
+std::optional<size_t> UniqueVectorContainer::find(const float *vec) const
+{
+    // base hash, and the hash change for moving each near-boundary
+    // coordinate to the neighbouring cell
+    uint64_t base = 0;
+    std::vector<uint64_t> neighbour_delta;
+    for (size_t i = 0; i < vector_dim; ++i)
     {
-        float oldest_hash = hash(get(current_position));
-        std::vector<size_t> &indices = hashmap[oldest_hash];
-        auto it = std::find(indices.begin(), indices.end(), current_position);
-        if (it != indices.end())
-        {
-            indices.erase(it);
-        }
+        int64_t cell = quantize(vec[i]);
+        uint64_t h = hash_coordinate(cell, i);
+        base += h;
+
+        if (neighbour_delta.size() == MAX_PROBE_COORDS)
+            continue;
+        if (quantize(vec[i] - TOLERANCE) != cell)
+            neighbour_delta.push_back(hash_coordinate(cell - 1, i) - h);
+        else if (quantize(vec[i] + TOLERANCE) != cell)
+            neighbour_delta.push_back(hash_coordinate(cell + 1, i) - h);
     }
 
-    // add the hash value to the hashmap
-    if (hashmap.find(hash_value) == hashmap.end())
+    // probe every combination of neighbouring cells
+    const float *storage = data();
+    for (size_t mask = 0; mask < (size_t(1) << neighbour_delta.size()); ++mask)
     {
-        hashmap[hash_value] = std::vector<size_t>();
+        uint64_t key = base;
+        for (size_t k = 0; k < neighbour_delta.size(); ++k)
+            if (mask & (size_t(1) << k))
+                key += neighbour_delta[k];
+
+        auto it = hashmap.find(key);
+        if (it == hashmap.end())
+            continue;
+        for (size_t index : it->second)
+            if (approx_equal(vec, storage + index * padded_vector_dim, vector_dim))
+                return index;
     }
-    hashmap[hash_value].push_back(current_position);
+    return std::nullopt;
+}
 
-    // store the vector
-    return VectorContainer::insert(vec);
+void UniqueVectorContainer::remove_from_hashmap(size_t pos)
+{
+    auto it = hashmap.find(slot_hash[pos]);
+    if (it == hashmap.end())
+        return;
+
+    std::vector<size_t> &indices = it->second;
+    auto found = std::find(indices.begin(), indices.end(), pos);
+    if (found != indices.end())
+        indices.erase(found);
+    if (indices.empty())
+        hashmap.erase(it);
 }
 
-std::optional<size_t> UniqueVectorContainer::insert(const std::vector<double> &vec) {
+bool UniqueVectorContainer::approx_equal(const float *v1, const float *v2, size_t n)
+{
+    for(size_t i = 0; i < n; ++i)
+        if(std::abs(v1[i] - v2[i]) > TOLERANCE)
+            return false;
+    return true;
+}
+
+ConcurrentVectorContainer::ConcurrentVectorContainer(size_t max_vecs, size_t vec_dim, const StorageOptions &options)
+    : max_vectors(max_vecs), vector_dim(vec_dim),
+      padded_vector_dim(calculate_padded_dim(vec_dim)),
+      reserved(0), published(0), sync_sequence(0) {
+    data_storage = allocate_float_storage(max_vectors * padded_vector_dim, padded_vector_dim, options);
+    slot_sequence = new std::atomic<uint64_t>[max_vectors];
+    for (size_t i = 0; i < max_vectors; ++i)
+        slot_sequence[i].store(0, std::memory_order_relaxed);
+}
+
+ConcurrentVectorContainer::~ConcurrentVectorContainer() {
+    free_float_storage(data_storage);
+    delete[] slot_sequence;
+}
+
+std::optional<size_t> ConcurrentVectorContainer::insert(const std::vector<float>& vec) {
+    if (vec.size() != vector_dim) return std::nullopt;
+    return store(vec.data());
+}
+
+std::optional<size_t> ConcurrentVectorContainer::insert(const std::vector<double>& vec) {
+    if (vec.size() != vector_dim) return std::nullopt;
     std::vector<float> temp(vec.begin(), vec.end());
     return insert(temp);
 }
 
-std::optional<size_t> UniqueVectorContainer::insert(const double *vec)
-{
+std::optional<size_t> ConcurrentVectorContainer::insert(const double* vec) {
     std::vector<float> temp(vec, vec + vector_dim);
     return insert(temp);
 }
 
-float UniqueVectorContainer::hash(const std::vector<float> &vec)
-{
-    float hash = 0;
-    for (size_t i = 0; i < vec.size(); ++i)
-    {
-        hash += std::abs(vec[i]);
+size_t ConcurrentVectorContainer::store(const float* src) {
+    // reserve a slot
+    uint64_t ticket = reserved.fetch_add(1, std::memory_order_relaxed);
+    size_t slot = ticket % max_vectors;
+    uint64_t lap = ticket / max_vectors;
+    std::atomic<uint64_t> &seq = slot_sequence[slot];
+
+    // a writer from the previous lap may still be copying into this slot
+    while (seq.load(std::memory_order_acquire) != 2 * lap)
+        std::this_thread::yield();
+
+    // mark the slot as being written, then copy
+    seq.store(2 * lap + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&data_storage[slot * padded_vector_dim], src, vector_dim * sizeof(float));
+    // sequentially consistent from here on: a writer finishing a ticket and a
+    // writer advancing the published count must not both miss each other
+    seq.store(2 * lap + 2, std::memory_order_seq_cst);
+
+    // publish in ticket order, so readers always see a complete prefix:
+    // advance the published count over every consecutive completed ticket.
+    // a writer never waits for slower ones, whoever completes the gap moves it forward
+    uint64_t next = published.load(std::memory_order_seq_cst);
+    while (next < reserved.load(std::memory_order_seq_cst)) {
+        uint64_t next_lap = next / max_vectors;
+        if (slot_sequence[next % max_vectors].load(std::memory_order_seq_cst) < 2 * next_lap + 2)
+            break;
+        // on failure next holds the current count and we continue from there
+        published.compare_exchange_weak(next, next + 1, std::memory_order_seq_cst);
     }
-    return hash;
+
+    return slot;
 }
 
-bool UniqueVectorContainer::approx_equal(const std::vector<float> &v1, const std::vector<float> &v2)
-{
-    for(size_t i = 0; i < v1.size(); ++i)
-        if(std::abs(v1[i] - v2[i]) > TOLERANCE)
-            return false;
-    return true;
+ConcurrentVectorContainer::Snapshot ConcurrentVectorContainer::snapshot() const {
+    uint64_t sequence = published.load(std::memory_order_acquire);
+    return {sequence, static_cast<size_t>(std::min<uint64_t>(sequence, max_vectors))};
+}
+
+bool ConcurrentVectorContainer::validate(const Snapshot &snap) const {
+    // the tickets taken after the snapshot only land in the swept slots
+    // once they go past the end of the storage
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t now = reserved.load(std::memory_order_relaxed);
+    return now <= std::max<uint64_t>(snap.sequence, max_vectors);
+}
+
+size_t ConcurrentVectorContainer::get_vector_dims() const {
+    return vector_dim;
+}
+
+size_t ConcurrentVectorContainer::get_padding_dims() const {
+    return padded_vector_dim - vector_dim;
+}
+
+size_t ConcurrentVectorContainer::size() const {
+    return snapshot().size;
+}
+
+std::vector<float> ConcurrentVectorContainer::get(size_t index) const {
+    std::vector<float> vec(vector_dim);
+    if (index >= size()) return vec;
+
+    // seqlock read: retry until the slot was stable during the copy
+    const std::atomic<uint64_t> &seq = slot_sequence[index];
+    while (true) {
+        uint64_t before = seq.load(std::memory_order_acquire);
+        if (before % 2 == 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::memcpy(vec.data(), &data_storage[index * padded_vector_dim], vector_dim * sizeof(float));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) == before)
+            return vec;
+    }
+}
+
+const float* ConcurrentVectorContainer::data() const {
+    return data_storage;
+}
+
+size_t ConcurrentVectorContainer::get_current_position() const {
+    return published.load(std::memory_order_acquire) % max_vectors;
+}
+
+size_t ConcurrentVectorContainer::get_sync_position() const {
+    uint64_t current = published.load(std::memory_order_acquire);
+    uint64_t start = sync_sequence.load(std::memory_order_relaxed);
+
+    // once a full lap has been inserted since the reset, everything needs syncing
+    // and the sync position follows the current position
+    if (current - start >= max_vectors)
+        return current % max_vectors;
+    return start % max_vectors;
+}
+
+bool ConcurrentVectorContainer::get_wrap_around_flag() const {
+    uint64_t current = published.load(std::memory_order_acquire);
+    uint64_t start = sync_sequence.load(std::memory_order_relaxed);
+    return start % max_vectors + (current - start) >= max_vectors;
+}
+
+void ConcurrentVectorContainer::reset_sync_range() {
+    sync_sequence.store(published.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+size_t ConcurrentVectorContainer::calculate_padded_dim(size_t dim) const {
+    return (dim + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE;
 }
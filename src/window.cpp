@@ -0,0 +1,136 @@
+#include "window.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    // doubles before the first cut
+    constexpr size_t HEADER = 4;
+}
+
+SeqlockWindow::SeqlockWindow(size_t capacity_) : cap(capacity_), latest(0), latest_version(0)
+{
+    for (Buffer &buffer : buffers)
+        buffer.data.assign(cap, 0.0);
+}
+
+size_t SeqlockWindow::capacity() const
+{
+    return cap;
+}
+
+uint64_t SeqlockWindow::publish(const std::vector<double> &data)
+{
+    return publish(data.data(), data.size());
+}
+
+uint64_t SeqlockWindow::publish(const double *data, size_t n)
+{
+    if (n > cap)
+        throw std::runtime_error("SeqlockWindow::publish: data exceeds the capacity of the window.");
+
+    // the writer is the only one to change latest, so a relaxed load is enough
+    unsigned target = 1 - latest.load(std::memory_order_relaxed);
+    Buffer &buffer = buffers[target];
+    uint64_t version = latest_version.load(std::memory_order_relaxed) + 1;
+
+    // mark the buffer as being written, then copy
+    uint64_t seq = buffer.sequence.load(std::memory_order_relaxed);
+    buffer.sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    buffer.version = version;
+    buffer.length = n;
+    std::memcpy(buffer.data.data(), data, n * sizeof(double));
+    buffer.sequence.store(seq + 2, std::memory_order_release);
+
+    // flip the latest buffer
+    latest.store(target, std::memory_order_release);
+    latest_version.store(version, std::memory_order_release);
+    return version;
+}
+
+uint64_t SeqlockWindow::version() const
+{
+    return latest_version.load(std::memory_order_acquire);
+}
+
+uint64_t SeqlockWindow::read(std::vector<double> &out) const
+{
+    while (true)
+    {
+        if (latest_version.load(std::memory_order_acquire) == 0)
+        {
+            out.clear();
+            return 0;
+        }
+
+        // seqlock read of the latest buffer: retry until it was stable during the copy
+        const Buffer &buffer = buffers[latest.load(std::memory_order_acquire)];
+        uint64_t before = buffer.sequence.load(std::memory_order_acquire);
+        if (before % 2 == 1)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        uint64_t version = buffer.version;
+        size_t length = std::min(buffer.length, cap);
+        out.resize(length);
+        std::memcpy(out.data(), buffer.data.data(), length * sizeof(double));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (buffer.sequence.load(std::memory_order_relaxed) == before)
+            return version;
+    }
+}
+
+size_t ApproximationSnapshot::packed_size(size_t ncuts, size_t dim)
+{
+    return HEADER + ncuts * (dim + 1);
+}
+
+void ApproximationSnapshot::pack(size_t dim, std::vector<double> &out) const
+{
+    out.resize(packed_size(cuts.size(), dim));
+    out[0] = static_cast<double>(sample_count);
+    out[1] = static_cast<double>(iteration);
+    out[2] = static_cast<double>(timestamp);
+    out[3] = static_cast<double>(cuts.size());
+    double *p = &out[HEADER];
+    for (const Cut &cut : cuts)
+    {
+        if (cut.beta.size() != dim)
+            throw std::runtime_error("ApproximationSnapshot::pack: cut dimension does not match.");
+        *p++ = cut.alpha;
+        std::copy(cut.beta.begin(), cut.beta.end(), p);
+        p += dim;
+    }
+}
+
+ApproximationSnapshot ApproximationSnapshot::unpack(const std::vector<double> &data, size_t dim)
+{
+    if (data.size() < HEADER || data.size() != packed_size(static_cast<size_t>(data[3]), dim))
+        throw std::runtime_error("ApproximationSnapshot::unpack: data is not a packed snapshot.");
+
+    ApproximationSnapshot snapshot;
+    snapshot.sample_count = static_cast<uint64_t>(data[0]);
+    snapshot.iteration = static_cast<uint64_t>(data[1]);
+    snapshot.timestamp = static_cast<uint64_t>(data[2]);
+    snapshot.cuts.resize(static_cast<size_t>(data[3]));
+    const double *p = &data[HEADER];
+    for (Cut &cut : snapshot.cuts)
+    {
+        cut.alpha = *p++;
+        cut.beta.assign(p, p + dim);
+        p += dim;
+    }
+    return snapshot;
+}
+
+double ApproximationSnapshot::value(const std::vector<double> &x) const
+{
+    double theta = 0.0;
+    for (const Cut &cut : cuts)
+        theta = std::max(theta, CutHelper::evaluate(cut, x));
+    return theta;
+}
@@ -0,0 +1,273 @@
+#define CATCH_CONFIG_MAIN
+#include "../external/catch_amalgamated.hpp"
+#include "smps.h"
+#include "prob.h"
+#include "argmax.h"
+#include <random>
+
+using Catch::Approx;
+
+TEST_CASE("Argmax matches the cuts of every dual", "[ArgmaxEngine]")
+{
+    smps::SMPSCore cor("tests/ssn/ssn.cor");
+    smps::SMPSImplicitTime tim("tests/ssn/ssn.tim");
+    smps::SMPSStoch sto("tests/ssn/ssn.sto");
+
+    // the solver is not needed to evaluate the duals
+    StageProblem prob(cor, tim, sto, 1);
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    VectorContainer duals(16, prob.get_dual_dimension());
+    ArgmaxEngine engine(prob, duals);
+
+    for (int s = 0; s < 40; ++s)
+        engine.add_sample(sto.generate_scenario(rng));
+    REQUIRE(engine.num_samples() == 40);
+
+    // inserted after the engine is built, picked up by the sync
+    for (int i = 0; i < 12; ++i)
+    {
+        std::vector<double> pi(prob.get_dual_dimension());
+        for (auto &v : pi)
+            v = dist(rng);
+        duals.insert(pi);
+    }
+
+    std::vector<double> x(prob.nvars_last);
+    for (auto &v : x)
+        v = dist(rng);
+
+    ArgmaxEngine::Result result = engine.compute(x, 1);
+    REQUIRE(result.winner.size() == 40);
+
+    std::vector<double> cut_average(prob.nvars_last, 0.0);
+    double alpha_average = 0.0;
+    for (size_t j = 0; j < engine.num_samples(); ++j)
+    {
+        // brute force over the cuts
+        double best = -1e300;
+        for (size_t i = 0; i < duals.size(); ++i)
+            best = std::max(best, CutHelper::evaluate(engine.get_cut(i, j), x));
+        REQUIRE(result.value[j] == Approx(best).epsilon(1e-4));
+        REQUIRE(CutHelper::evaluate(engine.get_cut(result.winner[j], j), x) == Approx(best).epsilon(1e-4));
+
+        Cut cut = engine.get_cut(result.winner[j], j);
+        alpha_average += cut.alpha / 40.0;
+        for (size_t c = 0; c < cut.beta.size(); ++c)
+            cut_average[c] += cut.beta[c] / 40.0;
+    }
+
+    SECTION("the SD cut is the average of the winner cuts")
+    {
+        Cut cut = engine.build_cut(result);
+        REQUIRE(cut.alpha == Approx(alpha_average));
+        for (size_t c = 0; c < cut.beta.size(); ++c)
+            REQUIRE(cut.beta[c] == Approx(cut_average[c]).margin(1e-9));
+    }
+
+    SECTION("winners are recorded as hits")
+    {
+        uint64_t total = 0;
+        for (size_t i = 0; i < duals.size(); ++i)
+            total += duals.get_hits(i);
+        REQUIRE(total == 40);
+        REQUIRE(duals.get_last_hit(result.winner[0]) == 1);
+    }
+
+    SECTION("replaced duals are refreshed")
+    {
+        duals.set_eviction_policy(VectorContainer::EvictionPolicy::LEAST_HITS);
+        for (int i = 0; i < 8; ++i)
+        {
+            std::vector<double> pi(prob.get_dual_dimension());
+            for (auto &v : pi)
+                v = dist(rng);
+            duals.insert(pi);
+        }
+        REQUIRE(duals.size() == 16);
+        REQUIRE(!duals.get_replaced_indices().empty());
+
+        ArgmaxEngine::Result again = engine.compute(x, 2);
+        for (size_t j = 0; j < engine.num_samples(); ++j)
+        {
+            double best = -1e300;
+            for (size_t i = 0; i < duals.size(); ++i)
+                best = std::max(best, CutHelper::evaluate(engine.get_cut(i, j), x));
+            REQUIRE(again.value[j] == Approx(best).epsilon(1e-4));
+        }
+        REQUIRE(duals.get_replaced_indices().empty());
+    }
+}
+
+TEST_CASE("Pruned argmax agrees with the full sweep", "[ArgmaxEngine]")
+{
+    smps::SMPSCore cor("tests/ssn/ssn.cor");
+    smps::SMPSImplicitTime tim("tests/ssn/ssn.tim");
+    smps::SMPSStoch sto("tests/ssn/ssn.sto");
+    StageProblem prob(cor, tim, sto, 1);
+
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    auto random_dual = [&]()
+    {
+        std::vector<double> pi(prob.get_dual_dimension());
+        for (auto &v : pi)
+            v = dist(rng);
+        return pi;
+    };
+
+    // two engines over identical containers, one never prunes
+    VectorContainer pruned_duals(64, prob.get_dual_dimension()), full_duals(64, prob.get_dual_dimension());
+    for (int i = 0; i < 32; ++i)
+    {
+        auto pi = random_dual();
+        pruned_duals.insert(pi);
+        full_duals.insert(pi);
+    }
+    ArgmaxEngine pruned(prob, pruned_duals), full(prob, full_duals);
+    full.set_pruning(false);
+    for (int s = 0; s < 100; ++s)
+    {
+        auto omega = sto.generate_scenario(rng);
+        pruned.add_sample(omega);
+        full.add_sample(omega);
+    }
+
+    std::vector<double> x(prob.nvars_last, 0.0);
+    size_t late_sweeps = 0;
+    for (uint64_t t = 1; t <= 20; ++t)
+    {
+        // small steps, and a new dual now and then
+        for (auto &v : x)
+            v += 1e-4 * dist(rng);
+        if (t % 5 == 0)
+        {
+            auto pi = random_dual();
+            pruned_duals.insert(pi);
+            full_duals.insert(pi);
+        }
+
+        auto a = pruned.compute(x, t), b = full.compute(x, t);
+        REQUIRE(b.full_sweeps == 100);
+        for (size_t j = 0; j < 100; ++j)
+            REQUIRE(a.value[j] == Approx(b.value[j]).epsilon(1e-5));
+        if (t > 1)
+            late_sweeps += a.full_sweeps;
+    }
+
+    // most samples are certified by their memo
+    REQUIRE(late_sweeps < 19 * 100 / 2);
+}
+
+TEST_CASE("Tiled sweep does not depend on the tile sizes", "[ArgmaxEngine]")
+{
+    smps::SMPSCore cor("tests/ssn/ssn.cor");
+    smps::SMPSImplicitTime tim("tests/ssn/ssn.tim");
+    smps::SMPSStoch sto("tests/ssn/ssn.sto");
+    StageProblem prob(cor, tim, sto, 1);
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    VectorContainer a_duals(50, prob.get_dual_dimension()), b_duals(50, prob.get_dual_dimension());
+    for (int i = 0; i < 50; ++i)
+    {
+        std::vector<double> pi(prob.get_dual_dimension());
+        for (auto &v : pi)
+            v = dist(rng);
+        a_duals.insert(pi);
+        b_duals.insert(pi);
+    }
+    ArgmaxEngine a(prob, a_duals), b(prob, b_duals);
+    REQUIRE(a.get_tile_sizes().duals >= VectorContainer::GROUP_SIZE);
+    REQUIRE(a.get_tile_sizes().samples >= 1);
+
+    // tiles that do not divide the problem evenly
+    b.set_tile_sizes({7, 3});
+    REQUIRE_THROWS(b.set_tile_sizes({0, 3}));
+    for (int s = 0; s < 61; ++s)
+    {
+        auto omega = sto.generate_scenario(rng);
+        a.add_sample(omega);
+        b.add_sample(omega);
+    }
+
+    std::vector<double> x(prob.nvars_last);
+    for (auto &v : x)
+        v = dist(rng);
+    auto ra = a.compute(x, 1), rb = b.compute(x, 1);
+    REQUIRE(ra.winner == rb.winner);
+    REQUIRE(ra.value == rb.value);
+}
+
+TEST_CASE("Exact recheck picks the double precision winner", "[ArgmaxEngine]")
+{
+    smps::SMPSCore cor("tests/ssn/ssn.cor");
+    smps::SMPSImplicitTime tim("tests/ssn/ssn.tim");
+    smps::SMPSStoch sto("tests/ssn/ssn.sto");
+    StageProblem prob(cor, tim, sto, 1);
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    StorageOptions options;
+    options.double_copy = true;
+    VectorContainer duals(64, prob.get_dual_dimension(), options);
+
+    // pairs of duals that differ below float resolution at the random rows
+    const StageStochasticPattern &pattern = prob.stage_stoc_pattern;
+    for (int i = 0; i < 16; ++i)
+    {
+        std::vector<double> pi(prob.get_dual_dimension());
+        for (auto &v : pi)
+            v = dist(rng);
+        duals.insert(pi);
+        for (size_t k = 0; k < pattern.rv_count; ++k)
+            pi[pattern.row_index[k]] += 1e-9 * dist(rng);
+        duals.insert(pi);
+    }
+    REQUIRE(duals.has_double_copy());
+    REQUIRE(duals.get_double(1) != duals.get_double(0));
+
+    ArgmaxEngine engine(prob, duals);
+    for (int s = 0; s < 50; ++s)
+        engine.add_sample(sto.generate_scenario(rng));
+
+    std::vector<double> x(prob.nvars_last);
+    for (auto &v : x)
+        v = dist(rng);
+
+    auto result = engine.compute(x, 1);
+    REQUIRE(result.exact_evaluations >= engine.num_samples());
+    for (size_t j = 0; j < engine.num_samples(); ++j)
+    {
+        double best = -1e300;
+        for (size_t i = 0; i < duals.size(); ++i)
+            best = std::max(best, CutHelper::evaluate(engine.get_cut(i, j), x));
+        REQUIRE(result.value[j] == Approx(best).epsilon(1e-13));
+        REQUIRE(CutHelper::evaluate(engine.get_cut(result.winner[j], j), x) == Approx(best).epsilon(1e-13));
+    }
+
+    SECTION("pruned calls keep the exact winner")
+    {
+        for (auto &v : x)
+            v += 1e-6 * dist(rng);
+        auto again = engine.compute(x, 2);
+        for (size_t j = 0; j < engine.num_samples(); ++j)
+        {
+            double best = -1e300;
+            for (size_t i = 0; i < duals.size(); ++i)
+                best = std::max(best, CutHelper::evaluate(engine.get_cut(i, j), x));
+            REQUIRE(again.value[j] == Approx(best).epsilon(1e-13));
+        }
+    }
+
+    SECTION("the recheck needs double copies")
+    {
+        VectorContainer float_only(4, prob.get_dual_dimension());
+        ArgmaxEngine float_engine(prob, float_only);
+        REQUIRE_THROWS(float_engine.set_exact_recheck(true));
+    }
+}
@@ -0,0 +1,88 @@
+#define CATCH_CONFIG_MAIN
+#include "../external/catch_amalgamated.hpp"
+#include "smps.h"
+#include "prob.h"
+#include "cut_helper.h"
+#include <random>
+
+using Catch::Approx;
+
+TEST_CASE("Sparse and dense duals give the same cut", "[CutHelper]")
+{
+    smps::SMPSCore cor("tests/ssn/ssn.cor");
+    smps::SMPSImplicitTime tim("tests/ssn/ssn.tim");
+    smps::SMPSStoch sto("tests/ssn/ssn.sto");
+
+    // the solver is not needed to build the cuts
+    StageProblem prob(cor, tim, sto, 1);
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    std::bernoulli_distribution nonzero(0.1);
+
+    // mostly zero dual, like a dual with many slack rows
+    std::vector<double> pi(prob.get_dual_dimension(), 0.0);
+    for (auto &v : pi)
+        if (nonzero(rng))
+            v = dist(rng);
+    auto sparse_pi = SparseVector<double>::from_dense(pi);
+
+    std::vector<double> scenario = sto.generate_scenario(rng);
+
+    Cut dense_cut = CutHelper::get_static_part(prob, pi);
+    CutHelper::add_dynamic_part(prob, pi, scenario, dense_cut);
+
+    Cut sparse_cut = CutHelper::get_static_part(prob, sparse_pi);
+    CutHelper::add_dynamic_part(prob, sparse_pi, scenario, sparse_cut);
+
+    REQUIRE(sparse_cut.alpha == Approx(dense_cut.alpha));
+    REQUIRE(sparse_cut.beta.size() == dense_cut.beta.size());
+    for (size_t i = 0; i < dense_cut.beta.size(); ++i)
+        REQUIRE(sparse_cut.beta[i] == Approx(dense_cut.beta[i]).margin(1e-12));
+
+    // the solution overloads follow the sparse flag
+    StageProblem::Solution sol{0.0, {}, {}};
+    sol.sparse_dual_solution = sparse_pi;
+    sol.dual_is_sparse = true;
+    Cut sol_cut = CutHelper::get_static_part(prob, sol);
+    CutHelper::add_dynamic_part(prob, sol, scenario, sol_cut);
+    REQUIRE(sol_cut.alpha == Approx(dense_cut.alpha));
+}
+
+TEST_CASE("Cuts summed in place match the sum of the cuts", "[CutHelper]")
+{
+    smps::SMPSCore cor("tests/ssn/ssn.cor");
+    smps::SMPSImplicitTime tim("tests/ssn/ssn.tim");
+    smps::SMPSStoch sto("tests/ssn/ssn.sto");
+    StageProblem prob(cor, tim, sto, 1);
+
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    Cut expected{0.0, std::vector<double>(prob.nvars_last, 0.0)}, sum = expected;
+    for (int s = 0; s < 4; ++s)
+    {
+        StageProblem::Solution sol{0.0, {}, std::vector<double>(prob.get_dual_dimension())};
+        for (auto &v : sol.dual_solution)
+            v = dist(rng);
+        // alternate dense and sparse duals
+        if (s % 2)
+        {
+            sol.sparse_dual_solution = SparseVector<double>::from_dense(sol.dual_solution);
+            sol.dual_is_sparse = true;
+        }
+        std::vector<double> scenario = sto.generate_scenario(rng);
+
+        Cut cut = CutHelper::get_static_part(prob, sol);
+        CutHelper::add_dynamic_part(prob, sol, scenario, cut);
+        expected.alpha += cut.alpha;
+        for (size_t j = 0; j < cut.beta.size(); ++j)
+            expected.beta[j] += cut.beta[j];
+
+        CutHelper::add_cut(prob, sol, scenario, sum);
+    }
+
+    REQUIRE(sum.alpha == Approx(expected.alpha));
+    for (size_t j = 0; j < sum.beta.size(); ++j)
+        REQUIRE(sum.beta[j] == Approx(expected.beta[j]).margin(1e-12));
+}
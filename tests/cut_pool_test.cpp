@@ -0,0 +1,165 @@
+#define CATCH_CONFIG_MAIN
+#include "../external/catch_amalgamated.hpp"
+#include "cut_pool.h"
+#include <random>
+
+using Catch::Approx;
+
+TEST_CASE("CutPool ages cuts lazily", "[CutPool]")
+{
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    const size_t dim = 11;
+
+    // explicit aging as a reference: every cut is rescaled by k / (k + 1)
+    // at the start of each iteration k + 1
+    CutPool pool(dim);
+    std::vector<Cut> aged;
+    for (uint64_t k = 1; k <= 30; ++k)
+    {
+        for (Cut &cut : aged)
+        {
+            double factor = static_cast<double>(k - 1) / static_cast<double>(k);
+            cut.alpha *= factor;
+            for (double &b : cut.beta)
+                b *= factor;
+        }
+
+        Cut cut{dist(rng), std::vector<double>(dim)};
+        for (double &b : cut.beta)
+            b = dist(rng);
+        REQUIRE(pool.add(cut, k) == k - 1);
+        aged.push_back(cut);
+    }
+    const uint64_t k = 30;
+
+    REQUIRE(pool.size() == aged.size());
+    REQUIRE(pool.get_stride() % CutPool::GROUP_SIZE == 0);
+    REQUIRE(pool.get_iteration(4) == 5);
+
+    std::vector<double> x(dim);
+    for (double &v : x)
+        v = dist(rng);
+
+    std::vector<double> values;
+    pool.evaluate(x, k, values);
+    double expected_max = -1e300;
+    size_t expected_index = 0;
+    for (size_t i = 0; i < aged.size(); ++i)
+    {
+        double expected = CutHelper::evaluate(aged[i], x);
+        REQUIRE(values[i] == Approx(expected).margin(1e-12));
+        REQUIRE(CutHelper::evaluate(pool.get_cut(i, k), x) == Approx(expected).margin(1e-12));
+        if (expected > expected_max)
+        {
+            expected_max = expected;
+            expected_index = i;
+        }
+    }
+
+    size_t index;
+    REQUIRE(pool.max_value(x, k, index) == Approx(expected_max));
+    REQUIRE(index == expected_index);
+
+    SECTION("the eta formulation is the same cut")
+    {
+        // eta >= t alpha - t beta x with theta = eta / k
+        Cut scaled = pool.get_scaled_cut(3);
+        REQUIRE(CutHelper::evaluate(scaled, x) * CutPool::epigraph_coefficient(k) == Approx(values[3]));
+    }
+
+    SECTION("bad input")
+    {
+        REQUIRE_THROWS(pool.add(Cut{0.0, std::vector<double>(dim + 1)}, 1));
+        REQUIRE_THROWS(pool.add(Cut{0.0, std::vector<double>(dim)}, 0));
+        pool.clear();
+        REQUIRE(pool.size() == 0);
+        REQUIRE(pool.max_value(x, k, index) == -std::numeric_limits<double>::infinity());
+        REQUIRE(index == 0);
+    }
+}
+
+TEST_CASE("CutPool removes inactive cuts in order", "[CutPool]")
+{
+    const size_t dim = 3;
+    CutPool pool(dim);
+    for (uint64_t t = 1; t <= 6; ++t)
+        pool.add(Cut{static_cast<double>(t), {1.0 * t, 2.0 * t, 3.0 * t}}, t, t % 2);
+
+    REQUIRE(pool.get_epigraph(0) == 1);
+    REQUIRE(pool.get_epigraph(1) == 0);
+
+    // cuts start active at their creation iteration
+    REQUIRE(pool.get_last_active(2) == 3);
+    pool.mark_active(0, 9);
+    pool.mark_active(3, 8);
+    pool.mark_active(3, 7);
+    REQUIRE(pool.get_last_active(3) == 8);
+
+    // at iteration 10, inactive for more than 4: created at 1..5 and never marked
+    std::vector<size_t> inactive = pool.inactive_cuts(10, 4);
+    REQUIRE(inactive == std::vector<size_t>{1, 2, 4});
+
+    pool.remove(inactive);
+    REQUIRE(pool.size() == 3);
+    REQUIRE(pool.get_iteration(0) == 1);
+    REQUIRE(pool.get_iteration(1) == 4);
+    REQUIRE(pool.get_iteration(2) == 6);
+    REQUIRE(pool.get_last_active(1) == 8);
+    REQUIRE(pool.get_epigraph(2) == 0);
+
+    // scaled by the creation iteration: t * (t, 2t, 3t) for t = 4
+    REQUIRE(pool.get_scaled_alpha(1) == 16.0);
+    REQUIRE(pool.get_scaled_beta(1)[2] == 48.0);
+
+    REQUIRE_THROWS(pool.remove({5}));
+}
+
+TEST_CASE("CutPool batch evaluation", "[CutPool]")
+{
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    // dimensions that are not a multiple of the padding, below and above
+    // BATCH_MIN_DIM, and a point count that leaves a short last block
+    const size_t dim = GENERATE(size_t(13), size_t(45)), npoints = 23;
+    const uint64_t k = 40;
+    CutPool pool(dim);
+    for (uint64_t t = 1; t <= k; ++t)
+    {
+        Cut cut{dist(rng), std::vector<double>(dim)};
+        for (double &b : cut.beta)
+            b = dist(rng);
+        pool.add(cut, t);
+    }
+
+    std::vector<double> points(npoints * dim);
+    for (double &v : points)
+        v = dist(rng);
+
+    std::vector<double> exact, fast;
+    std::vector<size_t> exact_index, fast_index;
+    pool.max_values(points, k, exact, exact_index);
+    pool.max_values(points, k, fast, fast_index, CutPool::Precision::FLOAT);
+    REQUIRE(exact.size() == npoints);
+
+    for (size_t p = 0; p < npoints; ++p)
+    {
+        std::vector<double> x(points.begin() + p * dim, points.begin() + (p + 1) * dim);
+        size_t index;
+        double expected = pool.max_value(x, k, index);
+        REQUIRE(exact[p] == Approx(expected).epsilon(1e-14));
+        REQUIRE(exact_index[p] == index);
+        REQUIRE(fast[p] == Approx(expected).epsilon(1e-5));
+        // the float winner is within float error of the best cut
+        REQUIRE(CutHelper::evaluate(pool.get_cut(fast_index[p], k), x) == Approx(expected).epsilon(1e-5));
+    }
+
+    SECTION("an empty pool")
+    {
+        CutPool empty(dim);
+        empty.max_values(points, k, exact, exact_index);
+        REQUIRE(exact[0] == -std::numeric_limits<double>::infinity());
+        REQUIRE(exact_index[0] == 0);
+    }
+}
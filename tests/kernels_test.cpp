@@ -0,0 +1,58 @@
+#define CATCH_CONFIG_MAIN
+#include "../external/catch_amalgamated.hpp"
+#include "kernels.h"
+#include <random>
+#include <vector>
+
+using Catch::Approx;
+
+TEST_CASE("Fixed dimension kernels match the generic loops", "[kernels]")
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> dist(-10.0, 10.0);
+
+    // covers every fixed size and a few sizes on the generic path
+    for (size_t n = 1; n <= kernels::MAX_FIXED_DIM + 8; ++n)
+    {
+        CAPTURE(n);
+        std::vector<double> a(n), b(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            a[i] = dist(rng);
+            b[i] = dist(rng);
+        }
+
+        double expected_ab = 0.0, expected_aa = 0.0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            expected_ab += a[i] * b[i];
+            expected_aa += a[i] * a[i];
+        }
+
+        REQUIRE(kernels::dot(a.data(), b.data(), n) == Approx(expected_ab));
+
+        double gd, gg;
+        kernels::dot_and_norm(a.data(), b.data(), n, gd, gg);
+        REQUIRE(gd == Approx(expected_ab));
+        REQUIRE(gg == Approx(expected_aa));
+
+        REQUIRE(kernels::evaluate_cut(3.0, a.data(), b.data(), n) == Approx(3.0 - expected_ab));
+
+        std::vector<double> d(b), expected_d(n);
+        double expected_dd = 0.0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            expected_d[i] = 0.25 * b[i] + 0.75 * a[i];
+            expected_dd += expected_d[i] * expected_d[i];
+        }
+        double dd = kernels::update_direction(d.data(), a.data(), 0.25, n);
+        for (size_t i = 0; i < n; ++i)
+            REQUIRE(d[i] == Approx(expected_d[i]));
+        REQUIRE(dd == Approx(expected_dd));
+
+        std::vector<double> acc(b);
+        kernels::accumulate(acc.data(), a.data(), -2.0, n);
+        for (size_t i = 0; i < n; ++i)
+            REQUIRE(acc[i] == Approx(b[i] - 2.0 * a[i]));
+    }
+}
@@ -0,0 +1,174 @@
+#define CATCH_CONFIG_MAIN
+#include "../external/catch_amalgamated.hpp"
+
+#include "master.h"
+#include "smps.h"
+#include <limits>
+
+using Catch::Approx;
+
+// lands first stage: min 10 x1 + 7 x2 + 16 x3 + 6 x4
+// s.t. x1 + x2 + x3 + x4 >= 12, 10 x1 + 7 x2 + 16 x3 + 6 x4 <= 120
+TEST_CASE("Master problem keeps its cuts in sync", "[StageMasterProblem]")
+{
+    smps::SMPSCore cor("tests/lands/lands.cor");
+    smps::SMPSImplicitTime tim("tests/lands/lands.tim");
+    smps::SMPSStoch sto("tests/lands/lands.sto");
+
+    StageMasterProblem master(cor, tim, sto);
+    master.attach_solver();
+
+    auto num_constrs = [&]()
+    {
+        int n = 0;
+        GRBgetintattr(master.get_model(), GRB_INT_ATTR_NUMCONSTRS, &n);
+        return n;
+    };
+
+    // without cuts eta sits at its lower bound
+    auto sol = master.solve_master();
+    REQUIRE(sol.obj_value == Approx(72.0));
+
+    // theta >= 1000 at iteration 1
+    master.add_cut(Cut{1000.0, std::vector<double>(4, 0.0)}, 1);
+    sol = master.solve_master();
+    REQUIRE(num_constrs() == 3);
+    REQUIRE(sol.obj_value == Approx(1072.0));
+
+    // aging only changes the objective: theta >= 1000 / 2
+    master.set_iteration(2);
+    sol = master.solve_master();
+    REQUIRE(num_constrs() == 3);
+    REQUIRE(sol.obj_value == Approx(572.0));
+    REQUIRE(master.get_epigraph_values()[0] == Approx(1000.0));
+
+    // a dominated cut created at iteration 2 stays slack
+    master.add_cut(Cut{10.0, std::vector<double>(4, 0.0)}, 2);
+    sol = master.solve_master();
+    REQUIRE(num_constrs() == 4);
+
+    for (uint64_t k = 3; k <= 6; ++k)
+    {
+        master.set_iteration(k);
+        sol = master.solve_master();
+    }
+    REQUIRE(sol.obj_value == Approx(72.0 + 1000.0 / 6.0));
+
+    // at iteration 6 the second cut is inactive for 4 iterations
+    REQUIRE(master.remove_inactive_cuts(3) == 1);
+    REQUIRE(master.get_cut_pool().size() == 1);
+    REQUIRE(num_constrs() == 3);
+    sol = master.solve_master();
+    REQUIRE(sol.obj_value == Approx(72.0 + 1000.0 / 6.0));
+
+    SECTION("cuts follow x_base")
+    {
+        // theta >= 2000 - 100 x4 at iteration 6, optimal at x4 = 110 / 6
+        master.add_cut(Cut{2000.0, {0.0, 0.0, 0.0, 100.0}}, 6);
+        sol = master.solve_master();
+        REQUIRE(sol.solution[3] == Approx(110.0 / 6.0));
+        double unshifted = sol.obj_value;
+
+        // the same point in d-space
+        master.set_x_base({0.0, 0.0, 0.0, 12.0});
+        sol = master.solve_master();
+        REQUIRE(sol.obj_value == Approx(unshifted));
+        REQUIRE(sol.solution[3] == Approx(110.0 / 6.0 - 12.0));
+    }
+}
+
+TEST_CASE("Master problem replaces the cuts of one epigraph variable", "[StageMasterProblem]")
+{
+    smps::SMPSCore cor("tests/lands/lands.cor");
+    smps::SMPSImplicitTime tim("tests/lands/lands.tim");
+    smps::SMPSStoch sto("tests/lands/lands.sto");
+
+    // 0.5 theta_0 + 0.5 theta_1
+    StageMasterProblem master(cor, tim, sto, 2);
+    master.attach_solver();
+    master.set_epigraph_weights({0.5, 0.5});
+
+    master.add_cut(Cut{100.0, std::vector<double>(4, 0.0)}, 1, 0);
+    master.add_cut(Cut{200.0, std::vector<double>(4, 0.0)}, 1, 1);
+    master.add_cut(Cut{300.0, std::vector<double>(4, 0.0)}, 1, 0);
+    auto sol = master.solve_master();
+    REQUIRE(sol.obj_value == Approx(72.0 + 150.0 + 100.0));
+
+    REQUIRE(master.remove_epigraph_cuts(0) == 2);
+    REQUIRE(master.get_cut_pool().size() == 1);
+    master.add_cut(Cut{50.0, std::vector<double>(4, 0.0)}, 1, 0);
+    sol = master.solve_master();
+    REQUIRE(sol.obj_value == Approx(72.0 + 25.0 + 100.0));
+
+    REQUIRE_THROWS(master.remove_epigraph_cuts(2));
+}
+
+TEST_CASE("Master problem keeps x in a trust region and unaged cuts active", "[StageMasterProblem]")
+{
+    smps::SMPSCore cor("tests/lands/lands.cor");
+    smps::SMPSImplicitTime tim("tests/lands/lands.tim");
+    smps::SMPSStoch sto("tests/lands/lands.sto");
+
+    StageMasterProblem master(cor, tim, sto);
+    master.attach_solver();
+    REQUIRE_THROWS(master.set_trust_region(1.0));
+
+    // x in [2, 4]^4 around (3, 3, 3, 3): the cheapest has x = (2, 4, 2, 4), cost 104
+    std::vector<double> center(4, 3.0);
+    master.set_x_base(center);
+    master.set_trust_region(1.0);
+    auto sol = master.solve_master();
+    std::vector<double> expected{-1.0, 1.0, -1.0, 1.0};
+    for (size_t j = 0; j < 4; ++j)
+        REQUIRE(sol.solution[j] == Approx(expected[j]).margin(1e-6));
+
+    // without the trust region the first stage bounds are back
+    master.unset_x_base();
+    master.set_trust_region(std::numeric_limits<double>::infinity());
+    sol = master.solve_master();
+    REQUIRE(sol.obj_value == Approx(72.0));
+
+    // cuts stay unaged at iteration 1 while their activity is counted at 10
+    master.set_activity_iteration(10);
+    master.add_cut(Cut{100.0, std::vector<double>(4, 0.0)}, 1);
+    REQUIRE(master.remove_inactive_cuts(0) == 0);
+    sol = master.solve_master();
+    REQUIRE(sol.obj_value == Approx(72.0 + 100.0));
+    master.set_activity_iteration(11);
+    REQUIRE(master.remove_inactive_cuts(1) == 0);
+    master.set_activity_iteration(12);
+    REQUIRE(master.remove_inactive_cuts(1) == 1);
+}
+
+TEST_CASE("Master problem ages cuts towards a nonzero epigraph bound", "[StageMasterProblem]")
+{
+    smps::SMPSCore cor("tests/lands/lands.cor");
+    smps::SMPSImplicitTime tim("tests/lands/lands.tim");
+    smps::SMPSStoch sto("tests/lands/lands.sto");
+
+    // without cuts theta sits at -50 at every iteration
+    StageMasterProblem master(cor, tim, sto, 1, -50.0);
+    master.attach_solver();
+    auto sol = master.solve_master();
+    REQUIRE(sol.obj_value == Approx(72.0 - 50.0));
+
+    // theta >= 100 from iteration 1
+    master.add_cut(Cut{100.0, std::vector<double>(4, 0.0)}, 1);
+    sol = master.solve_master();
+    REQUIRE(sol.obj_value == Approx(72.0 + 100.0));
+    REQUIRE(master.get_epigraph_values()[0] == Approx(100.0));
+
+    // at iteration 4 the cut is theta >= 100 / 4 - 50 * 3 / 4
+    master.set_iteration(4);
+    sol = master.solve_master();
+    REQUIRE(sol.obj_value == Approx(72.0 - 12.5));
+    REQUIRE(master.get_epigraph_values()[0] == Approx(4 * -12.5));
+
+    // without a bound the cuts cannot age
+    StageMasterProblem unbounded(cor, tim, sto, 1, -std::numeric_limits<double>::infinity());
+    unbounded.attach_solver();
+    unbounded.add_cut(Cut{100.0, std::vector<double>(4, 0.0)}, 1);
+    sol = unbounded.solve_master();
+    REQUIRE(sol.obj_value == Approx(72.0 + 100.0));
+    REQUIRE_THROWS(unbounded.set_iteration(2));
+}
@@ -21,7 +21,7 @@ TEST_CASE("Test Setup for Problem", "[StageProblem]")
         // last stage vars: none
         // current stage vars: X1 X2 X3 X4
         // current stage rows names: S1C1 S1C2
-        // transfer block (empty) (test use transfer_block.nnz() == 0)
+        // transfer block (empty) (test use transfer_block->nnz() == 0)
         // direction: G, L
         // current block
         // (0, 0) => 1.0    // S1C1 X1
@@ -56,21 +56,21 @@ TEST_CASE("Test Setup for Problem", "[StageProblem]")
         REQUIRE(prob.current_stage_row_names == std::vector<std::string>{"S1C1", "S1C2"});
 
         // Check transfer block (empty)
-        REQUIRE(prob.transfer_block.nnz() == 0);
+        REQUIRE(prob.transfer_block->nnz() == 0);
 
         // Check directions
         REQUIRE(prob.inequality_directions == std::vector<char>{'G', 'L'});
 
         // Check current block
-        REQUIRE(prob.current_block.nnz() == 8);
-        CHECK(prob.current_block.get_element(0, 0) == 1.0);  // S1C1 X1
-        CHECK(prob.current_block.get_element(0, 1) == 1.0);  // S1C1 X2
-        CHECK(prob.current_block.get_element(0, 2) == 1.0);  // S1C1 X3
-        CHECK(prob.current_block.get_element(0, 3) == 1.0);  // S1C1 X4
-        CHECK(prob.current_block.get_element(1, 0) == 10.0); // S1C2 X1
-        CHECK(prob.current_block.get_element(1, 1) == 7.0);  // S1C2 X2
-        CHECK(prob.current_block.get_element(1, 2) == 16.0); // S1C2 X3
-        CHECK(prob.current_block.get_element(1, 3) == 6.0);  // S1C2 X4
+        REQUIRE(prob.current_block->nnz() == 8);
+        CHECK(prob.current_block->get_element(0, 0) == 1.0);  // S1C1 X1
+        CHECK(prob.current_block->get_element(0, 1) == 1.0);  // S1C1 X2
+        CHECK(prob.current_block->get_element(0, 2) == 1.0);  // S1C1 X3
+        CHECK(prob.current_block->get_element(0, 3) == 1.0);  // S1C1 X4
+        CHECK(prob.current_block->get_element(1, 0) == 10.0); // S1C2 X1
+        CHECK(prob.current_block->get_element(1, 1) == 7.0);  // S1C2 X2
+        CHECK(prob.current_block->get_element(1, 2) == 16.0); // S1C2 X3
+        CHECK(prob.current_block->get_element(1, 3) == 6.0);  // S1C2 X4
 
         // Check lower bounds
         REQUIRE(prob.lb == std::vector<double>{0.0, 0.0, 0.0, 0.0});
@@ -161,41 +161,41 @@ TEST_CASE("Test Setup for Problem", "[StageProblem]")
                                                   "S2C1", "S2C2", "S2C3", "S2C4", "S2C5", "S2C6", "S2C7"});
 
         // Check transfer block
-        CHECK(prob.transfer_block.nnz() == 4);
-        CHECK(prob.transfer_block.get_element(0, 0) == -1.0);
-        CHECK(prob.transfer_block.get_element(1, 1) == -1.0);
-        CHECK(prob.transfer_block.get_element(2, 2) == -1.0);
-        CHECK(prob.transfer_block.get_element(3, 3) == -1.0);
+        CHECK(prob.transfer_block->nnz() == 4);
+        CHECK(prob.transfer_block->get_element(0, 0) == -1.0);
+        CHECK(prob.transfer_block->get_element(1, 1) == -1.0);
+        CHECK(prob.transfer_block->get_element(2, 2) == -1.0);
+        CHECK(prob.transfer_block->get_element(3, 3) == -1.0);
 
         // Check directions
         CHECK(prob.inequality_directions == std::vector<char>{'L', 'L', 'L', 'L', 'G', 'G', 'G'});
 
         // Check current block
-        REQUIRE(prob.current_block.nnz() == 24); // Expecting 24 non-zero elements
-        CHECK(prob.current_block.get_element(0, 0) == 1.0);
-        CHECK(prob.current_block.get_element(4, 0) == 1.0);
-        CHECK(prob.current_block.get_element(1, 1) == 1.0);
-        CHECK(prob.current_block.get_element(4, 1) == 1.0);
-        CHECK(prob.current_block.get_element(2, 2) == 1.0);
-        CHECK(prob.current_block.get_element(4, 2) == 1.0);
-        CHECK(prob.current_block.get_element(3, 3) == 1.0);
-        CHECK(prob.current_block.get_element(4, 3) == 1.0);
-        CHECK(prob.current_block.get_element(0, 4) == 1.0);
-        CHECK(prob.current_block.get_element(5, 4) == 1.0);
-        CHECK(prob.current_block.get_element(1, 5) == 1.0);
-        CHECK(prob.current_block.get_element(5, 5) == 1.0);
-        CHECK(prob.current_block.get_element(2, 6) == 1.0);
-        CHECK(prob.current_block.get_element(5, 6) == 1.0);
-        CHECK(prob.current_block.get_element(3, 7) == 1.0);
-        CHECK(prob.current_block.get_element(5, 7) == 1.0);
-        CHECK(prob.current_block.get_element(0, 8) == 1.0);
-        CHECK(prob.current_block.get_element(6, 8) == 1.0);
-        CHECK(prob.current_block.get_element(1, 9) == 1.0);
-        CHECK(prob.current_block.get_element(6, 9) == 1.0);
-        CHECK(prob.current_block.get_element(2, 10) == 1.0);
-        CHECK(prob.current_block.get_element(6, 10) == 1.0);
-        CHECK(prob.current_block.get_element(3, 11) == 1.0);
-        CHECK(prob.current_block.get_element(6, 11) == 1.0);
+        REQUIRE(prob.current_block->nnz() == 24); // Expecting 24 non-zero elements
+        CHECK(prob.current_block->get_element(0, 0) == 1.0);
+        CHECK(prob.current_block->get_element(4, 0) == 1.0);
+        CHECK(prob.current_block->get_element(1, 1) == 1.0);
+        CHECK(prob.current_block->get_element(4, 1) == 1.0);
+        CHECK(prob.current_block->get_element(2, 2) == 1.0);
+        CHECK(prob.current_block->get_element(4, 2) == 1.0);
+        CHECK(prob.current_block->get_element(3, 3) == 1.0);
+        CHECK(prob.current_block->get_element(4, 3) == 1.0);
+        CHECK(prob.current_block->get_element(0, 4) == 1.0);
+        CHECK(prob.current_block->get_element(5, 4) == 1.0);
+        CHECK(prob.current_block->get_element(1, 5) == 1.0);
+        CHECK(prob.current_block->get_element(5, 5) == 1.0);
+        CHECK(prob.current_block->get_element(2, 6) == 1.0);
+        CHECK(prob.current_block->get_element(5, 6) == 1.0);
+        CHECK(prob.current_block->get_element(3, 7) == 1.0);
+        CHECK(prob.current_block->get_element(5, 7) == 1.0);
+        CHECK(prob.current_block->get_element(0, 8) == 1.0);
+        CHECK(prob.current_block->get_element(6, 8) == 1.0);
+        CHECK(prob.current_block->get_element(1, 9) == 1.0);
+        CHECK(prob.current_block->get_element(6, 9) == 1.0);
+        CHECK(prob.current_block->get_element(2, 10) == 1.0);
+        CHECK(prob.current_block->get_element(6, 10) == 1.0);
+        CHECK(prob.current_block->get_element(3, 11) == 1.0);
+        CHECK(prob.current_block->get_element(6, 11) == 1.0);
 
         // Check lower bounds
         CHECK(prob.lb == std::vector<double>(12, 0.0));
@@ -249,6 +249,52 @@ TEST_CASE("Test Setup for Problem", "[StageProblem]")
         CHECK(current_rhs == expected_rhs);
     }
 
+    SECTION("copies share the coefficient blocks")
+    {
+        StageProblem prob(cor, tim, sto, 1);
+        StageProblem worker(prob);
+
+        // no matrix copies: both problems point at the same arrays
+        REQUIRE(worker.current_block_csr == prob.current_block_csr);
+        REQUIRE(worker.transfer_block_csr == prob.transfer_block_csr);
+        REQUIRE(worker.current_block == prob.current_block);
+        REQUIRE(worker.transfer_block == prob.transfer_block);
+        REQUIRE(prob.current_block_csr->nnz() == prob.current_block->nnz());
+
+        worker.attach_solver();
+        int num_constrs = 0;
+        GRBgetintattr(worker.get_model(), GRB_INT_ATTR_NUMCONSTRS, &num_constrs);
+        CHECK(num_constrs == static_cast<int>(prob.nrows));
+    }
+
+    SECTION("solve into a reused solution")
+    {
+        StageProblem prob(cor, tim, sto, 1);
+        prob.attach_solver();
+
+        StageProblem::Solution reused;
+        for (double omega : {3.0, 7.0, 3.0})
+        {
+            prob.update_solver_with_scenario({3.0, 3.0, 3.0, 3.0}, {omega});
+            for (bool sparse : {false, true})
+            {
+                auto expected = prob.solve_problem(true, sparse);
+                prob.solve_problem(reused, true, sparse);
+                CHECK(reused.obj_value == expected.obj_value);
+                CHECK(reused.solution == expected.solution);
+                CHECK(reused.dual_is_sparse == expected.dual_is_sparse);
+                CHECK(reused.dual_solution == expected.dual_solution);
+                CHECK(reused.sparse_dual_solution.index == expected.sparse_dual_solution.index);
+                CHECK(reused.sparse_dual_solution.value == expected.sparse_dual_solution.value);
+            }
+        }
+
+        // a solve without duals clears them
+        prob.solve_problem(reused);
+        CHECK(reused.dual_solution.empty());
+        CHECK_FALSE(reused.dual_is_sparse);
+    }
+
     SECTION("set x_base")
     {
         StageProblem prob(cor, tim, sto, 0);
@@ -306,16 +352,16 @@ TEST_CASE("SMPS integrated test on lgsc instance", "[StageProblem]")
     REQUIRE(prob1.nvars_current == 1480);
 
     // prob0: current block (174, 602)
-    REQUIRE(prob0.current_block.get_num_rows() == 174);
-    REQUIRE(prob0.current_block.get_num_cols() == 602);
+    REQUIRE(prob0.current_block->get_num_rows() == 174);
+    REQUIRE(prob0.current_block->get_num_cols() == 602);
 
     // prob1: current block (348, 1480)
-    REQUIRE(prob1.current_block.get_num_rows() == 348);
-    REQUIRE(prob1.current_block.get_num_cols() == 1480);
+    REQUIRE(prob1.current_block->get_num_rows() == 348);
+    REQUIRE(prob1.current_block->get_num_cols() == 1480);
 
     // prob1: transfer block (348, 602)
-    REQUIRE(prob1.transfer_block.get_num_rows() == 348);
-    REQUIRE(prob1.transfer_block.get_num_cols() == 602);
+    REQUIRE(prob1.transfer_block->get_num_rows() == 348);
+    REQUIRE(prob1.transfer_block->get_num_cols() == 602);
 
     StochasticPattern patt = StochasticPattern::from_smps(cor, tim, sto);
 
@@ -0,0 +1,42 @@
+#define CATCH_CONFIG_MAIN
+#include "../external/catch_amalgamated.hpp"
+
+#include "scheduler.h"
+#include <atomic>
+#include <omp.h>
+#include <stdexcept>
+#include <vector>
+
+TEST_CASE("Every task runs once, on the thread passed to it", "[parallel_sweep]")
+{
+    for (size_t ntasks : {0, 1, 3, 4, 5, 100, 1001})
+    {
+        std::vector<std::atomic<int>> runs(ntasks);
+        std::atomic<bool> thread_mismatch(false);
+        parallel_sweep(4, ntasks, [&](int t, size_t task)
+        {
+            if (t != omp_get_thread_num() || t < 0 || t >= 4)
+                thread_mismatch = true;
+            ++runs[task];
+        });
+        REQUIRE_FALSE(thread_mismatch);
+        for (auto &r : runs)
+            REQUIRE(r.load() == 1);
+    }
+}
+
+TEST_CASE("An exception in a task is rethrown", "[parallel_sweep]")
+{
+    REQUIRE_THROWS_AS(parallel_sweep(3, 50, [](int, size_t task)
+    {
+        if (task == 17)
+            throw std::runtime_error("task failed");
+    }), std::runtime_error);
+
+    // later sweeps are not affected
+    std::atomic<size_t> count(0);
+    parallel_sweep(3, 10, [&](int, size_t) { ++count; });
+    REQUIRE(count == 10);
+
+    REQUIRE_THROWS_AS(parallel_sweep(0, 10, [](int, size_t) {}), std::runtime_error);
+}
@@ -106,4 +106,24 @@ TEST_CASE("SMPS STO file parsing", "[SMPSStoch]") {
     // std::cout << sto_transship.summary() << std::endl;
     auto scenario2 = sto_transship.generate_scenario(rng);
     REQUIRE(scenario2.size() == 7);
+}
+
+TEST_CASE("SMPS STO scenario enumeration", "[SMPSStoch]") {
+    smps::SMPSStoch sto("tests/lands/lands.sto");
+
+    auto scenarios = sto.enumerate_scenarios(100);
+    REQUIRE(scenarios.size() == 3);
+    REQUIRE(scenarios[0].omega == std::vector<double>{3.0});
+    REQUIRE(scenarios[1].omega == std::vector<double>{5.0});
+    REQUIRE(scenarios[2].omega == std::vector<double>{7.0});
+    REQUIRE(scenarios[0].probability == Approx(0.3));
+    REQUIRE(scenarios[1].probability == Approx(0.4));
+    REQUIRE(scenarios[2].probability == Approx(0.3));
+
+    // over the limit
+    REQUIRE(sto.enumerate_scenarios(2).empty());
+
+    // normal elements have no finite support
+    smps::SMPSStoch sto_transship("tests/transship/transship.sto");
+    REQUIRE(sto_transship.enumerate_scenarios(1000).empty());
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #define CATCH_CONFIG_MAIN
 #include "../external/catch_amalgamated.hpp"
 #include "sparse.h"
+#include <random>
+#include <omp.h>
 
 using Catch::Approx;
 
@@ -108,4 +110,159 @@ TEST_CASE("SparseMatrix<double> and CSR format functionality", "[SparseMatrix][C
         REQUIRE(csrMatrix.getValues()[1] == Approx(2.0));
         REQUIRE(csrMatrix.getValues()[2] == Approx(3.0));
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("SparseMatrix index width and mixed value types", "[SparseMatrix][CSR]")
+{
+    std::vector<int64_t> row_indices = {0, 1, 2};
+    std::vector<int64_t> col_indices = {1, 0, 2};
+    std::vector<double> values = {1.0, 2.0, 3.0};
+    SparseMatrix<double, int64_t> matrix(row_indices, col_indices, values, 3, 3);
+
+    SECTION("64-bit index matrix")
+    {
+        REQUIRE(matrix.get_element(2, 2) == Approx(3.0));
+
+        std::vector<double> vec = {1.0, 2.0, 3.0};
+        std::vector<double> result;
+        matrix.multiply_with_vector(vec, result);
+        REQUIRE(result[0] == Approx(2.0));
+        REQUIRE(result[1] == Approx(2.0));
+        REQUIRE(result[2] == Approx(9.0));
+
+        SparseMatrixCSR csrMatrix(matrix);
+        REQUIRE(csrMatrix.getRowBegin() == std::vector<int64_t>{0, 1, 2, 3});
+        REQUIRE(csrMatrix.getColumnIndex() == std::vector<int64_t>{1, 0, 2});
+    }
+
+    SECTION("float storage with double products")
+    {
+        SparseMatrix<float> compact(matrix);
+        REQUIRE(compact.nnz() == 3);
+        REQUIRE(compact.get_element(1, 0) == Approx(2.0f));
+
+        std::vector<double> vec = {1.0, 2.0, 3.0};
+        std::vector<double> result;
+        compact.multiply_transpose_with_vector(vec, result);
+        REQUIRE(result[0] == Approx(4.0));
+        REQUIRE(result[1] == Approx(1.0));
+        REQUIRE(result[2] == Approx(9.0));
+
+        SparseMatrixCSR<double, int32_t> csrMatrix(compact);
+        REQUIRE(csrMatrix.getValues()[2] == Approx(3.0));
+    }
+
+    SECTION("dimensions that do not fit in the index type")
+    {
+        SparseMatrix<double> small;
+        REQUIRE_THROWS_AS(small.resize(size_t(1) << 32, 1), std::overflow_error);
+        REQUIRE_NOTHROW(matrix.resize(size_t(1) << 32, 1));
+    }
+}
+
+
+TEST_CASE("SparseMatrixCSR products", "[CSR]")
+{
+    // large enough to take the parallel path, with uneven rows
+    const size_t nrows = 3000, ncols = 500;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> col_dist(0, ncols - 1);
+    std::uniform_real_distribution<double> val_dist(-1.0, 1.0);
+
+    SparseMatrix<double> matrix;
+    matrix.resize(nrows, ncols);
+    for (size_t r = 0; r < nrows; ++r)
+    {
+        // every 10th row is dense-ish
+        size_t row_nnz = (r % 10 == 0) ? 200 : 20;
+        for (size_t k = 0; k < row_nnz; ++k)
+            matrix.add_element(r, col_dist(rng), val_dist(rng));
+    }
+    REQUIRE(matrix.nnz() >= SparseMatrixCSR<double>::PARALLEL_NNZ_THRESHOLD);
+
+    std::vector<double> x(ncols), y(nrows);
+    for (auto &v : x) v = val_dist(rng);
+    for (auto &v : y) v = val_dist(rng);
+
+    std::vector<double> expected_ax, expected_aty;
+    matrix.multiply_with_vector(x, expected_ax);
+    matrix.multiply_transpose_with_vector(y, expected_aty);
+
+    SparseMatrixCSR csrMatrix(matrix);
+
+    int saved_threads = omp_get_max_threads();
+    for (int nthreads : {1, 4})
+    {
+        omp_set_num_threads(nthreads);
+        CAPTURE(nthreads);
+        CHECK(csrMatrix.use_parallel() == (nthreads > 1));
+
+        std::vector<double> ax, aty;
+        csrMatrix.multiply_with_vector(x, ax);
+        csrMatrix.multiply_transpose_with_vector(y, aty);
+
+        REQUIRE(ax.size() == nrows);
+        REQUIRE(aty.size() == ncols);
+        for (size_t r = 0; r < nrows; ++r)
+            REQUIRE(ax[r] == Approx(expected_ax[r]).margin(1e-9));
+        for (size_t c = 0; c < ncols; ++c)
+            REQUIRE(aty[c] == Approx(expected_aty[c]).margin(1e-9));
+
+        std::vector<double> residual(expected_ax);
+        csrMatrix.subtract_multiply_with_vector(x, residual);
+        for (size_t r = 0; r < nrows; ++r)
+            REQUIRE(residual[r] == Approx(0.0).margin(1e-9));
+
+        // never parallel from inside a worker thread
+        bool nested_parallel = true;
+        #pragma omp parallel num_threads(2)
+        {
+            #pragma omp single
+            nested_parallel = csrMatrix.use_parallel();
+        }
+        CHECK_FALSE(nested_parallel);
+    }
+    omp_set_num_threads(saved_threads);
+}
+
+TEST_CASE("SparseVector and sparse transposed product", "[SparseVector][CSR]")
+{
+    std::vector<double> dense = {0.0, 2.0, 0.0, 0.0, -1.5, 1e-14};
+    auto vec = SparseVector<double>::from_dense(dense, 1e-12);
+
+    REQUIRE(vec.dim == 6);
+    REQUIRE(vec.nnz() == 2);
+    REQUIRE(vec.index == std::vector<int32_t>{1, 4});
+    REQUIRE(vec.density() == Approx(2.0 / 6.0));
+
+    std::vector<double> expected_dense = {0.0, 2.0, 0.0, 0.0, -1.5, 0.0};
+    REQUIRE(vec.to_dense() == expected_dense);
+
+    // 5 x 3 matrix, the last entry of vec is past the last row and is ignored
+    SparseMatrix<double> matrix({0, 1, 1, 4, 4}, {0, 1, 2, 0, 2}, {1.0, 2.0, 3.0, 4.0, 5.0}, 5, 3);
+    SparseMatrixCSR csrMatrix(matrix);
+
+    std::vector<double> expected, result;
+    csrMatrix.multiply_transpose_with_vector(expected_dense, expected);
+    csrMatrix.multiply_transpose_with_vector(vec, result);
+
+    REQUIRE(result.size() == 3);
+    for (size_t i = 0; i < result.size(); ++i)
+        REQUIRE(result[i] == Approx(expected[i]));
+}
+
+TEST_CASE("CSR accumulating transpose products", "[CSR]")
+{
+    // 3 x 2 matrix [[1, 0], [2, 3], [0, 4]]
+    SparseMatrix<double> matrix({0, 1, 1, 2}, {0, 0, 1, 1}, {1.0, 2.0, 3.0, 4.0}, 3, 2);
+    SparseMatrixCSR csrMatrix(matrix);
+
+    std::vector<double> y1 = {1.0, 0.0, 2.0}, y2 = {0.0, -1.0, 1.0};
+    std::vector<double> sum(2, 0.0);
+    csrMatrix.add_multiply_transpose_with_vector(y1, sum);
+    csrMatrix.add_multiply_transpose_with_vector(SparseVector<double>::from_dense(y2), sum);
+
+    // A^T (y1 + y2) = A^T [1, -1, 3] = [1 - 2, -3 + 12]
+    REQUIRE(sum[0] == Approx(-1.0));
+    REQUIRE(sum[1] == Approx(9.0));
+}
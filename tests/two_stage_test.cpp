@@ -0,0 +1,225 @@
+#define CATCH_CONFIG_MAIN
+#include "../external/catch_amalgamated.hpp"
+
+#include "two_stage.h"
+#include <cmath>
+
+// lands first stage: x1 + x2 + x3 + x4 >= 12, 10 x1 + 7 x2 + 16 x3 + 6 x4 <= 120, x >= 0
+TEST_CASE("SD returns a feasible first stage solution", "[TwoStageSD]")
+{
+    TwoStageSD::Options options;
+    options.max_iterations = 60;
+    options.min_iterations = 10;
+    options.samples_per_iteration = 2;
+
+    TwoStageSD sp("tests", "lands", 2, options);
+    sp.solve();
+
+    const auto &x = sp.get_incumbent();
+    REQUIRE(x.size() == 4);
+    for (double xj : x)
+        REQUIRE(xj >= -1e-6);
+    REQUIRE(x[0] + x[1] + x[2] + x[3] >= 12.0 - 1e-6);
+    REQUIRE(10 * x[0] + 7 * x[1] + 16 * x[2] + 6 * x[3] <= 120.0 + 1e-6);
+
+    REQUIRE(sp.get_iterations() >= options.min_iterations);
+    REQUIRE(sp.get_iterations() <= options.max_iterations);
+    REQUIRE(sp.get_num_samples() == 2 * sp.get_iterations());
+
+    // the recourse is nonnegative, so the estimate is at least the first stage cost
+    REQUIRE(sp.get_incumbent_estimate() >= 10 * x[0] + 7 * x[1] + 16 * x[2] + 6 * x[3] - 1e-6);
+
+    const auto &timing = sp.get_timing();
+    REQUIRE(timing.total >= timing.subproblems + timing.master);
+}
+
+TEST_CASE("Independent approximations return a feasible first stage solution", "[TwoStageSD]")
+{
+    TwoStageIndependentSD::Options options;
+    options.napprox = 2;
+    options.max_sample_count = 2;
+    options.max_iterations = 40;
+    options.min_iterations = 10;
+    options.samples_per_iteration = 1;
+
+    TwoStageIndependentSD sp("tests", "lands", 2, options);
+    sp.solve();
+
+    const auto &x = sp.get_incumbent();
+    REQUIRE(x.size() == 4);
+    for (double xj : x)
+        REQUIRE(xj >= -1e-6);
+    REQUIRE(x[0] + x[1] + x[2] + x[3] >= 12.0 - 1e-6);
+    REQUIRE(10 * x[0] + 7 * x[1] + 16 * x[2] + 6 * x[3] <= 120.0 + 1e-6);
+    REQUIRE(sp.get_iterations() >= options.min_iterations);
+
+    // every approximation contributed at least once per max_sample_count + 1
+    // timestamps, and took at most max_sample_count steps per master update
+    auto counts = sp.get_sample_counts();
+    REQUIRE(counts.size() == 2);
+    for (uint64_t n : counts)
+    {
+        REQUIRE(n * (options.max_sample_count + 1) >= sp.get_iterations());
+        REQUIRE(n <= options.max_sample_count * (sp.get_iterations() + 1));
+    }
+}
+
+TEST_CASE("SD stops on the validation gap", "[TwoStageSD]")
+{
+    TwoStageSD::Options options;
+    options.max_iterations = 500;
+    options.min_iterations = 10;
+    options.tolerance = 0.0;
+    options.samples_per_iteration = 2;
+    options.validation_gap = 0.1;
+    options.validation.min_samples = 20;
+
+    TwoStageSD sp("tests", "lands", 2, options);
+    sp.solve();
+
+    REQUIRE(sp.get_validation().point_version > 0);
+    REQUIRE(sp.get_iterations() < options.max_iterations);
+    REQUIRE(sp.get_validation_gap() <= options.validation_gap);
+}
+
+TEST_CASE("SCS returns a feasible first stage solution", "[TwoStageSCS]")
+{
+    TwoStageSCS::Options options;
+    options.num_samples = 50;
+    options.max_iterations = 20;
+
+    TwoStageSCS sp("tests", "lands", 2, options);
+    sp.solve();
+
+    const auto &x = sp.get_solution();
+    REQUIRE(x.size() == 4);
+    for (double xj : x)
+        REQUIRE(xj >= -1e-6);
+    REQUIRE(x[0] + x[1] + x[2] + x[3] >= 12.0 - 1e-6);
+    REQUIRE(10 * x[0] + 7 * x[1] + 16 * x[2] + 6 * x[3] <= 120.0 + 1e-6);
+    REQUIRE(sp.get_iterations() <= options.max_iterations);
+
+    // the recourse is nonnegative
+    REQUIRE(sp.get_objective() >= 10 * x[0] + 7 * x[1] + 16 * x[2] + 6 * x[3] - 1e-6);
+}
+
+TEST_CASE("Speculative line search replays the bisection", "[TwoStageSCS]")
+{
+    // one worker sums the samples in the same order in both modes
+    TwoStageSCS::Options options;
+    options.num_samples = 30;
+    options.max_iterations = 10;
+
+    TwoStageSCS plain("tests", "lands", 1, options);
+    plain.solve();
+
+    options.speculation_depth = 3;
+    TwoStageSCS speculative("tests", "lands", 1, options);
+    speculative.solve();
+
+    REQUIRE(speculative.get_iterations() == plain.get_iterations());
+    REQUIRE(speculative.get_objective() == Catch::Approx(plain.get_objective()));
+    for (size_t j = 0; j < plain.get_solution().size(); ++j)
+        REQUIRE(speculative.get_solution()[j] == Catch::Approx(plain.get_solution()[j]).margin(1e-9));
+}
+
+TEST_CASE("SCS reuses a scenario solution while its basis stays optimal", "[TwoStageSCS]")
+{
+    TwoStageSCS::Options options;
+    options.num_samples = 30;
+    options.max_iterations = 10;
+    options.reuse_solutions = false;
+
+    TwoStageSCS fresh("tests", "lands", 1, options);
+    fresh.solve();
+    REQUIRE(fresh.get_sweep_stats().reuses == 0);
+
+    options.reuse_solutions = true;
+    TwoStageSCS reused("tests", "lands", 1, options);
+    reused.solve();
+    REQUIRE(reused.get_sweep_stats().reuses > 0);
+
+    // a reused cut is exact at the point, so only dual degeneracy can move the path
+    REQUIRE(reused.get_objective() == Catch::Approx(fresh.get_objective()).epsilon(1e-3));
+}
+
+// the three lands scenarios: the optimum is 381.853
+TEST_CASE("L-shaped solves the lands scenarios exactly", "[TwoStageLShaped]")
+{
+    TwoStageLShaped::Options options;
+
+    // multi-cut, single cut, multi-cut with a trust region and multi-cut
+    // without the nonnegative recourse assumption agree
+    for (int variant = 0; variant < 4; ++variant)
+    {
+        options.num_clusters = variant == 1 ? 1 : 0;
+        options.trust_region = variant == 2 ? 1.0 : 0.0;
+        options.recourse_lower_bound = variant == 3 ? -1e4 : 0.0;
+
+        TwoStageLShaped sp("tests", "lands", 2, options);
+        REQUIRE(sp.is_exact());
+        REQUIRE(sp.get_num_scenarios() == 3);
+        sp.solve();
+
+        const auto &x = sp.get_solution();
+        REQUIRE(x.size() == 4);
+        REQUIRE(x[0] + x[1] + x[2] + x[3] >= 12.0 - 1e-6);
+        REQUIRE(10 * x[0] + 7 * x[1] + 16 * x[2] + 6 * x[3] <= 120.0 + 1e-6);
+        REQUIRE(sp.get_iterations() < options.max_iterations);
+        REQUIRE(sp.get_objective() == Catch::Approx(381.853).margin(1e-2));
+        // the run stops on the gap to the best bound
+        if (variant != 2)
+        {
+            REQUIRE(sp.get_lower_bound() <= sp.get_objective() + 1e-6);
+            REQUIRE(sp.get_objective() - sp.get_lower_bound() <=
+                    options.tolerance * (1.0 + std::abs(sp.get_objective())));
+        }
+        else
+            REQUIRE(std::isinf(sp.get_lower_bound()));
+
+        const auto &timing = sp.get_timing();
+        REQUIRE(timing.total >= timing.subproblems + timing.master);
+    }
+}
+
+TEST_CASE("L-shaped falls back to a sample of a continuous distribution", "[TwoStageLShaped]")
+{
+    TwoStageLShaped::Options options;
+    options.num_samples = 20;
+    options.num_clusters = 4;
+
+    TwoStageLShaped sp("tests", "transship", 2, options);
+    REQUIRE_FALSE(sp.is_exact());
+    REQUIRE(sp.get_num_scenarios() == 20);
+    sp.solve();
+    REQUIRE(sp.get_lower_bound() <= sp.get_objective() + 1e-6 * (1.0 + std::abs(sp.get_objective())));
+}
+
+TEST_CASE("SCS grows the sample pool on high variance", "[TwoStageSCS]")
+{
+    TwoStageSCS::Options options;
+    options.num_samples = 10;
+    options.max_iterations = 20;
+
+    for (auto test : {TwoStageSCS::Options::SampleTest::NORM, TwoStageSCS::Options::SampleTest::INNER_PRODUCT})
+    {
+        options.max_samples = 200;
+        options.sample_test = test;
+        options.theta = 0.1;
+
+        TwoStageSCS sp("tests", "lands", 2, options);
+        sp.solve();
+
+        // with theta = 0.1 ten samples of the three demand levels are too few
+        REQUIRE(sp.get_num_samples() > options.num_samples);
+        REQUIRE(sp.get_num_samples() <= options.max_samples);
+        const auto &x = sp.get_solution();
+        REQUIRE(x[0] + x[1] + x[2] + x[3] >= 12.0 - 1e-6);
+    }
+
+    // without max_samples the pool stays fixed
+    options.max_samples = 0;
+    TwoStageSCS fixed("tests", "lands", 2, options);
+    fixed.solve();
+    REQUIRE(fixed.get_num_samples() == options.num_samples);
+}
@@ -0,0 +1,81 @@
+#define CATCH_CONFIG_MAIN
+#include "../external/catch_amalgamated.hpp"
+
+#include "validator.h"
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+
+TEST_CASE("RunningStats matches the two pass mean and variance", "[RunningStats]")
+{
+    RunningStats stats;
+    REQUIRE(stats.count() == 0);
+    REQUIRE(stats.variance() == 0.0);
+    REQUIRE(stats.std_error() == 0.0);
+
+    std::mt19937 rng(7);
+    // a large offset, where the naive sum of squares loses digits
+    std::normal_distribution<double> dist(1e6, 3.0);
+    std::vector<double> values(1000);
+    for (auto &v : values)
+    {
+        v = dist(rng);
+        stats.add(v);
+    }
+
+    double mean = 0.0;
+    for (double v : values)
+        mean += v;
+    mean /= values.size();
+    double ss = 0.0;
+    for (double v : values)
+        ss += (v - mean) * (v - mean);
+    double variance = ss / (values.size() - 1);
+
+    REQUIRE(stats.count() == values.size());
+    REQUIRE(stats.mean() == Catch::Approx(mean).epsilon(1e-12));
+    REQUIRE(stats.variance() == Catch::Approx(variance).epsilon(1e-8));
+    REQUIRE(stats.std_error() == Catch::Approx(std::sqrt(variance / values.size())).epsilon(1e-8));
+
+    stats.reset();
+    REQUIRE(stats.count() == 0);
+    stats.add(2.0);
+    REQUIRE(stats.mean() == 2.0);
+    REQUIRE(stats.variance() == 0.0);
+}
+
+// lands: the first stage cost of x = (3, 3, 3, 3) is 117
+TEST_CASE("Validator estimates f at the point and restarts on a new one", "[Validator]")
+{
+    ValidatorOptions options;
+    options.batch_size = 4;
+    options.min_samples = 20;
+
+    Validator validator("tests", "lands", 2, options);
+    REQUIRE(validator.dimension() == 4);
+    REQUIRE(std::isinf(validator.pessimistic_gap(0.0)));
+
+    std::vector<double> x(4, 3.0);
+    REQUIRE(validator.set_point(x));
+    REQUIRE_FALSE(validator.set_point(x));
+    validator.start();
+    while (validator.get_estimate().count < options.min_samples)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    auto estimate = validator.get_estimate();
+    REQUIRE(estimate.point_version == 1);
+    REQUIRE(estimate.mean >= 117.0 - 1e-6);
+    REQUIRE(estimate.lower <= estimate.mean);
+    REQUIRE(estimate.upper >= estimate.mean);
+    REQUIRE(validator.pessimistic_gap(estimate.upper) <= 1e-12);
+    REQUIRE(validator.pessimistic_gap(0.0) > 0.0);
+
+    // a new point drops the old statistics
+    x[0] = 4.0;
+    REQUIRE(validator.set_point(x));
+    estimate = validator.get_estimate();
+    REQUIRE(estimate.point_version == 2);
+    REQUIRE(estimate.count < options.min_samples);
+    validator.stop();
+}
@@ -1,6 +1,8 @@
 #define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() function
 #include "../external/catch_amalgamated.hpp"
 #include "vector_container.h"
+#include <algorithm>
+#include <thread>
 
 using Catch::Approx;
 
@@ -161,3 +163,245 @@ TEST_CASE("UniqueVectorContainer Insertion and Uniqueness", "[UniqueVectorContai
         CHECK_FALSE(pos.has_value());
     }
 }
+
+TEST_CASE("UniqueVectorContainer hashing", "[UniqueVectorContainer]") {
+
+    SECTION("Same 1-norm, different vectors") {
+        UniqueVectorContainer uvc(10, 3);
+        CHECK(uvc.insert(std::vector<float>{1.0f, 2.0f, 3.0f}).has_value());
+        CHECK(uvc.insert(std::vector<float>{3.0f, 2.0f, 1.0f}).has_value());
+        CHECK(uvc.insert(std::vector<float>{-1.0f, -2.0f, 3.0f}).has_value());
+        CHECK(uvc.size() == 3);
+    }
+
+    SECTION("Near duplicates across a cell boundary") {
+        UniqueVectorContainer uvc(10, 3);
+        const float boundary = static_cast<float>(UniqueVectorContainer::HASH_CELL_WIDTH);
+        const float eps = 0.4f * UniqueVectorContainer::TOLERANCE;
+
+        REQUIRE(uvc.insert(std::vector<float>{boundary - eps, 5.0f, -boundary + eps}).has_value());
+        // every coordinate within the tolerance, two of them in a different cell
+        CHECK_FALSE(uvc.insert(std::vector<float>{boundary + eps, 5.0f, -boundary - eps}).has_value());
+        // just outside the tolerance
+        CHECK(uvc.insert(std::vector<float>{boundary + 3 * eps, 5.0f, -boundary + eps}).has_value());
+    }
+
+    SECTION("Overwritten vectors leave the map") {
+        UniqueVectorContainer uvc(2, 2);
+        uvc.insert(std::vector<float>{1.0f, 1.0f});
+        uvc.insert(std::vector<float>{2.0f, 2.0f});
+        // overwrites (1 1)
+        uvc.insert(std::vector<float>{3.0f, 3.0f});
+
+        CHECK(uvc.insert(std::vector<float>{1.0f, 1.0f}).has_value());
+        CHECK_FALSE(uvc.insert(std::vector<float>{3.0f, 3.0f}).has_value());
+        CHECK_FALSE(uvc.insert(std::vector<float>{1.0f, 1.0f}).has_value());
+    }
+}
+
+TEST_CASE("ConcurrentVectorContainer single thread matches VectorContainer", "[ConcurrentVectorContainer]") {
+    VectorContainer vc(5, 3);
+    ConcurrentVectorContainer cvc(5, 3);
+
+    REQUIRE(cvc.get_padding_dims() == vc.get_padding_dims());
+
+    // same slots and sync ranges over a few laps, with resets in between
+    for (int i = 0; i < 17; ++i)
+    {
+        std::vector<float> vec = {static_cast<float>(i), 1.0f, 2.0f};
+        CHECK(cvc.insert(vec) == vc.insert(vec));
+        CHECK(cvc.size() == vc.size());
+        CHECK(cvc.get_current_position() == vc.get_current_position());
+        CHECK(cvc.get_sync_position() == vc.get_sync_position());
+        CHECK(cvc.get_wrap_around_flag() == vc.get_wrap_around_flag());
+        CHECK(cvc.get(i % 5) == vc.get(i % 5));
+
+        if (i == 3 || i == 11)
+        {
+            vc.reset_sync_range();
+            cvc.reset_sync_range();
+        }
+    }
+}
+
+TEST_CASE("ConcurrentVectorContainer concurrent insertion", "[ConcurrentVectorContainer]") {
+    const size_t nthreads = 8, per_thread = 500;
+
+    SECTION("every published vector is complete") {
+        ConcurrentVectorContainer cvc(nthreads * per_thread, 5);
+
+        std::vector<std::thread> writers;
+        for (size_t t = 0; t < nthreads; ++t)
+            writers.emplace_back([&cvc, t]() {
+                for (size_t i = 0; i < per_thread; ++i)
+                {
+                    float id = static_cast<float>(t * per_thread + i);
+                    cvc.insert(std::vector<float>(5, id));
+                }
+            });
+
+        // a reader checks the published prefix while the writers run
+        bool torn = false;
+        for (int round = 0; round < 50; ++round)
+        {
+            auto snap = cvc.snapshot();
+            for (size_t i = 0; i < snap.size; ++i)
+            {
+                auto vec = cvc.get(i);
+                if (std::any_of(vec.begin(), vec.end(), [&](float v) { return v != vec[0]; }))
+                    torn = true;
+            }
+        }
+        for (auto &w : writers)
+            w.join();
+        CHECK_FALSE(torn);
+
+        // all the vectors are there exactly once
+        REQUIRE(cvc.size() == nthreads * per_thread);
+        std::vector<float> ids;
+        for (size_t i = 0; i < cvc.size(); ++i)
+            ids.push_back(cvc.get(i)[0]);
+        std::sort(ids.begin(), ids.end());
+        for (size_t i = 0; i < ids.size(); ++i)
+            REQUIRE(ids[i] == static_cast<float>(i));
+    }
+
+    SECTION("snapshots are invalidated by overwrites") {
+        ConcurrentVectorContainer cvc(4, 2);
+        cvc.insert(std::vector<float>{1.0f, 1.0f});
+        auto snap = cvc.snapshot();
+        CHECK(snap.size == 1);
+
+        // filling up the free slots does not touch the swept prefix
+        cvc.insert(std::vector<float>{2.0f, 2.0f});
+        cvc.insert(std::vector<float>{3.0f, 3.0f});
+        cvc.insert(std::vector<float>{4.0f, 4.0f});
+        CHECK(cvc.validate(snap));
+
+        // wrapping around does
+        cvc.insert(std::vector<float>{5.0f, 5.0f});
+        CHECK_FALSE(cvc.validate(snap));
+        CHECK(cvc.validate(cvc.snapshot()));
+    }
+}
+
+TEST_CASE("VectorContainer storage alignment", "[VectorContainer]") {
+    StorageOptions plain;
+    plain.huge_pages = false;
+    plain.numa_first_touch = false;
+
+    // small, large (huge page sized) and unoptimized storage
+    VectorContainer small(10, 3);
+    VectorContainer large(20000, 50);
+    VectorContainer unoptimized(10, 3, plain);
+    ConcurrentVectorContainer concurrent(100, 13);
+
+    for (const float *ptr : {small.data(), large.data(), unoptimized.data(), concurrent.data()})
+        CHECK(reinterpret_cast<uintptr_t>(ptr) % STORAGE_ALIGNMENT == 0);
+
+    // zero initialized, including the padding
+    const float *data = large.data();
+    size_t padded = large.get_vector_dims() + large.get_padding_dims();
+    CHECK(std::all_of(data, data + 20000 * padded, [](float v) { return v == 0.0f; }));
+
+    // every vector starts on a GROUP_SIZE boundary
+    large.insert(std::vector<float>(50, 1.0f));
+    large.insert(std::vector<float>(50, 2.0f));
+    CHECK(data[padded] == 2.0f);
+    CHECK(padded % VectorContainer::GROUP_SIZE == 0);
+}
+
+TEST_CASE("VectorContainer eviction policies", "[VectorContainer]") {
+    VectorContainer vc(3, 2);
+    vc.insert(std::vector<float>{1.0f, 1.0f});
+    vc.insert(std::vector<float>{2.0f, 2.0f});
+    vc.insert(std::vector<float>{3.0f, 3.0f});
+    vc.reset_sync_range();
+
+    SECTION("round robin ignores the hits") {
+        vc.record_hit(0, 1, 10);
+        REQUIRE(vc.insert(std::vector<float>{4.0f, 4.0f}) == 0);
+        REQUIRE(vc.get_replaced_indices().empty());
+        REQUIRE(vc.get_hits(0) == 0);
+    }
+
+    SECTION("least hits evicts the least used vector") {
+        vc.set_eviction_policy(VectorContainer::EvictionPolicy::LEAST_HITS);
+        vc.record_hit(0, 1, 10);
+        vc.record_hit(1, 1, 1);
+        vc.record_hit(2, 1, 5);
+        REQUIRE(vc.insert(std::vector<float>{4.0f, 4.0f}) == 1);
+        REQUIRE(vc.get(1)[0] == 4.0f);
+        REQUIRE(vc.get_current_position() == 0);
+        REQUIRE(vc.get_replaced_indices() == std::vector<size_t>{1});
+
+        // the new vector is protected until the clock moves
+        REQUIRE(vc.insert(std::vector<float>{5.0f, 5.0f}) == 2);
+        vc.record_hit(0, 2, 1);
+        REQUIRE(vc.insert(std::vector<float>{6.0f, 6.0f}) == 1);
+        REQUIRE(vc.get_replaced_indices() == std::vector<size_t>{1, 2});
+
+        vc.reset_sync_range();
+        REQUIRE(vc.get_replaced_indices().empty());
+    }
+
+    SECTION("least recent win evicts the stalest winner") {
+        vc.set_eviction_policy(VectorContainer::EvictionPolicy::LEAST_RECENT_WIN);
+        vc.record_hit(0, 3, 1);
+        vc.record_hit(1, 1, 100);
+        vc.record_hit(2, 2, 1);
+        REQUIRE(vc.insert(std::vector<float>{4.0f, 4.0f}) == 1);
+    }
+
+    SECTION("without hits it falls back to round robin") {
+        vc.set_eviction_policy(VectorContainer::EvictionPolicy::LEAST_HITS);
+        REQUIRE(vc.insert(std::vector<float>{4.0f, 4.0f}) == 0);
+        REQUIRE(vc.get_current_position() == 1);
+    }
+}
+
+TEST_CASE("UniqueVectorContainer eviction keeps the hashmap consistent", "[UniqueVectorContainer]") {
+    UniqueVectorContainer uvc(2, 2);
+    uvc.set_eviction_policy(VectorContainer::EvictionPolicy::LEAST_HITS);
+    uvc.insert(std::vector<float>{1.0f, 1.0f});
+    uvc.insert(std::vector<float>{2.0f, 2.0f});
+    uvc.record_hit(0, 1, 5);
+
+    REQUIRE(uvc.insert(std::vector<float>{3.0f, 3.0f}) == 1);
+    // the evicted vector can come back, the kept one is still a duplicate
+    REQUIRE_FALSE(uvc.insert(std::vector<float>{1.0f, 1.0f}).has_value());
+    uvc.record_hit(0, 2, 5);
+    REQUIRE(uvc.insert(std::vector<float>{2.0f, 2.0f}) == 1);
+}
+
+TEST_CASE("VectorContainer double copies", "[VectorContainer]") {
+    StorageOptions options;
+    options.double_copy = true;
+
+    SECTION("plain container") {
+        VectorContainer vc(2, 3, options);
+        REQUIRE(vc.has_double_copy());
+        vc.insert(std::vector<double>{1.0 + 1e-12, 2.0, 3.0});
+        vc.insert(std::vector<float>{4.0f, 5.0f, 6.0f});
+        REQUIRE(vc.get_double(0)[0] == 1.0 + 1e-12);
+        REQUIRE(vc.get(0)[0] == 1.0f);
+        REQUIRE(vc.get_double(1)[2] == 6.0);
+
+        // overwritten in ring order with the float storage
+        vc.insert(std::vector<double>{7.0, 8.0, 9.0});
+        REQUIRE(vc.get_double(0)[0] == 7.0);
+        REQUIRE(vc.double_data()[1] == 8.0);
+    }
+
+    SECTION("unique container") {
+        UniqueVectorContainer uvc(2, 2, options);
+        REQUIRE(uvc.insert(std::vector<double>{0.5 + 1e-10, 1.0}) == 0);
+        REQUIRE_FALSE(uvc.insert(std::vector<double>{0.5, 1.0}).has_value());
+        REQUIRE(uvc.get_double(0)[0] == 0.5 + 1e-10);
+    }
+
+    SECTION("off by default") {
+        VectorContainer vc(2, 3);
+        REQUIRE_FALSE(vc.has_double_copy());
+    }
+}
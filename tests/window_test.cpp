@@ -0,0 +1,106 @@
+#define CATCH_CONFIG_MAIN
+#include "../external/catch_amalgamated.hpp"
+
+#include "window.h"
+#include <thread>
+
+using Catch::Approx;
+
+TEST_CASE("SeqlockWindow publishes the latest data", "[SeqlockWindow]")
+{
+    SeqlockWindow window(4);
+    std::vector<double> out{1.0};
+
+    REQUIRE(window.version() == 0);
+    REQUIRE(window.read(out) == 0);
+    REQUIRE(out.empty());
+
+    REQUIRE(window.publish(std::vector<double>{1.0, 2.0, 3.0}) == 1);
+    REQUIRE(window.read(out) == 1);
+    REQUIRE(out == std::vector<double>{1.0, 2.0, 3.0});
+
+    // shorter data replaces the longer one
+    REQUIRE(window.publish(std::vector<double>{4.0}) == 2);
+    REQUIRE(window.version() == 2);
+    REQUIRE(window.read(out) == 2);
+    REQUIRE(out == std::vector<double>{4.0});
+
+    REQUIRE_THROWS(window.publish(std::vector<double>(5, 0.0)));
+    REQUIRE(window.read(out) == 2);
+}
+
+TEST_CASE("SeqlockWindow readers never see a torn copy", "[SeqlockWindow]")
+{
+    // every publish fills the whole window with its version number
+    const size_t n = 1024;
+    const uint64_t npublish = 20000;
+    SeqlockWindow window(n);
+
+    std::thread writer([&]()
+    {
+        std::vector<double> data(n);
+        for (uint64_t v = 1; v <= npublish; ++v)
+        {
+            std::fill(data.begin(), data.end(), static_cast<double>(v));
+            window.publish(data);
+        }
+    });
+
+    std::vector<std::thread> readers;
+    std::vector<char> ok(3, 1);
+    for (size_t r = 0; r < ok.size(); ++r)
+        readers.emplace_back([&, r]()
+        {
+            std::vector<double> out;
+            uint64_t last = 0;
+            while (last < npublish)
+            {
+                uint64_t version = window.read(out);
+                if (version == 0)
+                    continue;
+                // versions never go back
+                if (version < last)
+                    ok[r] = 0;
+                for (double value : out)
+                    if (value != static_cast<double>(version))
+                        ok[r] = 0;
+                last = version;
+            }
+        });
+
+    writer.join();
+    for (auto &reader : readers)
+        reader.join();
+    for (char r : ok)
+        REQUIRE(r);
+}
+
+TEST_CASE("ApproximationSnapshot packing", "[SeqlockWindow]")
+{
+    ApproximationSnapshot snapshot;
+    snapshot.sample_count = 1000;
+    snapshot.iteration = 37;
+    snapshot.timestamp = 5;
+    snapshot.cuts.push_back(Cut{2.0, {1.0, 0.0}});
+    snapshot.cuts.push_back(Cut{-1.0, {-1.0, -1.0}});
+
+    std::vector<double> packed;
+    snapshot.pack(2, packed);
+    REQUIRE(packed.size() == ApproximationSnapshot::packed_size(2, 2));
+
+    ApproximationSnapshot copy = ApproximationSnapshot::unpack(packed, 2);
+    REQUIRE(copy.sample_count == 1000);
+    REQUIRE(copy.iteration == 37);
+    REQUIRE(copy.timestamp == 5);
+    REQUIRE(copy.cuts.size() == 2);
+    REQUIRE(copy.cuts[1].alpha == -1.0);
+    REQUIRE(copy.cuts[1].beta == std::vector<double>{-1.0, -1.0});
+
+    // max(0, 2 - x1, -1 + x1 + x2)
+    REQUIRE(copy.value({0.0, 0.0}) == Approx(2.0));
+    REQUIRE(copy.value({2.0, 3.0}) == Approx(4.0));
+    REQUIRE(copy.value({3.0, -3.0}) == Approx(0.0));
+
+    REQUIRE_THROWS(ApproximationSnapshot::unpack(packed, 3));
+    REQUIRE_THROWS(snapshot.pack(3, packed));
+}